@@ -5,30 +5,41 @@
 #include "vagg/vagg_macros.h"
 #include <portaudio.h>
 
-#include "RMS.hpp"
+#include "Meter.hpp"
 #include "mainwindow.h"
 
+/* The period at which the meter is redrawn, in milliseconds. */
+#define METER_REFRESH_MS 33
+
 static float rms2db(float value)
 {
   return 20 * log10(value);
 }
 
-void MainWindow::rmscallback(float* values, size_t size, void* user_data)
+void MainWindow::update_meter()
 {
-  MainWindow* mw = static_cast<MainWindow*>(user_data);
-  for (size_t i = 0; i < size; i++) {
-    values[i] = rms2db(values[i]);
+  if (spectrum->read(&spectrum_values)) {
+    spectrumView->spectrumChanged(spectrum_values);
   }
-  mw->rmscallback_m(values, size, user_data);
-}
 
-void MainWindow::rmscallback_m(float* values, size_t size, void* user_data)
-{
-  dbm->valueChanged(values, size);
+  MeterValues values;
+  if (! meter->read(&values)) {
+    dbm->refresh();
+    return;
+  }
+  float levels[METER_MAX_CHANNELS];
+  float peaks[METER_MAX_CHANNELS];
+  for (size_t i = 0; i < values.channels; i++) {
+    levels[i] = rms2db(values.rms[i]);
+    peaks[i] = rms2db(values.peak[i]);
+  }
+  dbm->valueChanged(levels, peaks, values.channels);
 }
 
 MainWindow::MainWindow()
 :player(0)
+,meter(new Meter())
+,spectrum(new SpectrumAnalyzer())
 ,playing(false)
 {
   setupActions();
@@ -37,6 +48,10 @@ MainWindow::MainWindow()
   timeLcd->display("00:00");
 
   connect(&event_loop_timer, SIGNAL(timeout()), this, SLOT(event_loop()));
+  // The meter is polled at display rate, the audio thread never calls the
+  // GUI.
+  connect(&meter_timer, SIGNAL(timeout()), this, SLOT(update_meter()));
+  meter_timer.start(METER_REFRESH_MS);
   connect(seekSlider, SIGNAL(valueChanged(int)), this, SLOT(seek(int)));
 }
 
@@ -52,12 +67,17 @@ void MainWindow::openfile()
       delete player;
       player = 0;
     }
-    player = new AudioPlayer(4096);
-    player->insert(new RMS(&MainWindow::rmscallback, this));
+    player = new AudioPlayer(4096, MirroredStorage);
+    // The same meter is reused by each player.
+    player->insert(meter);
+    player->insert(spectrum);
 
     QByteArray ba = filepath.toLocal8Bit();
     const char *c_str = ba.data();
-    player->load(c_str);
+    // Start with 4 chunks of buffering, and let the player adapt it.
+    player->load(c_str, 4, 3, true);
+    // One window per redraw.
+    meter->set_window(player->samplerate() * METER_REFRESH_MS / 1000);
     playAction->setDisabled(false);
 
     filepath = file;
@@ -108,13 +128,8 @@ void MainWindow::seek(int seek)
 {
   if (player && !current_time_advance_) {
     double pos = seek * player->duration() / seekSlider->maximum();
-    if (playing) {
-      player->pause();
-    }
+    // The seek is applied by the player's threads, no need to pause.
     player->seek(pos);
-    if (playing) {
-      player->play();
-    }
   }
 }
 
@@ -256,6 +271,7 @@ void MainWindow::setupUi()
   infoLabel = new QLabel("");
 
   dbm = new dBMeter(this);
+  spectrumView = new SpectrumView(this);
 
   QVBoxLayout *textLayout = new QVBoxLayout;
   textLayout->addWidget(filenameLabel);
@@ -278,6 +294,7 @@ void MainWindow::setupUi()
 
   QVBoxLayout *mainLayout = new QVBoxLayout;
   mainLayout->addLayout(mid);
+  mainLayout->addWidget(spectrumView);
   mainLayout->addLayout(seekerLayout);
   mainLayout->addLayout(playbackLayout);
 
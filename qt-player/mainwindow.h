@@ -7,11 +7,13 @@
  #include <QtGui>
  
  #include "dbmeter.h"
+ #include "spectrumview.h"
 
 #include "AudioPlayer.hpp"
 
  class QAction;
  class QLCDNumber;
+ class Meter;
 
 
  class MainWindow : public QMainWindow
@@ -31,6 +33,7 @@
      void playpause();
      void stop();
      void event_loop();
+     void update_meter();
      void seek(int where);
      void set_volume(int val);
 
@@ -43,11 +46,10 @@
      void setupUi();
      void unload();
      void stopped();
-     static void rmscallback(float* values, size_t size, void* userdata);
-     void rmscallback_m(float* values, size_t size, void* userdata);
 
 
      dBMeter *dbm;
+     SpectrumView *spectrumView;
 
      QSlider *seekSlider;
      QSlider *volumeSlider;
@@ -65,7 +67,11 @@
 	 QLabel *infoLabel;
      QString filepath;
      AudioPlayer* player;
+     Meter* meter;
+     SpectrumAnalyzer* spectrum;
+     SpectrumValues spectrum_values;
      QTimer event_loop_timer;
+     QTimer meter_timer;
      bool playing;
      bool current_time_advance_;
  };
@@ -1,15 +1,43 @@
 HEADERS   += mainwindow.h \
              dbmeter.h \
+             spectrumview.h \
+             ../src/FFT.hpp \
+             ../src/SpectrumAnalyzer.hpp \
              ../src/AudioFile.hpp \
+             ../src/MappedWav.hpp \
+             ../src/SampleCache.hpp \
+             ../src/MetadataCache.hpp \
+             ../src/ReadAhead.hpp \
              ../src/AudioPlayer.hpp \
+             ../src/LatencyController.hpp \
+             ../src/EventNotifier.hpp \
+             ../src/SmoothedValue.hpp \
+             ../src/FrameRingBuffer.hpp \
              ../src/RingBuffer.hpp \
+             ../src/MirroredMemory.hpp \
              ../src/Effect.hpp \
-             ../src/RMS.hpp
+             ../src/EffectChain.hpp \
+             ../src/Interleave.hpp \
+             ../src/TripleBuffer.hpp \
+             ../src/Meter.hpp \
+             ../src/Equalizer.hpp
 
 SOURCES   += main.cpp \
              dbmeter.cpp \
+             spectrumview.cpp \
+             ../src/FFT.cpp \
+             ../src/SpectrumAnalyzer.cpp \
              mainwindow.cpp \
              ../src/AudioFile.cpp \
+             ../src/MappedWav.cpp \
+             ../src/SampleCache.cpp \
+             ../src/MetadataCache.cpp \
+             ../src/ReadAhead.cpp \
+             ../src/MirroredMemory.cpp \
+             ../src/EffectChain.cpp \
+             ../src/Meter.cpp \
+             ../src/Equalizer.cpp \
+             ../src/EventNotifier.cpp \
              ../src/AudioPlayer.cpp
 
 CONFIG += debug
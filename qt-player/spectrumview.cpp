@@ -0,0 +1,48 @@
+#include <QtGui>
+
+#include <math.h>
+
+#include "spectrumview.h"
+
+SpectrumView::SpectrumView(QWidget *parent)
+: QWidget(parent)
+{
+  setMinimumSize(256, 120);
+}
+
+void SpectrumView::spectrumChanged(const SpectrumValues& values)
+{
+  magnitudes_.resize(values.bins);
+  for (size_t i = 0; i < values.bins; i++) {
+    magnitudes_[i] = values.magnitude[i];
+  }
+  this->update();
+}
+
+void SpectrumView::paintEvent(QPaintEvent *)
+{
+  QPainter painter(this);
+  painter.fillRect(rect(), Qt::black);
+  if (magnitudes_.size() < 2) {
+    return;
+  }
+
+  // A logarithmic frequency axis, from the first bin above 0 Hz : each
+  // column shows the loudest bin it covers.
+  int w = width();
+  int h = height();
+  int bins = magnitudes_.size();
+  float range = SPECTRUM_VIEW_TOP - SPECTRUM_VIEW_BOTTOM;
+  float last = log(static_cast<float>(bins - 1));
+  for (int x = 0; x < w; x++) {
+    int first = exp(last * x / w);
+    int end = qMin(static_cast<int>(exp(last * (x + 1) / w)), bins);
+    float max = magnitudes_[qMin(first, bins - 1)];
+    for (int bin = first + 1; bin < end; bin++) {
+      max = qMax(max, magnitudes_[bin]);
+    }
+    float level = (qBound<float>(SPECTRUM_VIEW_BOTTOM, max, SPECTRUM_VIEW_TOP) - SPECTRUM_VIEW_BOTTOM) / range;
+    int bar = level * h;
+    painter.fillRect(x, h - bar, 1, bar, Qt::green);
+  }
+}
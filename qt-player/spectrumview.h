@@ -0,0 +1,31 @@
+#ifndef SPECTRUMVIEW_H
+#define SPECTRUMVIEW_H
+
+#include <QWidget>
+#include <QVector>
+
+#include "SpectrumAnalyzer.hpp"
+
+/* The range shown, in dB. */
+#define SPECTRUM_VIEW_TOP 0
+#define SPECTRUM_VIEW_BOTTOM -90
+
+class SpectrumView : public QWidget
+{
+  Q_OBJECT
+
+  public:
+    SpectrumView(QWidget *parent = 0);
+
+  public slots:
+    /**
+     * @brief A new spectrum to show. GUI thread only.
+     */
+    void spectrumChanged(const SpectrumValues& values);
+
+  protected:
+    void paintEvent(QPaintEvent *event);
+    QVector<float> magnitudes_;
+};
+
+#endif
@@ -5,9 +5,20 @@
 
 dBMeter::dBMeter(QWidget *parent)
 : QWidget(parent),size_(1),width_(100),height_(260)
+,hold_(DEFAULT_PEAK_HOLD),decay_(DEFAULT_DECAY)
 {
-  memset(values_, 0, MAX_CHANNELS * sizeof(float));
+  for (size_t i = 0; i < MAX_CHANNELS; i++) {
+    values_[i] = peaks_[i] = DB_FLOOR;
+    held_[i] = 0;
+  }
   setFixedSize(width_, height_);
+  clock_.start();
+}
+
+void dBMeter::setBallistics(int hold, float decay)
+{
+  hold_ = hold;
+  decay_ = decay;
 }
 
 void dBMeter::paintEvent(QPaintEvent *)
@@ -20,20 +31,48 @@ void dBMeter::paintEvent(QPaintEvent *)
     for (size_t i = 0; i < size_; i++) {
       float channel_height = height_ - values_[i] * 4;
       painter.fillRect(channel_width * i, -values_[i] * 4, channel_width, channel_height, Qt::green);
+      painter.fillRect(channel_width * i, -peaks_[i] * 4, channel_width, 2, Qt::red);
       QString text = QString::number(values_[i], 'f', 1);
       painter.drawText(channel_width * i + 4, height_ - 4, text);
     }
   }
 }
 
-void dBMeter::valueChanged(float* values, size_t size) {
+void dBMeter::advance()
+{
+  int elapsed = clock_.restart();
+  float fall = decay_ * elapsed / 1000;
+  for (size_t i = 0; i < MAX_CHANNELS; i++) {
+    values_[i] = qMax<float>(values_[i] - fall, DB_FLOOR);
+    if (held_[i] > 0) {
+      held_[i] -= elapsed;
+    } else {
+      peaks_[i] = qMax<float>(peaks_[i] - fall, DB_FLOOR);
+    }
+  }
+}
+
+void dBMeter::valueChanged(const float* levels, const float* peaks, size_t size) {
   if (size > MAX_CHANNELS) {
-    VAGG_LOG(VAGG_LOG_FATAL, "Only %d channels at most", MAX_CHANNELS);
+    VAGG_LOG(VAGG_LOG_WARNING, "Only %d channels at most", MAX_CHANNELS);
+    size = MAX_CHANNELS;
   }
+  advance();
+  // The levels rise at once, and fall at the decay rate.
   for (size_t i = 0; i < size; i++) {
-    values_[i] = values[i];
+    if (levels[i] > values_[i]) {
+      values_[i] = levels[i];
+    }
+    if (peaks[i] >= peaks_[i]) {
+      peaks_[i] = peaks[i];
+      held_[i] = hold_;
+    }
   }
   size_ = size;
   this->update();
 }
 
+void dBMeter::refresh() {
+  advance();
+  this->update();
+}
@@ -2,8 +2,15 @@
 #define DBMETER_H
 
 #include <QWidget>
+#include <QTime>
 
 #define MAX_CHANNELS 4
+/* The lowest level shown, in dB. */
+#define DB_FLOOR -65
+/* The default ballistics : peaks stay up for this long, in milliseconds... */
+#define DEFAULT_PEAK_HOLD 1500
+/* ...and the bars fall at this rate, in dB per second. */
+#define DEFAULT_DECAY 20
 
 class dBMeter : public QWidget
 {
@@ -11,16 +18,37 @@ class dBMeter : public QWidget
 
   public:
     dBMeter(QWidget *parent = 0);
+    /**
+     * @brief How long a peak is held before falling, in milliseconds, and how
+     * fast the levels and the peaks fall, in dB per second.
+     */
+    void setBallistics(int hold, float decay);
 
   public slots:
-    void valueChanged(float* new_values, size_t size);
+    /**
+     * @brief New levels and peaks, in dB. GUI thread only.
+     */
+    void valueChanged(const float* levels, const float* peaks, size_t size);
+    /**
+     * @brief Let the levels fall when there is nothing new.
+     */
+    void refresh();
 
   protected:
     void paintEvent(QPaintEvent *event);
+    /**
+     * @brief Apply the decay and the hold for the time since the last call.
+     */
+    void advance();
     float values_[MAX_CHANNELS];
+    float peaks_[MAX_CHANNELS];
+    int held_[MAX_CHANNELS];
     size_t size_;
     size_t width_;
     size_t height_;
+    int hold_;
+    float decay_;
+    QTime clock_;
 };
 
 #endif
@@ -6,38 +6,60 @@
 #include <portaudio.h>
 #include <QDialog>
 
-#include "RMS.hpp"
+#include "Meter.hpp"
 #include "mainwindow.h"
 
+/* The period at which the meter is redrawn, in milliseconds. */
+#define METER_REFRESH_MS 33
+
 static float rms2db(float value)
 {
   return 20 * log10(value);
 }
 
-void MainWindow::rmscallback(float* values, size_t size, void* user_data)
+void MainWindow::update_meter()
 {
-  MainWindow* mw = static_cast<MainWindow*>(user_data);
-  for (size_t i = 0; i < size; i++) {
-    values[i] = rms2db(values[i]);
+  if (spectrum->read(&spectrum_values)) {
+    spectrumView->spectrumChanged(spectrum_values);
   }
-  mw->rmscallback_m(values, size, user_data);
-}
 
-void MainWindow::rmscallback_m(float* values, size_t size, void* user_data)
-{
-  dbm->valueChanged(values, size);
+  MeterValues values;
+  if (! meter->read(&values)) {
+    dbm->refresh();
+    return;
+  }
+  float levels[METER_MAX_CHANNELS];
+  float peaks[METER_MAX_CHANNELS];
+  for (size_t i = 0; i < values.channels; i++) {
+    levels[i] = rms2db(values.rms[i]);
+    peaks[i] = rms2db(values.peak[i]);
+  }
+  dbm->valueChanged(levels, peaks, values.channels);
 }
 
   MainWindow::MainWindow()
   :recorder(0)
+   ,compressor(new Compressor(44100))
+   ,limiter(new Limiter(44100, 1))
+   ,meter(new Meter())
+   ,spectrum(new SpectrumAnalyzer())
+   ,loudness(new LoudnessMeter(44100))
    ,recording(false)
 {
   setupActions();
   setupMenus();
   setupUi();
   timeLcd->display("00:00");
+  loudness_values.integrated = -HUGE_VAL;
+  compressor->set_threshold(-18);
+  compressor->set_ratio(3);
+  limiter->set_threshold(-1);
 
   connect(&event_loop_timer, SIGNAL(timeout()), this, SLOT(event_loop()));
+  // The meter is polled at display rate, the audio thread never calls the
+  // GUI.
+  connect(&meter_timer, SIGNAL(timeout()), this, SLOT(update_meter()));
+  meter_timer.start(METER_REFRESH_MS);
 }
 
 void MainWindow::openfile()
@@ -48,12 +70,27 @@ void MainWindow::openfile()
 
   if(file != 0) {
     filepath = file;
-    recorder = new AudioRecorder(4096);
-    recorder->insert(new RMS(&MainWindow::rmscallback, this));
+    delete recorder;
+    recorder = new AudioRecorder(4096, MirroredStorage);
+    // Tame the input before it hits the disk, then measure what is
+    // recorded. The same effects are reused by each recorder.
+    recorder->insert(compressor);
+    recorder->insert(limiter);
+    recorder->insert(meter);
+    recorder->insert(spectrum);
+    recorder->insert(loudness);
 
     QByteArray ba = filepath.toAscii();
     //printf("%s", ba);
     recorder->open(ba);
+    // One window per redraw.
+    meter->set_window(recorder->samplerate() * METER_REFRESH_MS / 1000);
+    // Nothing of the previous recording leaks into this one, and each
+    // recording is measured on its own.
+    compressor->reset();
+    limiter->reset();
+    loudness->reset(recorder->samplerate());
+    loudness_values.integrated = -HUGE_VAL;
     recordAction->setDisabled(false);
 
     filepath = file;
@@ -115,6 +152,12 @@ void MainWindow::event_loop()
   } else {
     text = text.sprintf("%lfGo remaining.", free_space / o_to_go);
   }
+  loudness->read(&loudness_values);
+  if (loudness_values.integrated > LOUDNESS_ABSOLUTE_GATE) {
+    text += QString().sprintf(" | %.1f LUFS integrated, %.1f LUFS short-term, %.1f dBTP",
+                              loudness_values.integrated, loudness_values.short_term,
+                              loudness_values.true_peak);
+  }
   infoLabel->setText(text);
   current_time_advance_ = false;
   if (recorder && ! recorder->state_machine()) {
@@ -190,6 +233,7 @@ void MainWindow::setupUi()
   infoLabel = new QLabel("");
 
   dbm = new dBMeter(this);
+  spectrumView = new SpectrumView(this);
 
   QVBoxLayout *textLayout = new QVBoxLayout;
   textLayout->addWidget(filenameLabel);
@@ -209,6 +253,7 @@ void MainWindow::setupUi()
 
   QVBoxLayout *mainLayout = new QVBoxLayout;
   mainLayout->addLayout(mid);
+  mainLayout->addWidget(spectrumView);
   mainLayout->addLayout(playbackLayout);
 
   QWidget *widget = new QWidget;
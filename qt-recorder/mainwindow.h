@@ -7,11 +7,15 @@
 #include <QtGui>
 
 #include "dbmeter.h"
+#include "qt-player/spectrumview.h"
 
 #include "AudioRecorder.hpp"
+#include "LoudnessMeter.hpp"
+#include "Limiter.hpp"
 
 class QAction;
 class QLCDNumber;
+class Meter;
 
 
 class MainWindow : public QMainWindow
@@ -32,6 +36,7 @@ class MainWindow : public QMainWindow
     void stop();
     void record();
     void event_loop();
+    void update_meter();
 
   private:
 
@@ -39,11 +44,10 @@ class MainWindow : public QMainWindow
     void setupMenus();
     void setupUi();
     void stopped();
-    static void rmscallback(float* values, size_t size, void* userdata);
-    void rmscallback_m(float* values, size_t size, void* userdata);
 
 
     dBMeter *dbm;
+    SpectrumView *spectrumView;
 
     QAction *recordAction;
     QAction *openAction;
@@ -56,7 +60,15 @@ class MainWindow : public QMainWindow
     QLabel *infoLabel;
     QString filepath;
     AudioRecorder* recorder;
+    Compressor* compressor;
+    Limiter* limiter;
+    Meter* meter;
+    SpectrumAnalyzer* spectrum;
+    SpectrumValues spectrum_values;
+    LoudnessMeter* loudness;
+    LoudnessValues loudness_values;
     QTimer event_loop_timer;
+    QTimer meter_timer;
     bool recording;
     bool current_time_advance_;
 };
@@ -1,15 +1,42 @@
 HEADERS   += mainwindow.h \
              ../qt-player/dbmeter.h \
+             ../qt-player/spectrumview.h \
+             ../src/FFT.hpp \
+             ../src/SpectrumAnalyzer.hpp \
              ../src/AudioFile.hpp \
+             ../src/MappedWav.hpp \
+             ../src/SampleCache.hpp \
+             ../src/MetadataCache.hpp \
+             ../src/ReadAhead.hpp \
              ../src/AudioRecorder.hpp \
-             ../src/RingBuffer.hpp \
+             ../src/FrameRingBuffer.hpp \
+             ../src/MirroredMemory.hpp \
              ../src/Effect.hpp \
-             ../src/RMS.hpp
+             ../src/EffectChain.hpp \
+             ../src/Interleave.hpp \
+             ../src/TripleBuffer.hpp \
+             ../src/Meter.hpp \
+             ../src/LoudnessMeter.hpp \
+             ../src/Limiter.hpp \
+             ../src/Equalizer.hpp
 
 SOURCES   += main.cpp \
              ../qt-player/dbmeter.cpp \
+             ../qt-player/spectrumview.cpp \
+             ../src/FFT.cpp \
+             ../src/SpectrumAnalyzer.cpp \
              mainwindow.cpp \
              ../src/AudioFile.cpp \
+             ../src/MappedWav.cpp \
+             ../src/SampleCache.cpp \
+             ../src/MetadataCache.cpp \
+             ../src/ReadAhead.cpp \
+             ../src/MirroredMemory.cpp \
+             ../src/EffectChain.cpp \
+             ../src/Meter.cpp \
+             ../src/Equalizer.cpp \
+             ../src/LoudnessMeter.cpp \
+             ../src/Limiter.cpp \
              ../src/AudioRecorder.cpp
 
 CONFIG += debug
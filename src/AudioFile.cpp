@@ -1,45 +1,231 @@
 #include "AudioFile.hpp"
+#include "Interleave.hpp"
+
+#include <math.h>
+
+#ifdef __SSE__
+  #include <xmmintrin.h>
+#endif
+
+/**
+ * @brief The largest absolute value of |samples|.
+ */
+static float absolute_peak(const SamplesType* samples, size_t count)
+{
+  float peak = 0;
+  size_t i = 0;
+#ifdef __SSE__
+  const __m128 sign = _mm_set1_ps(-0.0f);
+  __m128 peak0 = _mm_setzero_ps();
+  __m128 peak1 = _mm_setzero_ps();
+  for (; i + 8 <= count; i += 8) {
+    peak0 = _mm_max_ps(peak0, _mm_andnot_ps(sign, _mm_loadu_ps(samples + i)));
+    peak1 = _mm_max_ps(peak1, _mm_andnot_ps(sign, _mm_loadu_ps(samples + i + 4)));
+  }
+  float lanes[4];
+  _mm_storeu_ps(lanes, _mm_max_ps(peak0, peak1));
+  for (size_t j = 0; j < 4; j++) {
+    peak = lanes[j] > peak ? lanes[j] : peak;
+  }
+#endif
+  for (; i < count; i++) {
+    float value = fabsf(samples[i]);
+    peak = value > peak ? value : peak;
+  }
+  return peak;
+}
 
 AudioFile::AudioFile(const char* filename, int format)
+  :file_(0)
+  ,read_ahead_(0)
+  ,position_(0)
+  ,mode_(Read)
+  ,duration_(0)
+  ,peak_(-1)
 {
   size_t s = strlen(filename);
-  filename_ = new char[s];
-  strncpy(filename_, filename, s);
+  filename_ = new char[s + 1];
+  memcpy(filename_, filename, s + 1);
+  memset(&infos_, 0, sizeof(infos_));
   infos_.format = format;
   VAGG_SYSCALL(sf_format_check(&infos_));
 }
 
 AudioFile::~AudioFile()
 {
-  if (sf_close(file_) != 0) {
+  if (file_ && sf_close(file_) != 0) {
     VAGG_LOG(VAGG_LOG_OK, "Error while closing the file.");
   } else {
     VAGG_LOG(VAGG_LOG_OK, "File %s closed.", filename_);
   }
+  delete read_ahead_;
   delete [] filename_;
 }
 
 int AudioFile::open(const AudioFile::Mode mode)
 {
+  mode_ = mode;
+  bool reading = mode == Read || mode == ReadMapped;
+  if (reading) {
+    cached_ = SampleCache::instance().find(filename_);
+    if (cached_) {
+      open_cached();
+      VAGG_LOG(VAGG_LOG_OK, "File %s found in the cache", filename_);
+      store_metadata();
+      return 0;
+    }
+  }
+  if (mode == ReadMapped) {
+    if (mapped_.open(filename_) == 0) {
+      infos_.channels = mapped_.channels();
+      infos_.samplerate = mapped_.samplerate();
+      infos_.frames = mapped_.frames();
+      infos_.format = mapped_format(mapped_);
+      infos_.seekable = 1;
+      get_duration();
+      VAGG_LOG(VAGG_LOG_OK, "File %s mapped", filename_);
+      cache_whole_file();
+      store_metadata();
+      return 0;
+    }
+    VAGG_LOG(VAGG_LOG_DEBUG, "%s cannot be mapped, using libsndfile.", filename_);
+  }
   if (mode == Write) {
     infos_.samplerate = 44100;
     infos_.channels = 1;
   }
-  file_ = sf_open(filename_, mode, &infos_);
+  if (! reading || open_read_ahead() == -1) {
+    file_ = sf_open(filename_, reading ? Read : mode, &infos_);
+  }
   if (file_ == NULL) {
     VAGG_LOG(VAGG_LOG_FATAL, "Open file error : %s", sf_strerror(file_));
     return -1;
   } else {
     VAGG_LOG(VAGG_LOG_OK, "File %s opened", filename_);
     get_duration();
+    if (reading) {
+      cache_whole_file();
+      store_metadata();
+    }
     return 0;
   }
 }
 
-int AudioFile::seek(double ms)
+void AudioFile::open_cached()
+{
+  infos_.channels = cached_->channels;
+  infos_.samplerate = cached_->samplerate;
+  infos_.frames = cached_->frames;
+  infos_.format = cached_->format;
+  infos_.seekable = 1;
+  get_duration();
+  peak_ = cached_->peak;
+  position_ = 0;
+}
+
+void AudioFile::cache_whole_file()
+{
+  if (infos_.frames <= 0 || ! SampleCache::instance().fits(infos_.frames, infos_.channels)) {
+    return;
+  }
+  // Before decoding : a change while decoding makes the entry stale.
+  int64_t mtime_ns;
+  int64_t file_size;
+  if (! SampleCache::stat_file(filename_, &mtime_ns, &file_size)) {
+    return;
+  }
+  std::shared_ptr<CachedSamples> decoded(new CachedSamples);
+  decoded->samples.resize(infos_.frames * infos_.channels);
+  size_t count = read_some(&decoded->samples[0], decoded->samples.size());
+  if (count == static_cast<size_t>(-1)) {
+    return;
+  }
+  decoded->samples.resize(count);
+  decoded->channels = infos_.channels;
+  decoded->samplerate = infos_.samplerate;
+  decoded->format = infos_.format;
+  decoded->frames = count / infos_.channels;
+  decoded->peak = absolute_peak(&decoded->samples[0], count);
+  SampleCache::instance().insert(filename_, decoded, mtime_ns, file_size);
+
+  // Everything is in memory now, whether the cache kept it or not.
+  close_file();
+  mapped_.close();
+  cached_ = decoded;
+  open_cached();
+}
+
+static sf_count_t read_ahead_length(void* user_data)
+{
+  return static_cast<ReadAhead*>(user_data)->size();
+}
+
+static sf_count_t read_ahead_seek(sf_count_t offset, int whence, void* user_data)
+{
+  return static_cast<ReadAhead*>(user_data)->seek(offset, whence);
+}
+
+static sf_count_t read_ahead_read(void* out, sf_count_t count, void* user_data)
 {
-  if (infos_.seekable && ms * 1000 <= duration_) {
-    sf_count_t offset = ms * infos_.samplerate * infos_.channels;
+  return static_cast<ReadAhead*>(user_data)->read(out, count);
+}
+
+static sf_count_t read_ahead_write(const void*, sf_count_t, void*)
+{
+  return 0;
+}
+
+static sf_count_t read_ahead_tell(void* user_data)
+{
+  return static_cast<ReadAhead*>(user_data)->tell();
+}
+
+int AudioFile::open_read_ahead()
+{
+  static SF_VIRTUAL_IO io = {read_ahead_length, read_ahead_seek,
+                             read_ahead_read, read_ahead_write,
+                             read_ahead_tell};
+  read_ahead_ = new ReadAhead();
+  // Pipes and devices cannot be read ahead.
+  if (read_ahead_->open(filename_) == 0) {
+    file_ = sf_open_virtual(&io, SFM_READ, &infos_, read_ahead_);
+    if (file_) {
+      return 0;
+    }
+  }
+  delete read_ahead_;
+  read_ahead_ = 0;
+  return -1;
+}
+
+void AudioFile::close_file()
+{
+  if (file_) {
+    sf_close(file_);
+    file_ = 0;
+  }
+  delete read_ahead_;
+  read_ahead_ = 0;
+}
+
+bool AudioFile::is_open() const
+{
+  return file_ || mapped_.is_open() || cached_;
+}
+
+int AudioFile::seek(double seconds)
+{
+  if (cached_) {
+    uint64_t frame = seconds * infos_.samplerate;
+    position_ = frame < cached_->frames ? frame : cached_->frames;
+    return 0;
+  }
+  if (mapped_.is_open()) {
+    mapped_.seek(static_cast<uint64_t>(seconds * infos_.samplerate));
+    return 0;
+  }
+  if (file_ && infos_.seekable && seconds <= duration_) {
+    sf_count_t offset = seconds * infos_.samplerate;
     sf_count_t count = sf_seek(file_, offset, SEEK_SET);
     if (count == -1) {
       VAGG_LOG(VAGG_LOG_FATAL, "%s", sf_strerror(file_));
@@ -50,6 +236,25 @@ int AudioFile::seek(double ms)
 
 size_t AudioFile::read_some(AudioBuffer buffer, size_t size)
 {
+  if (cached_ || mapped_.is_open()) {
+    size_t count;
+    if (cached_) {
+      uint64_t frames = size / infos_.channels;
+      if (frames > cached_->frames - position_) {
+        frames = cached_->frames - position_;
+      }
+      count = frames * infos_.channels;
+      memcpy(buffer, cached_->samples.data() + position_ * infos_.channels,
+             count * sizeof(SamplesType));
+      position_ += frames;
+    } else {
+      count = mapped_.read(buffer, size);
+    }
+    if (count != size) {
+      VAGG_LOG(VAGG_LOG_WARNING, "End of file, asked=%zu, written=%zu", size, count);
+    }
+    return count;
+  }
   if (!file_) {
     VAGG_LOG(VAGG_LOG_FATAL, "Could not call %s, file not opened.", __func__);
     return -1;
@@ -70,21 +275,90 @@ size_t AudioFile::write_some(AudioBuffer buffer, size_t size)
   }
 
   size_t count;
-  count = sf_writef_float(file_, buffer, size);
+  count = sf_write_float(file_, buffer, size);
   if (count != size) {
     VAGG_LOG(VAGG_LOG_WARNING, "Bad write, asked=%zu, written=%zu", size, count);
   }
   return count;
 }
 
+size_t AudioFile::read_frames(AudioBuffer buffer, size_t frames)
+{
+  if (! is_open()) {
+    VAGG_LOG(VAGG_LOG_FATAL, "Could not call %s, file not opened.", __func__);
+    return -1;
+  }
+  size_t count = read_some(buffer, frames * infos_.channels);
+  if (count == static_cast<size_t>(-1)) {
+    return -1;
+  }
+  return count / infos_.channels;
+}
+
+size_t AudioFile::write_frames(const SamplesType* buffer, size_t frames)
+{
+  if (!file_) {
+    VAGG_LOG(VAGG_LOG_FATAL, "Could not call %s, file not opened.", __func__);
+    return -1;
+  }
+
+  size_t count;
+  count = sf_writef_float(file_, buffer, frames);
+  if (count != frames) {
+    VAGG_LOG(VAGG_LOG_WARNING, "Bad write, asked=%zu, written=%zu", frames, count);
+  }
+  return count;
+}
+
+size_t AudioFile::read_planar(SamplesType** channels, size_t frames)
+{
+  if (! is_open()) {
+    VAGG_LOG(VAGG_LOG_FATAL, "Could not call %s, file not opened.", __func__);
+    return -1;
+  }
+  size_t count = infos_.channels;
+  if (cached_) {
+    // Already decoded : split it from where it is.
+    if (frames > cached_->frames - position_) {
+      frames = cached_->frames - position_;
+    }
+    deinterleave(cached_->samples.data() + position_ * count, channels, frames, count);
+    position_ += frames;
+    return frames;
+  }
+
+  planar_chunk_.resize(AUDIOFILE_PLANAR_CHUNK * count);
+  planar_channels_.resize(count);
+  size_t done = 0;
+  while (done < frames) {
+    size_t chunk = frames - done;
+    if (chunk > AUDIOFILE_PLANAR_CHUNK) {
+      chunk = AUDIOFILE_PLANAR_CHUNK;
+    }
+    size_t read = read_frames(&planar_chunk_[0], chunk);
+    if (read == static_cast<size_t>(-1)) {
+      return done ? done : read;
+    }
+    for (size_t c = 0; c < count; c++) {
+      planar_channels_[c] = channels[c] + done;
+    }
+    deinterleave(&planar_chunk_[0], &planar_channels_[0], read, count);
+    done += read;
+    if (read != chunk) {
+      break;
+    }
+  }
+  return done;
+}
+
 int AudioFile::channels()
 {
-  return file_ ? infos_.channels : 0;
+  return is_open() ? infos_.channels : 0;
 }
 
 int AudioFile::samplerate()
 {
-  return file_ ? infos_.samplerate : 0;
+  return is_open() ? infos_.samplerate : 0;
 }
 
 double AudioFile::duration()
@@ -92,27 +366,90 @@ double AudioFile::duration()
   return duration_;
 }
 
-void AudioFile::get_duration() {
-  sf_count_t count;
-  if (infos_.seekable) {
-    count = sf_seek(file_, 0, SEEK_SET);
-    if (count == -1) {
-      VAGG_LOG(VAGG_LOG_FATAL, "%s", sf_strerror(file_));
-    }
+float AudioFile::peak()
+{
+  return peak_;
+}
 
-    count = sf_seek(file_, 0, SEEK_END);
-    if (count == -1) {
-      VAGG_LOG(VAGG_LOG_FATAL, "%s", sf_strerror(file_));
-    }
-    duration_ = (double)count / infos_.samplerate;
+void AudioFile::get_duration()
+{
+  // libsndfile counts the frames when it parses the header, and only gives
+  // SF_COUNT_MAX when it cannot know, for a stream : no need to seek to the
+  // end of the file, which costs a lot with compressed or remote files.
+  if (infos_.samplerate > 0 && infos_.frames >= 0 && infos_.frames != SF_COUNT_MAX) {
+    duration_ = static_cast<double>(infos_.frames) / infos_.samplerate;
   } else {
-    duration_ = -1.0f;
+    duration_ = -1.0;
   }
+}
 
-  count = sf_seek(file_, 0, SEEK_SET);
-  if (count == -1) {
-    VAGG_LOG(VAGG_LOG_FATAL, "%s", sf_strerror(file_));
+int AudioFile::mapped_format(const MappedWav& mapped)
+{
+  static const int subtypes[] = {SF_FORMAT_PCM_16, SF_FORMAT_PCM_24,
+                                 SF_FORMAT_PCM_32, SF_FORMAT_FLOAT};
+  return SF_FORMAT_WAV | subtypes[mapped.encoding()];
+}
+
+void AudioFile::store_metadata()
+{
+  if (! MetadataCache::enabled() || duration_ < 0) {
+    return;
+  }
+  AudioMetadata known;
+  if (MetadataCache::load(filename_, &known) == 0 &&
+      (known.peak >= 0 || peak_ < 0)) {
+    return;
+  }
+  AudioMetadata metadata;
+  metadata.channels = infos_.channels;
+  metadata.samplerate = infos_.samplerate;
+  metadata.format = infos_.format;
+  metadata.frames = infos_.frames;
+  metadata.peak = peak_;
+  MetadataCache::store(filename_, metadata);
+}
+
+int AudioFile::probe(const char* path, AudioMetadata* metadata)
+{
+  if (MetadataCache::load(path, metadata) == 0) {
+    return 0;
   }
+  SampleCache::Entry cached = SampleCache::instance().find(path);
+  MappedWav mapped;
+  if (cached) {
+    metadata->channels = cached->channels;
+    metadata->samplerate = cached->samplerate;
+    metadata->format = cached->format;
+    metadata->frames = cached->frames;
+    metadata->peak = cached->peak;
+  } else if (mapped.open(path) == 0) {
+    metadata->channels = mapped.channels();
+    metadata->samplerate = mapped.samplerate();
+    metadata->format = mapped_format(mapped);
+    metadata->frames = mapped.frames();
+    metadata->peak = -1;
+  } else {
+    // libsndfile only parses the header when opening.
+    SF_INFO infos;
+    memset(&infos, 0, sizeof(infos));
+    SNDFILE* file = sf_open(path, SFM_READ, &infos);
+    if (file == NULL) {
+      return -1;
+    }
+    sf_close(file);
+    metadata->channels = infos.channels;
+    metadata->samplerate = infos.samplerate;
+    metadata->format = infos.format;
+    metadata->frames = infos.frames;
+    metadata->peak = -1;
+    if (infos.frames == SF_COUNT_MAX) {
+      // A stream : nothing worth keeping.
+      metadata->frames = 0;
+      return 0;
+    }
+  }
+  MetadataCache::store(path, *metadata);
+  return 0;
 }
 
 const char* AudioFile::path()
@@ -2,10 +2,28 @@
 #define AUDIOFILE_HPP
 #include "types.hpp"
 #include "vagg/vagg_macros.h"
+#include "MappedWav.hpp"
+#include "SampleCache.hpp"
+#include "MetadataCache.hpp"
+#include "ReadAhead.hpp"
 #include <sndfile.h>
 
+/**
+ * @brief The number of frames read_planar() decodes at once.
+ */
+#define AUDIOFILE_PLANAR_CHUNK 1024
+
 /**
  * @brief Read an audiofile and provide data.
+ *
+ * Files opened for reading that are short enough are decoded whole once, and
+ * kept in the SampleCache : opening them again, reading and seeking then
+ * happen in memory. When the MetadataCache is enabled, opening a file for
+ * reading also writes its sidecar, and probe() reads it back.
+ *
+ * The other files opened for reading are decoded by libsndfile from a
+ * ReadAhead, that keeps the next blocks of the file being read in the
+ * background : a slow disk only stalls read_some() if it is behind.
  */
 class AudioFile
 {
@@ -13,16 +31,28 @@ class AudioFile
     enum Mode {
       Write = SFM_WRITE,
       Read = SFM_READ,
-      ReadWrite = SFM_RDWR
+      ReadWrite = SFM_RDWR,
+      /**
+       * @brief Read plain PCM and float WAV files from a memory mapping (see
+       * MappedWav), anything else with libsndfile, like Read.
+       */
+      ReadMapped = SFM_RDWR + 0x10
     };
     AudioFile(const char* filename,
         int format = SF_FORMAT_WAV|SF_FORMAT_PCM_16);
     ~AudioFile();
+    /**
+     * @brief Open the file. Files opened with Write are mono, at 44100 Hz.
+     *
+     * @return 0 on success, -1 otherwise.
+     */
     int open(Mode mode);
     /**
      * @brief Read some data from the file.
      *
      * @param buffer The buffer in which we should take the data.
+     * @param size The number of samples to read, a multiple of the number of
+     * channels.
      *
      * @return  The number of samples retrieved from the file.
      */
@@ -31,10 +61,46 @@ class AudioFile
      * @brief Write some data into a file.
      *
      * @param buffer The data to write in the file.
+     * @param size The number of samples to write, a multiple of the number
+     * of channels. It used to be a number of frames : write_frames() takes
+     * one.
+     *
+     * @return The number of samples written.
      */
     size_t write_some(AudioBuffer buffer, size_t size);
+    /**
+     * @brief Read |frames| interleaved frames.
+     *
+     * @return The number of frames read, less at the end of the file, or -1
+     * if the file is not opened.
+     */
+    size_t read_frames(AudioBuffer buffer, size_t frames);
+    /**
+     * @brief Write |frames| interleaved frames.
+     *
+     * @return The number of frames written, or -1 if the file is not opened.
+     */
+    size_t write_frames(const SamplesType* buffer, size_t frames);
+    /**
+     * @brief Read |frames| frames, split into one contiguous buffer per
+     * channel.
+     *
+     * The frames are decoded by chunks small enough to stay in the cache,
+     * and each chunk is deinterleaved right away, with SSE for stereo.
+     * Files read from the SampleCache are deinterleaved straight from it.
+     *
+     * @param channels One pointer per channel of the file, to |frames|
+     * samples each.
+     *
+     * @return The number of frames read, less at the end of the file, or -1
+     * if the file is not opened.
+     */
+    size_t read_planar(SamplesType** channels, size_t frames);
 
-    int seek(double ms);
+    /**
+     * @brief Move the read position to |seconds| from the start.
+     */
+    int seek(double seconds);
 
     /**
      * @brief Get the number of channels
@@ -51,13 +117,79 @@ class AudioFile
     int samplerate();
 
     double duration();
+    /**
+     * @brief The largest absolute sample value of the file.
+     *
+     * @return A negative value if the file was not decoded whole.
+     */
+    float peak();
     const char* path();
+    /**
+     * @brief Get the channels, samplerate, length and format of |path|,
+     * without reading its samples : from its sidecar or the SampleCache if
+     * possible, from the header of the file otherwise.
+     *
+     * @return 0 on success, -1 if the file cannot be opened.
+     */
+    static int probe(const char* path, AudioMetadata* metadata);
   protected:
+    /**
+     * @brief Compute the duration from the number of frames in |infos_|, or
+     * -1 if it is not known.
+     */
     void get_duration();
     /**
-     * @brief The file handle, for libsndfile.
+     * @brief Write the sidecar of the file, unless it is already there and
+     * knows as much.
+     */
+    void store_metadata();
+    static int mapped_format(const MappedWav& mapped);
+    /**
+     * @brief Open the file with libsndfile, reading through |read_ahead_|.
+     *
+     * @return 0 on success, -1 if the file cannot be read that way.
+     */
+    int open_read_ahead();
+    /**
+     * @brief Close the libsndfile handle and what it reads from.
+     */
+    void close_file();
+    bool is_open() const;
+    /**
+     * @brief Read from the decoded samples of |cached_|.
+     */
+    void open_cached();
+    /**
+     * @brief Decode the whole file and keep it in the SampleCache, if it is
+     * short enough, then read from there.
+     */
+    void cache_whole_file();
+    /**
+     * @brief The file handle, for libsndfile. 0 when the file is mapped.
      */
     SNDFILE* file_;
+    /**
+     * @brief The file, when opened with ReadMapped and it is a plain WAV
+     * file.
+     */
+    MappedWav mapped_;
+    /**
+     * @brief What libsndfile reads from, when the file is opened for reading
+     * and is not mapped. 0 otherwise.
+     */
+    ReadAhead* read_ahead_;
+    /**
+     * @brief The interleaved chunk read_planar() decodes to, and where it
+     * splits it.
+     */
+    std::vector<SamplesType> planar_chunk_;
+    std::vector<SamplesType*> planar_channels_;
+    /**
+     * @brief The whole file, decoded, when it comes from the SampleCache, and
+     * the next frame to read from it.
+     */
+    SampleCache::Entry cached_;
+    uint64_t position_;
     /**
      * @brief The infos of the file, such as samplerate, samples format and
      * number of channels.
@@ -75,6 +207,7 @@ class AudioFile
     Mode mode_;
 
     double duration_;
+    float peak_;
 };
 
 #endif
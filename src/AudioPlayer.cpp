@@ -1,6 +1,24 @@
 #include "AudioPlayer.hpp"
 #include "vagg/vagg.h"
 
+#include <string.h>
+
+/**
+ * @brief How much deeper than asked the adaptive mode can make the buffer.
+ */
+#define ADAPTIVE_MAX_DEPTH_FACTOR 4
+
+/**
+ * @brief How often the decoder thread checks for work without being woken
+ * up, in milliseconds. This is only a safety net.
+ */
+#define DECODER_TIMEOUT_MS 100
+
+/**
+ * @brief The time it takes to reach a new volume, in milliseconds.
+ */
+#define VOLUME_RAMP_MS 20
+
 
 #define HANDLE_PA_ERROR(err)                                                            \
   Pa_Terminate();                                                                       \
@@ -9,12 +27,20 @@
   VAGG_LOG(VAGG_LOG_CRITICAL, "Error message: %s", Pa_GetErrorText(err));             \
   return err;
 
-AudioPlayer::AudioPlayer(const size_t chunk_size)
+AudioPlayer::AudioPlayer(const size_t chunk_size, RingStorage storage)
   :file_(0)
   ,chunk_size_(chunk_size)
+  ,storage_(storage)
   ,ring_buffer_(0)
+  ,scratch_(0)
+  ,decoder_running_(false)
   ,playback_state_(STOPPED)
-  ,effect_(0)
+  ,current_time_(0)
+  ,stream_(0)
+  ,commands_(1)
+  ,decoder_commands_(1)
+  ,decoder_events_(1)
+  ,flush_position_(0)
   ,volume_(1.0)
 
 {   
@@ -33,6 +59,8 @@ AudioPlayer::~AudioPlayer()
 	delete ring_buffer_;
 	ring_buffer_ = 0;
   }
+
+  delete [] scratch_;
 }
 
 int AudioPlayer::play()
@@ -55,28 +83,74 @@ int AudioPlayer::play()
 
 bool AudioPlayer::state_machine()
 {
-  switch(playback_state_) {
-    case HAS_DATA:
+  return playback_state_ != STOPPED;
+}
+
+void AudioPlayer::start_decoder()
+{
+  decoder_running_ = true;
+  decoder_thread_ = std::thread(&AudioPlayer::decoder_loop, this);
+}
+
+void AudioPlayer::stop_decoder()
+{
+  if (decoder_thread_.joinable()) {
+    decoder_running_ = false;
+    decoder_wakeup_.notify();
+    decoder_thread_.join();
+  }
+}
+
+void AudioPlayer::request_data()
+{
+  // Only wake the decoder thread up once : it goes back to HAS_DATA when it
+  // is done refilling. Leave SHOULD_STOP and STOPPED alone.
+  int state = HAS_DATA;
+  if (playback_state_.compare_exchange_strong(state, NEED_DATA)) {
+    decoder_wakeup_.notify();
+  }
+}
+
+void AudioPlayer::decoder_loop()
+{
+  while (decoder_running_) {
+    decoder_wakeup_.wait(DECODER_TIMEOUT_MS);
+    if (! decoder_running_) {
       break;
-    case NEED_DATA:
-      {
-        while(! ring_buffer_->full()) {
-          size_t size = chunk_size_ * file_->channels();
-          SamplesType b[size];
-          if (file_->read_some(b, size) != size) {
-            playback_state_ = SHOULD_STOP;
-          }
-          ring_buffer_->push(b, size);
-        }
+    }
+    Command* command;
+    while ((command = decoder_commands_.peek_read())) {
+      // The callback has not caught up with the previous seeks (the stream
+      // is paused), try again later.
+      if (decoder_events_.full()) {
+        break;
       }
-      break;
-    case SHOULD_STOP:
-      break;
-    case STOPPED:
-      return false;
-      break;
+      if (command->type == COMMAND_SEEK) {
+        file_->seek(command->value);
+        // Everything before this position is from before the seek, the
+        // callback skips it.
+        Command flush = *command;
+        flush.type = COMMAND_FLUSH;
+        flush.position = ring_buffer_->write_position();
+        flush_position_ = flush.position;
+        decoder_events_.push(&flush, 1);
+        // Play again if we were done.
+        int done = SHOULD_STOP;
+        playback_state_.compare_exchange_strong(done, HAS_DATA);
+        // Decode after the flush, in the free space. If the ring buffer is
+        // full, the callback asks for more once it has flushed.
+        prebuffer();
+      }
+      decoder_commands_.release_read();
+    }
+
+    int state = NEED_DATA;
+    if (playback_state_ == NEED_DATA) {
+      bool more = prebuffer();
+      // Let the callback wake us up again if this was not enough.
+      playback_state_.compare_exchange_strong(state, more ? HAS_DATA : SHOULD_STOP);
+    }
   }
-  return true;
 }
 
 void AudioPlayer::finished_callback(void* user_data)
@@ -113,13 +187,17 @@ int AudioPlayer::seek(const double ms)
 
   VAGG_LOG(VAGG_LOG_DEBUG, "Seeking to %lf", ms);
 
-  file_->seek(ms);
-  ring_buffer_->clear();
-  if (playback_state_ != STOPPED) {
-    prebuffer();
+  // The decoder thread moves the file position, then tells the audio
+  // callback where the new data starts in the ring buffer.
+  Command command;
+  command.type = COMMAND_SEEK;
+  command.value = ms;
+  command.position = 0;
+  if (! decoder_commands_.push(&command, 1)) {
+    VAGG_LOG(VAGG_LOG_WARNING, "Too many seeks pending, dropping one.");
+    return -1;
   }
-
-  current_time_ = ms;
+  decoder_wakeup_.notify();
 
   return 0;
 }
@@ -131,10 +209,60 @@ double AudioPlayer::current_time()
 
 int AudioPlayer::insert(Effect* effect)
 {
-  effect_ = effect;
+  return effects_.insert(effect);
+}
+
+int AudioPlayer::remove(Effect* effect)
+{
+  return effects_.remove(effect);
+}
+
+int AudioPlayer::bypass(Effect* effect, bool bypassed)
+{
+  return effects_.bypass(effect, bypassed);
+}
+
+int AudioPlayer::send(int type, double value)
+{
+  Command command;
+  command.type = type;
+  command.value = value;
+  command.position = 0;
+  if (! commands_.push(&command, 1)) {
+    VAGG_LOG(VAGG_LOG_WARNING, "Command queue full, dropping a command.");
+    return -1;
+  }
   return 0;
 }
 
+bool AudioPlayer::drain_commands()
+{
+  bool flushed = false;
+  Command command;
+  while (commands_.pop(&command, 1)) {
+    switch (command.type) {
+      case COMMAND_VOLUME:
+        volume_.set_target(command.value);
+        break;
+    }
+  }
+  while (decoder_events_.pop(&command, 1)) {
+    if (command.type == COMMAND_FLUSH) {
+      ring_buffer_->skip_to(command.position);
+      current_time_ = command.value;
+      flushed = true;
+    }
+  }
+  return flushed;
+}
+
+void AudioPlayer::drop_commands()
+{
+  Command command;
+  while (decoder_commands_.pop(&command, 1)) { }
+  while (decoder_events_.pop(&command, 1)) { }
+}
+
 double AudioPlayer::duration()
 {
   if (file_) {
@@ -159,12 +287,24 @@ int AudioPlayer::samplerate()
   return 0;
 }
 
-int AudioPlayer::load(const char* file)
+size_t AudioPlayer::buffer_depth()
+{
+  return latency_.depth();
+}
+
+size_t AudioPlayer::underruns()
+{
+  return latency_.underruns();
+}
+
+int AudioPlayer::load(const char* file, size_t depth, size_t low_water, bool adaptive)
 {
   VAGG_LOG(VAGG_LOG_DEBUG, "file_ %p",file_);
   VAGG_LOG(VAGG_LOG_DEBUG, "Loading %s.", file);
   PaError err;
 
+  stop_decoder();
+
   if(file_){
   	VAGG_LOG(VAGG_LOG_DEBUG, "Deleting old file_. %p",file_);
 	delete file_;
@@ -177,13 +317,31 @@ int AudioPlayer::load(const char* file)
 	ring_buffer_ = 0;
   }
 
+  delete [] scratch_;
+  scratch_ = 0;
+
+  // Pending seeks were meant for the previous file.
+  drop_commands();
+  current_time_ = 0;
+
   file_ = new AudioFile(file);
-  if ((err = file_->open(AudioFile::Read))) {
+  if ((err = file_->open(AudioFile::ReadMapped))) {
     HANDLE_PA_ERROR(err);
     return err;
   }
 
-  ring_buffer_ = new RingBuffer<SamplesType, 4>(chunk_size_ * file_->channels());
+  volume_.set_ramp(SmoothedValue::Linear, file_->samplerate() * VOLUME_RAMP_MS / 1000);
+
+  size_t max_depth = adaptive ? ADAPTIVE_MAX_DEPTH_FACTOR * depth : depth;
+  latency_.reset(depth, low_water, max_depth, adaptive);
+
+  // Room for the deepest the buffer can get, the decoder only fills it up to
+  // the current depth. One more chunk lets the decoder start writing after a
+  // seek before the callback has flushed the frames from before it.
+  ring_buffer_ = new FrameRingBuffer<SamplesType>((max_depth + 1) * chunk_size_, file_->channels(), storage_);
+  flush_position_ = 0;
+  scratch_ = new SamplesType[chunk_size_ * file_->channels()];
+  effects_.prepare(chunk_size_, file_->channels());
 
   err = Pa_Initialize();
   if(err != paNoError) {
@@ -220,21 +378,46 @@ int AudioPlayer::load(const char* file)
   }
 
   prebuffer();
+  start_decoder();
 
   return 0;
 }
 
-void AudioPlayer::prebuffer()
+size_t AudioPlayer::buffered()
 {
-  while(! ring_buffer_->full()) {
-    size_t size = chunk_size_ * file_->channels();
-    SamplesType prebuffer[size];
-    size_t count = file_->read_some(prebuffer, size);
-    ring_buffer_->push(prebuffer, size);
-    if (count != size) {
-      break;
+  // Before the callback flushes, the frames before the flush position are
+  // still in the ring buffer, but will not be played.
+  size_t available = ring_buffer_->available_read();
+  size_t after_flush = ring_buffer_->write_position() - flush_position_;
+  return available < after_flush ? available : after_flush;
+}
+
+bool AudioPlayer::prebuffer()
+{
+  size_t target = latency_.depth() * chunk_size_;
+  size_t available;
+  size_t frames;
+  SamplesType* span;
+  // Decode straight into the free space of the ring buffer, up to the depth.
+  while((available = buffered()) < target &&
+        (span = ring_buffer_->reserve_write(&frames)) && frames) {
+    if (frames > target - available) {
+      frames = target - available;
+    }
+    if (frames > chunk_size_) {
+      frames = chunk_size_;
+    }
+    size_t count = file_->read_frames(span, frames);
+    if (count != frames) {
+      if (count > frames) {
+        count = 0;
+      }
+      ring_buffer_->commit_write(count);
+      return false;
     }
+    ring_buffer_->commit_write(frames);
   }
+  return true;
 }
 
 int AudioPlayer::unload()
@@ -255,6 +438,8 @@ int AudioPlayer::unload()
     stream_ = 0;
   }
 
+  stop_decoder();
+
   Pa_Terminate();
 
   return 0;
@@ -279,7 +464,8 @@ int AudioPlayer::audio_callback(const void * inputBuffer,
  * @param inputBuffer A possible input buffer (unused).
  * @param outputBuffer The place to put the samples we want to play.
  * @param framesPerBuffer The number of frames per buffer.
- * @param timeInfo A time information for synchronization (unused).
+ * @param timeInfo A time information for synchronization, used to measure
+ * the callback jitter.
  * @param statusFlags Some status flag (unused).
  * @param userData A user-defined pointer to carry data around.
  *
@@ -288,39 +474,58 @@ int AudioPlayer::audio_callback(const void * inputBuffer,
 int AudioPlayer::audio_callback_m(const void * VAGG_UNUSED(inputBuffer),
                                 void *outputBuffer,
                                 unsigned long framesPerBuffer,
-                                const PaStreamCallbackTimeInfo* VAGG_UNUSED(timeInfo),
+                                const PaStreamCallbackTimeInfo* timeInfo,
                                 PaStreamCallbackFlags VAGG_UNUSED(statusFlags),
                                 void *VAGG_UNUSED(userData))
 {
   float* out = (float*)outputBuffer;
+  size_t channels = file_->channels();
+
+  bool flushed = drain_commands();
+
+  // The ring buffer can be empty right after a seek, when the decoder had no
+  // room to decode after the flush : this is not the decoder falling behind.
+  bool underrun = ring_buffer_->empty() && playback_state_ != SHOULD_STOP && ! flushed;
+  latency_.update(timeInfo->currentTime, framesPerBuffer, file_->samplerate(), underrun);
 
   // We have no data ! Output silence.
   if (ring_buffer_->empty()) {
-    VAGG_LOG(VAGG_LOG_WARNING, "UNDERRUN");
-    playback_state_ = NEED_DATA;
-    for(size_t i = 0; i < framesPerBuffer; i++) {
-      // Left
-      *out++ = 0.0;
-      // Right
-      *out++ = 0.0;
+    if (underrun) {
+      VAGG_LOG(VAGG_LOG_WARNING, "UNDERRUN");
     }
+    request_data();
+    memset(out, 0, framesPerBuffer * channels * sizeof(float));
   } else {
-    size_t channels = file_->channels();
-    SamplesType buffer[framesPerBuffer * channels];
-    ring_buffer_->pop(buffer, framesPerBuffer * channels);
-
-    size_t i = 0;
-    while( i < framesPerBuffer * channels) {
-      for (size_t c = 0; c < channels; c++) {
-        *out++ = buffer[i++]*volume_;
-      }
+    size_t frames = ring_buffer_->available_read();
+    if (frames > framesPerBuffer) {
+      frames = framesPerBuffer;
+    }
+
+    // Read the samples in place, unless they wrap around the end of a ring
+    // buffer that is not mirrored.
+    size_t contiguous;
+    SamplesType* buffer = ring_buffer_->peek_read(&contiguous);
+    bool in_place = contiguous >= frames;
+    if (! in_place) {
+      ring_buffer_->read(scratch_, frames);
+      buffer = scratch_;
     }
 
-    if (effect_) {
-      effect_->process(buffer, framesPerBuffer, file_->channels());
+    // The effects work in place on the ring buffer, or on the scratch
+    // buffer, so that what they do is heard. Applying the volume is the
+    // copy to the output.
+    effects_.process(buffer, frames, channels);
+
+    volume_.apply(buffer, out, frames, channels);
+    out += frames * channels;
+    // The end of the file : pad with silence.
+    memset(out, 0, (framesPerBuffer - frames) * channels * sizeof(float));
+
+    if (in_place) {
+      ring_buffer_->release_read(frames);
     }
 
-    double pos = current_time_ + static_cast<double>(framesPerBuffer) / file_->samplerate();
+    double pos = current_time_ + static_cast<double>(frames) / file_->samplerate();
     current_time_ = pos;
 
     if (playback_state_ == SHOULD_STOP) {
@@ -328,11 +533,9 @@ int AudioPlayer::audio_callback_m(const void * VAGG_UNUSED(inputBuffer),
         return paComplete;
       }
     } else {
-      // Tell the other thread that it should start buffering.
-      if (ring_buffer_->available_read() < 3) {
-        playback_state_ = NEED_DATA;
-      } else {
-        playback_state_ = HAS_DATA;
+      // Wake the decoder thread up, it should start buffering.
+      if (ring_buffer_->available_read() < latency_.low_water() * chunk_size_) {
+        request_data();
       }
     }
   }
@@ -345,5 +548,5 @@ void AudioPlayer::set_volume(float vol){
     VAGG_LOG(VAGG_LOG_FATAL, "Volume out of range 0...1. Was %f", vol);
     vol = 0;
   }
-  volume_ = vol;
+  send(COMMAND_VOLUME, vol);
 }
@@ -2,10 +2,16 @@
 #define AUDIOPLAYER_HPP
 
 #include "AudioFile.hpp"
+#include "FrameRingBuffer.hpp"
 #include "RingBuffer.hpp"
 #include "Effect.hpp"
+#include "EffectChain.hpp"
+#include "LatencyController.hpp"
+#include "EventNotifier.hpp"
+#include "SmoothedValue.hpp"
 
 #include <atomic>
+#include <thread>
 #include <portaudio.h>
 
 #define HAS_DATA 0
@@ -13,25 +19,136 @@
 #define SHOULD_STOP 2
 #define STOPPED 3
 
+/**
+ * @brief Messages sent to the audio callback and to the decoder thread.
+ */
+#define COMMAND_VOLUME 0
+#define COMMAND_SEEK 1
+#define COMMAND_FLUSH 2
+
+/**
+ * @brief The size of the command queues.
+ */
+#define COMMAND_QUEUE_SIZE 64
+
 class AudioPlayer
 {
   public:
-    AudioPlayer(const size_t chunk_size);
+    /**
+     * @param chunk_size The number of frames decoded and played at once.
+     * @param storage MirroredStorage to always read contiguous blocks out of
+     * the ring buffer, even when they wrap around.
+     */
+    AudioPlayer(const size_t chunk_size, RingStorage storage = HeapStorage);
     ~AudioPlayer();
     int play();
     int pause();
-    int load(const char* file);
+    /**
+     * @brief Open a file, and get ready to play it.
+     *
+     * @param file The path of the file to play.
+     * @param depth The number of chunks to buffer ahead of the audio
+     * callback.
+     * @param low_water The number of buffered chunks under which the callback
+     * asks for more data.
+     * @param adaptive If true, start at |depth|, then grow it when underruns
+     * or late callbacks show up, and shrink it back when things are stable.
+     */
+    int load(const char* file, size_t depth = 4, size_t low_water = 3,
+             bool adaptive = false);
     int unload();
     int seek(const double ms);
     double current_time();
+    /**
+     * @brief Add an effect at the end of the effect chain. The effect is not
+     * owned by the player, and must outlive it, or be removed first.
+     */
     int insert(Effect* effect);
+    /**
+     * @brief Take an effect out of the effect chain.
+     */
+    int remove(Effect* effect);
+    /**
+     * @brief Skip an effect of the chain, or stop skipping it.
+     */
+    int bypass(Effect* effect, bool bypassed);
+    /**
+     * @brief Whether the player is still playing, or has something to play.
+     *
+     * The ring buffer is refilled by a thread owned by the player, there is
+     * no need to call this regularly.
+     */
     bool state_machine();
     double duration();
     void set_volume(float vol);
     int channels();  
     int samplerate();
+    /**
+     * @brief The number of chunks currently buffered ahead of the callback.
+     */
+    size_t buffer_depth();
+    /**
+     * @brief The number of underruns since the file was loaded.
+     */
+    size_t underruns();
   protected:
-    void prebuffer();
+    /**
+     * @brief A control operation, sent over a queue to the thread that
+     * applies it.
+     */
+    struct Command {
+      int type;
+      /**
+       * @brief The volume for COMMAND_VOLUME, the time in seconds for
+       * COMMAND_SEEK and COMMAND_FLUSH.
+       */
+      double value;
+      /**
+       * @brief For COMMAND_FLUSH, the position in the ring buffer at which the
+       * data after the seek starts.
+       */
+      size_t position;
+    };
+    typedef RingBuffer<Command, COMMAND_QUEUE_SIZE> CommandQueue;
+
+    /**
+     * @brief Send a command to the audio callback, from the control thread.
+     */
+    int send(int type, double value);
+    /**
+     * @brief Apply the pending commands, at the start of a callback.
+     *
+     * @return true if the ring buffer was flushed after a seek.
+     */
+    bool drain_commands();
+    /**
+     * @brief Drop the commands of a previous file. The stream and the decoder
+     * thread must be stopped.
+     */
+    void drop_commands();
+
+    /**
+     * @brief Fill the free space of the ring buffer, up to the depth. The
+     * frames from before the last flush, that the callback has not skipped
+     * yet, do not count.
+     *
+     * @return false if the end of the file has been reached.
+     */
+    bool prebuffer();
+    /**
+     * @brief The frames in the ring buffer that will be played.
+     */
+    size_t buffered();
+    /**
+     * @brief Start and stop the thread that refills the ring buffer.
+     */
+    void start_decoder();
+    void stop_decoder();
+    void decoder_loop();
+    /**
+     * @brief Called by the audio callback to have the ring buffer refilled.
+     */
+    void request_data();
     /** Callbacks **/
     static int audio_callback(const void * inputBuffer,
                         void *outputBuffer,
@@ -53,16 +170,50 @@ class AudioPlayer
     /** Members **/
     AudioFile* file_;
     const size_t chunk_size_;
-    RingBuffer<SamplesType,4>* ring_buffer_;
+    const RingStorage storage_;
+    FrameRingBuffer<SamplesType>* ring_buffer_;
+    /**
+     * @brief Used by the audio callback to gather the frames that wrap around
+     * the end of the ring buffer.
+     */
+    SamplesType* scratch_;
+    LatencyController latency_;
+    /**
+     * @brief The audio callback notifies this when the ring buffer goes under
+     * the low-water mark, to wake up |decoder_thread_|.
+     */
+    EventNotifier decoder_wakeup_;
+    std::thread decoder_thread_;
+    std::atomic<bool> decoder_running_;
     std::atomic<int> playback_state_;
-    double current_time_;
+    std::atomic<double> current_time_;
 
     PaStreamParameters output_params_;
     PaStream *stream_;
 
-    Effect* effect_;
-    
-    float volume_;
+    /**
+     * @brief Control thread to audio callback : volume changes.
+     */
+    CommandQueue commands_;
+    /**
+     * @brief Control thread to decoder thread : seeks.
+     */
+    CommandQueue decoder_commands_;
+    /**
+     * @brief Decoder thread to audio callback : where to skip to after a
+     * seek.
+     */
+    CommandQueue decoder_events_;
+    /**
+     * @brief The position of the last flush in the ring buffer. Decoder
+     * thread only.
+     */
+    size_t flush_position_;
+
+    EffectChain effects_;
+
+    /* Only touched by the audio callback. */
+    SmoothedValue volume_;
 };
 
 #endif
@@ -34,15 +34,15 @@ static long long unsigned get_free_disk_space(const char* path)
 #endif
 }
 
-AudioRecorder::AudioRecorder(const size_t chunk_size)
+AudioRecorder::AudioRecorder(const size_t chunk_size, RingStorage storage)
 :file_(0)
 ,chunk_size_(chunk_size)
+,storage_(storage)
 ,ring_buffer_(0)
 ,recording_status_(STOPPED)
 ,current_time_(0)
 ,stream_(0)
-,effect_(0)
-,buffer_recorded_(0)
+,frames_recorded_(0)
 { }
 
 AudioRecorder::~AudioRecorder()
@@ -64,7 +64,9 @@ int AudioRecorder::open(const char* file)
     return err;
   }
 
-  ring_buffer_ = new RingBuffer<SamplesType, 4>(chunk_size_);
+  // The host can call us back with any number of frames, leave some room.
+  ring_buffer_ = new FrameRingBuffer<SamplesType>(8 * chunk_size_, 1, storage_);
+  effects_.prepare(chunk_size_, file_->channels());
 
   err = Pa_Initialize();
   if(err != paNoError) {
@@ -124,10 +126,15 @@ bool AudioRecorder::state_machine()
     case SHOULD_STOP:
       break;
     case RECORDING:
-      if (ring_buffer_->available_read() != 0) {
-        SamplesType b[chunk_size_];
-        ring_buffer_->pop(b, chunk_size_);
-        file_->write_some(b, chunk_size_);
+      {
+        // Write straight from the ring buffer, and give the space back
+        // afterwards.
+        size_t frames;
+        SamplesType* span;
+        while ((span = ring_buffer_->peek_read(&frames)) && frames) {
+          file_->write_frames(span, frames);
+          ring_buffer_->release_read(frames);
+        }
       }
       break;
   }
@@ -136,8 +143,17 @@ bool AudioRecorder::state_machine()
 
 int AudioRecorder::insert(Effect* effect)
 {
-  effect_ = effect;
-  return 0;
+  return effects_.insert(effect);
+}
+
+int AudioRecorder::remove(Effect* effect)
+{
+  return effects_.remove(effect);
+}
+
+int AudioRecorder::bypass(Effect* effect, bool bypassed)
+{
+  return effects_.bypass(effect, bypassed);
 }
 
 int AudioRecorder::stop()
@@ -163,6 +179,14 @@ int AudioRecorder::stop()
   return 0;
 }
 
+int AudioRecorder::samplerate()
+{
+  if (file_) {
+    return file_->samplerate();
+  }
+  return 0;
+}
+
 long long unsigned AudioRecorder::free_disk_space()
 {
   return get_free_disk_space(file_->path());
@@ -170,7 +194,7 @@ long long unsigned AudioRecorder::free_disk_space()
 
 double AudioRecorder::current_time()
 {
-  return static_cast<double>(buffer_recorded_) * chunk_size_ / file_->samplerate();
+  return static_cast<double>(frames_recorded_) / file_->samplerate();
 }
 
 int AudioRecorder::audio_callback(const void * inputBuffer,
@@ -193,7 +217,7 @@ int AudioRecorder::audio_callback_m(const void * inputBuffer,
                                     void *user_data)
 {
   AudioRecorder* a = static_cast<AudioRecorder*>(user_data);
-  RingBuffer<SamplesType, 4>* ring = a->ring_buffer_;
+  FrameRingBuffer<SamplesType>* ring = a->ring_buffer_;
   SamplesType* in = (SamplesType*)inputBuffer;
 
   if (a->recording_status_ == SHOULD_STOP) {
@@ -202,12 +226,13 @@ int AudioRecorder::audio_callback_m(const void * inputBuffer,
 
   a->recording_status_ = RECORDING;
 
-  if (effect_) {
-    effect_->process(in, framesPerBuffer, file_->channels());
-  }
+  effects_.process(in, framesPerBuffer, file_->channels());
 
-  buffer_recorded_++;
-  ring->push(in, framesPerBuffer);
+  size_t written = ring->write(in, framesPerBuffer);
+  if (written != framesPerBuffer) {
+    VAGG_LOG(VAGG_LOG_WARNING, "OVERRUN, %lu frames lost", framesPerBuffer - written);
+  }
+  frames_recorded_ += written;
 
   return paContinue;
 }
@@ -1,9 +1,10 @@
 #ifndef AUDIORECORDER_HPP
 #define AUDIORECORDER_HPP
 
-#include "RingBuffer.hpp"
+#include "FrameRingBuffer.hpp"
 #include "AudioFile.hpp"
 #include "Effect.hpp"
+#include "EffectChain.hpp"
 #include "types.hpp"
 #include <atomic>
 
@@ -15,14 +16,32 @@
 class AudioRecorder
 {
   public:
-    AudioRecorder(const size_t chunk_size);
+    /**
+     * @param chunk_size The number of frames asked to the host at once.
+     * @param storage MirroredStorage to always write contiguous blocks to the
+     * disk, even when they wrap around the end of the ring buffer.
+     */
+    AudioRecorder(const size_t chunk_size, RingStorage storage = HeapStorage);
     ~AudioRecorder();
     int open(const char* file);
     int record();
     bool state_machine();
+    /**
+     * @brief Add an effect at the end of the effect chain. The effect is not
+     * owned by the recorder, and must outlive it, or be removed first.
+     */
     int insert(Effect* effect);
+    /**
+     * @brief Take an effect out of the effect chain.
+     */
+    int remove(Effect* effect);
+    /**
+     * @brief Skip an effect of the chain, or stop skipping it.
+     */
+    int bypass(Effect* effect, bool bypassed);
     int stop();
     double current_time();
+    int samplerate();
     long long unsigned free_disk_space();
   protected:
     /** Callbacks **/
@@ -46,15 +65,16 @@ class AudioRecorder
     /** Members **/
     AudioFile* file_;
     const size_t chunk_size_;
-    RingBuffer<SamplesType,4>* ring_buffer_;
+    const RingStorage storage_;
+    FrameRingBuffer<SamplesType>* ring_buffer_;
     std::atomic<int> recording_status_;
     double current_time_;
 
     PaStreamParameters input_params_;
     PaStream *stream_;
 
-    Effect* effect_;
-    size_t buffer_recorded_;
+    EffectChain effects_;
+    size_t frames_recorded_;
 };
 
 #endif
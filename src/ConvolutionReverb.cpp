@@ -0,0 +1,126 @@
+#include "ConvolutionReverb.hpp"
+#include "AudioFile.hpp"
+#include "vagg/vagg_macros.h"
+
+#include <string.h>
+
+ConvolutionReverb::ConvolutionReverb(size_t block)
+  :fft_(2 * block),block_(block),bins_(2 * block + 2),channels_(0)
+  ,partitions_(0),wet_(0.3f),history_index_(0),position_(0)
+  ,sum_(bins_),time_(2 * block)
+{ }
+
+int ConvolutionReverb::load(const char* path, size_t channels)
+{
+  AudioFile file(path);
+  if (file.open(AudioFile::ReadMapped)) {
+    return -1;
+  }
+
+  // Read the whole file, one buffer per channel.
+  size_t file_channels = file.channels();
+  std::vector<std::vector<float> > planes(file_channels);
+  std::vector<float*> pointers(file_channels);
+  size_t frames = 0;
+  size_t count;
+  do {
+    for (size_t c = 0; c < file_channels; c++) {
+      planes[c].resize(frames + block_);
+      pointers[c] = &planes[c][frames];
+    }
+    count = file.read_planar(&pointers[0], block_);
+    if (count == static_cast<size_t>(-1)) {
+      count = 0;
+    }
+    frames += count;
+  } while (count == block_);
+  if (! frames) {
+    VAGG_LOG(VAGG_LOG_FATAL, "Empty impulse response : %s", path);
+    return -1;
+  }
+
+  channels_ = channels;
+  partitions_ = (frames + block_ - 1) / block_;
+  response_.assign(channels_ * partitions_ * bins_, 0);
+  history_.assign(channels_ * partitions_ * bins_, 0);
+  input_.assign(channels_ * 2 * block_, 0);
+  output_.assign(channels_ * block_, 0);
+  history_index_ = 0;
+  position_ = 0;
+
+  // Each partition is zero padded to the transform size. The inverse
+  // transform is not scaled, the partitions are instead.
+  float scale = 1.0f / fft_.size();
+  for (size_t c = 0; c < channels_; c++) {
+    size_t source = c % file_channels;
+    for (size_t p = 0; p < partitions_; p++) {
+      for (size_t i = 0; i < 2 * block_; i++) {
+        size_t frame = p * block_ + i;
+        time_[i] = i < block_ && frame < frames ? planes[source][frame] * scale : 0;
+      }
+      fft_.forward(&time_[0], spectrum(response_, c, p));
+    }
+  }
+  VAGG_LOG(VAGG_LOG_OK, "Impulse response %s : %zu frames, %zu partitions of %zu",
+           path, frames, partitions_, block_);
+  return 0;
+}
+
+void ConvolutionReverb::set_wet(float wet)
+{
+  wet_.store(wet, std::memory_order_relaxed);
+}
+
+void ConvolutionReverb::process(SamplesType* samples, size_t length, size_t channels)
+{
+  if (channels != channels_ || ! partitions_) {
+    return;
+  }
+  float wet = wet_.load(std::memory_order_relaxed);
+  float dry = 1 - wet;
+  for (size_t i = 0; i < length; i++) {
+    for (size_t c = 0; c < channels; c++) {
+      // The new block goes in the second half of the input.
+      input_[c * 2 * block_ + block_ + position_] = samples[c];
+      samples[c] = dry * samples[c] + wet * output_[c * block_ + position_];
+    }
+    samples += channels;
+    if (++position_ == block_) {
+      position_ = 0;
+      convolve();
+    }
+  }
+}
+
+void ConvolutionReverb::convolve()
+{
+  size_t half = bins_ / 2;
+  for (size_t c = 0; c < channels_; c++) {
+    float* input = &input_[c * 2 * block_];
+    fft_.forward(input, spectrum(history_, c, history_index_));
+    // Slide : the new block becomes the previous one.
+    memcpy(input, input + block_, block_ * sizeof(float));
+
+    // The newest input goes with the first partition, the oldest with the
+    // last.
+    memset(&sum_[0], 0, bins_ * sizeof(float));
+    float* sum = &sum_[0];
+    for (size_t p = 0; p < partitions_; p++) {
+      size_t index = (history_index_ + partitions_ - p) % partitions_;
+      const float* x = spectrum(history_, c, index);
+      const float* h = spectrum(response_, c, p);
+      for (size_t k = 0; k < half; k++) {
+        float xr = x[2 * k], xi = x[2 * k + 1];
+        float hr = h[2 * k], hi = h[2 * k + 1];
+        sum[2 * k] += xr * hr - xi * hi;
+        sum[2 * k + 1] += xr * hi + xi * hr;
+      }
+    }
+
+    // Overlap-save : the first half is wrapped around, the second half is
+    // the output.
+    fft_.inverse(sum, &time_[0]);
+    memcpy(&output_[c * block_], &time_[block_], block_ * sizeof(float));
+  }
+  history_index_ = (history_index_ + 1) % partitions_;
+}
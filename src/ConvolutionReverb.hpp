@@ -0,0 +1,88 @@
+#ifndef CONVOLUTIONREVERB_HPP
+#define CONVOLUTIONREVERB_HPP
+
+#include "types.hpp"
+#include "Effect.hpp"
+#include "FFT.hpp"
+
+#include <atomic>
+#include <vector>
+
+/**
+ * @brief A reverb that convolves the signal with an impulse response read
+ * from a file.
+ *
+ * The convolution is uniformly partitioned overlap-save : the impulse
+ * response is cut in partitions of |block| frames, each transformed once at
+ * load time. Every |block| frames, the last two blocks of input are
+ * transformed, pushed in a delay line of spectra, and multiplied with the
+ * partitions, so that the output is late by exactly one block. The cost per
+ * sample is one transform of 2 * |block| points plus one complex
+ * multiply-add per partition and bin, so it grows with the length of the
+ * impulse response divided by |block|.
+ *
+ * load() allocates everything, process() does not. load() is not to be
+ * called while the effect is in a chain that is running.
+ */
+class ConvolutionReverb : public Effect
+{
+  public:
+    /**
+     * @param block The partition size, and the latency, in frames, a power of
+     * two.
+     */
+    ConvolutionReverb(size_t block = 1024);
+    /**
+     * @brief Read the impulse response in |path|, for a signal of |channels|
+     * channels. Channel c of the signal goes through channel c of the
+     * impulse response, modulo its number of channels.
+     *
+     * @return -1 if the file can't be read.
+     */
+    int load(const char* path, size_t channels);
+    /**
+     * @brief The part of reverberated signal in the output, from 0 to 1. Any
+     * thread.
+     */
+    void set_wet(float wet);
+    /**
+     * @brief Signals with another number of channels than the one given to
+     * load() are left untouched.
+     */
+    virtual void process(SamplesType* samples, size_t length, size_t channels);
+  protected:
+    /**
+     * @brief Convolve the block of input gathered for each channel.
+     */
+    void convolve();
+    /**
+     * @brief The spectrum of partition |p| of channel |c|, in |spectra|.
+     */
+    float* spectrum(std::vector<float>& spectra, size_t c, size_t p)
+    {
+      return &spectra[(c * partitions_ + p) * bins_];
+    }
+
+    FFT fft_;
+    size_t block_;
+    /* The number of floats in a spectrum. */
+    size_t bins_;
+    size_t channels_;
+    size_t partitions_;
+    std::atomic<float> wet_;
+
+    std::vector<float> response_;
+    /* The spectra of the last |partitions_| input blocks, per channel. */
+    std::vector<float> history_;
+    size_t history_index_;
+    /* The last two input blocks of each channel. */
+    std::vector<float> input_;
+    /* The output block being played, per channel. */
+    std::vector<float> output_;
+    /* Where the current block is at. */
+    size_t position_;
+    std::vector<float> sum_;
+    std::vector<float> time_;
+};
+
+#endif
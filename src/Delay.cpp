@@ -0,0 +1,85 @@
+#include "Delay.hpp"
+
+#include <string.h>
+
+Delay::Delay(int samplerate, size_t channels, double max_delay)
+  :samplerate_(samplerate),channels_(channels),write_index_(0)
+  ,delay_target_(1),feedback_(0),wet_(0.5f),delay_(1)
+{
+  // Room for the longest delay, and the frame after it for the
+  // interpolation.
+  max_frames_ = max_delay * samplerate;
+  capacity_ = 1;
+  while (capacity_ < static_cast<size_t>(max_frames_) + 2) {
+    capacity_ <<= 1;
+  }
+  buffer_ = new SamplesType[capacity_ * channels_];
+  memset(buffer_, 0, capacity_ * channels_ * sizeof(SamplesType));
+  delay_.set_ramp(SmoothedValue::Linear, samplerate * DELAY_RAMP_MS / 1000);
+}
+
+Delay::~Delay()
+{
+  delete [] buffer_;
+}
+
+void Delay::set_delay(double seconds)
+{
+  float frames = seconds * samplerate_;
+  if (frames < 1) {
+    frames = 1;
+  }
+  if (frames > max_frames_) {
+    frames = max_frames_;
+  }
+  delay_target_.store(frames, std::memory_order_relaxed);
+}
+
+void Delay::set_feedback(float feedback)
+{
+  if (! (feedback > 0)) {
+    feedback = 0;
+  }
+  if (feedback > DELAY_MAX_FEEDBACK) {
+    feedback = DELAY_MAX_FEEDBACK;
+  }
+  feedback_.store(feedback, std::memory_order_relaxed);
+}
+
+void Delay::set_wet(float wet)
+{
+  wet_.store(wet, std::memory_order_relaxed);
+}
+
+void Delay::process(SamplesType* samples, size_t length, size_t channels)
+{
+  if (channels != channels_) {
+    return;
+  }
+  float target = delay_target_.load(std::memory_order_relaxed);
+  if (target != delay_.target()) {
+    delay_.set_target(target);
+  }
+  float feedback = feedback_.load(std::memory_order_relaxed);
+  float wet = wet_.load(std::memory_order_relaxed);
+  float dry = 1 - wet;
+  size_t mask = capacity_ - 1;
+
+  for (size_t i = 0; i < length; i++) {
+    float delay = delay_.next();
+    size_t whole = static_cast<size_t>(delay);
+    float fraction = delay - whole;
+    // The two frames around the delayed position, the newer one first.
+    const SamplesType* newer = buffer_ + ((write_index_ - whole) & mask) * channels;
+    const SamplesType* older = buffer_ + ((write_index_ - whole - 1) & mask) * channels;
+    SamplesType* write = buffer_ + write_index_ * channels;
+    for (size_t c = 0; c < channels; c++) {
+      float delayed = newer[c] + (older[c] - newer[c]) * fraction;
+      float in = samples[c];
+      write[c] = in + delayed * feedback;
+      samples[c] = dry * in + wet * delayed;
+    }
+    samples += channels;
+    write_index_ = (write_index_ + 1) & mask;
+  }
+}
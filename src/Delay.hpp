@@ -0,0 +1,74 @@
+#ifndef DELAY_HPP
+#define DELAY_HPP
+
+#include "types.hpp"
+#include "Effect.hpp"
+#include "SmoothedValue.hpp"
+
+#include <atomic>
+
+/**
+ * @brief The time a change of delay time takes, in milliseconds.
+ */
+#define DELAY_RAMP_MS 50
+/**
+ * @brief The largest feedback : the repeats of anything more never die out.
+ */
+#define DELAY_MAX_FEEDBACK 0.999f
+
+/**
+ * @brief A delay line with feedback, for interleaved blocks of any size.
+ *
+ * The delayed signal lives in a circular buffer of a power of two number of
+ * frames, sized from the longest delay asked at construction, so that
+ * wrapping around is a mask and nothing is allocated afterwards. The delay
+ * time is a fractional number of frames, read with linear interpolation,
+ * and moves smoothly to new values. The tail carries over from one block to
+ * the next.
+ */
+class Delay : public Effect
+{
+  public:
+    /**
+     * @param max_delay The longest delay that can be set, in seconds.
+     */
+    Delay(int samplerate, size_t channels, double max_delay);
+    ~Delay();
+    /**
+     * @brief Any thread. Clamped between one frame and the longest delay.
+     */
+    void set_delay(double seconds);
+    /**
+     * @brief How much of the delayed signal is fed back, clamped between 0
+     * and DELAY_MAX_FEEDBACK. Any thread.
+     */
+    void set_feedback(float feedback);
+    /**
+     * @brief The part of delayed signal in the output, from 0 to 1. Any
+     * thread.
+     */
+    void set_wet(float wet);
+    /**
+     * @brief Signals with another number of channels than the one given to
+     * the constructor are left untouched.
+     */
+    virtual void process(SamplesType* samples, size_t length, size_t channels);
+  protected:
+    Delay(const Delay&);
+    Delay& operator=(const Delay&);
+
+    int samplerate_;
+    size_t channels_;
+    size_t capacity_;
+    float max_frames_;
+    SamplesType* buffer_;
+    size_t write_index_;
+
+    std::atomic<float> delay_target_;
+    std::atomic<float> feedback_;
+    std::atomic<float> wet_;
+    /* Audio thread only : the delay, in frames. */
+    SmoothedValue delay_;
+};
+
+#endif
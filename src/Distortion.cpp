@@ -0,0 +1,214 @@
+#include "Distortion.hpp"
+#include "FastMath.hpp"
+#include "Interleave.hpp"
+
+#include <math.h>
+
+/* The highest soft clip knee, so that the part above it is not empty. */
+#define SOFTCLIP_MAX_KNEE 0.999f
+
+Distortion::Distortion(Shape shape, size_t channels, size_t oversampling)
+  :shape_(shape)
+  ,channels_(channels)
+  ,oversampler_(0)
+  ,planar_data_(0)
+  ,planar_(0)
+{
+  static const float defaults[] = {0.5f, 0.5f, 16.0f, 4.0f, 8.0f};
+  amount_.store(defaults[shape]);
+  if (oversampling > 1) {
+    oversampler_ = new Oversampler(channels_, oversampling, DISTORTION_CHUNK);
+    planar_data_ = new SamplesType[channels_ * DISTORTION_CHUNK];
+    planar_ = new SamplesType*[channels_];
+    for (size_t c = 0; c < channels_; c++) {
+      planar_[c] = planar_data_ + c * DISTORTION_CHUNK;
+    }
+  }
+}
+
+Distortion::~Distortion()
+{
+  delete oversampler_;
+  delete [] planar_data_;
+  delete [] planar_;
+}
+
+void Distortion::set_amount(float amount)
+{
+  amount_.store(amount, std::memory_order_relaxed);
+}
+
+void Distortion::process(SamplesType* samples, size_t length, size_t channels)
+{
+  float amount = amount_.load(std::memory_order_relaxed);
+  if (! oversampler_) {
+    // The curve does not depend on the channel.
+    shape(shape_, amount, samples, length * channels);
+    return;
+  }
+  if (channels != channels_) {
+    return;
+  }
+  for (size_t offset = 0; offset < length; offset += DISTORTION_CHUNK) {
+    size_t frames = length - offset < DISTORTION_CHUNK ? length - offset : DISTORTION_CHUNK;
+    SamplesType* chunk = samples + offset * channels;
+    deinterleave(chunk, planar_, frames, channels);
+    process_planar(planar_, frames, channels);
+    interleave(planar_, chunk, frames, channels);
+  }
+}
+
+void Distortion::process_planar(SamplesType** samples, size_t length, size_t channels)
+{
+  float amount = amount_.load(std::memory_order_relaxed);
+  if (! oversampler_) {
+    for (size_t c = 0; c < channels; c++) {
+      shape(shape_, amount, samples[c], length);
+    }
+    return;
+  }
+  if (channels != channels_) {
+    return;
+  }
+  size_t factor = oversampler_->factor();
+  for (size_t c = 0; c < channels; c++) {
+    for (size_t offset = 0; offset < length; offset += DISTORTION_CHUNK) {
+      size_t frames = length - offset < DISTORTION_CHUNK ? length - offset : DISTORTION_CHUNK;
+      SamplesType* up = oversampler_->up(samples[c] + offset, frames, c);
+      shape(shape_, amount, up, frames * factor);
+      oversampler_->down(samples[c] + offset, frames, c);
+    }
+  }
+}
+
+void Distortion::shape(Shape shape, float amount, SamplesType* samples, size_t count)
+{
+  size_t i = 0;
+  switch (shape) {
+    case SoftClip:
+      {
+        float knee = amount < 0 ? 0 : (amount > SOFTCLIP_MAX_KNEE ? SOFTCLIP_MAX_KNEE : amount);
+        float range = 1 - knee;
+        float inverse_range = 1 / range;
+#ifdef __SSE2__
+        __m128 sign_mask = _mm_castsi128_ps(_mm_set1_epi32(0x80000000));
+        __m128 k = _mm_set1_ps(knee);
+        __m128 r = _mm_set1_ps(range);
+        __m128 ir = _mm_set1_ps(inverse_range);
+        for (; i + 4 <= count; i += 4) {
+          __m128 x = _mm_loadu_ps(samples + i);
+          __m128 sign = _mm_and_ps(x, sign_mask);
+          __m128 a = _mm_xor_ps(x, sign);
+          __m128 over = _mm_cmpgt_ps(a, k);
+          __m128 knee_part = _mm_add_ps(k, _mm_mul_ps(r, fast_tanh_ps(_mm_mul_ps(_mm_sub_ps(a, k), ir))));
+          a = _mm_or_ps(_mm_andnot_ps(over, a), _mm_and_ps(over, knee_part));
+          _mm_storeu_ps(samples + i, _mm_xor_ps(a, sign));
+        }
+#endif
+        for (; i < count; i++) {
+          float x = samples[i];
+          float a = fabsf(x);
+          if (a > knee) {
+            a = knee + range * fast_tanh((a - knee) * inverse_range);
+            samples[i] = x < 0 ? -a : a;
+          }
+        }
+      }
+      break;
+    case Foldback:
+      {
+        // Past the threshold, the signal bounces between -threshold and
+        // threshold : a triangle wave of period 4 * threshold.
+        float threshold = amount > 0 ? amount : 0;
+        if (threshold == 0) {
+          break;
+        }
+        float period = 4 * threshold;
+        float inverse_period = 1 / period;
+#ifdef __SSE2__
+        __m128 abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+        __m128 t = _mm_set1_ps(threshold);
+        __m128 t2 = _mm_set1_ps(2 * threshold);
+        __m128 p = _mm_set1_ps(period);
+        __m128 ip = _mm_set1_ps(inverse_period);
+        for (; i + 4 <= count; i += 4) {
+          __m128 x = _mm_loadu_ps(samples + i);
+          __m128 over = _mm_cmpgt_ps(_mm_and_ps(x, abs_mask), t);
+          __m128 y = _mm_sub_ps(x, t);
+          __m128 m = _mm_sub_ps(y, _mm_mul_ps(p, floor_ps(_mm_mul_ps(y, ip))));
+          __m128 folded = _mm_sub_ps(_mm_and_ps(_mm_sub_ps(m, t2), abs_mask), t);
+          _mm_storeu_ps(samples + i, _mm_or_ps(_mm_andnot_ps(over, x), _mm_and_ps(over, folded)));
+        }
+#endif
+        for (; i < count; i++) {
+          float x = samples[i];
+          if (x > threshold || x < -threshold) {
+            float y = x - threshold;
+            float m = y - period * floorf(y * inverse_period);
+            samples[i] = fabsf(m - 2 * threshold) - threshold;
+          }
+        }
+      }
+      break;
+    case Atan:
+      {
+        float drive = amount > 0 ? amount : 1;
+        float scale = 1 / fast_atan(drive);
+#ifdef __SSE2__
+        __m128 d = _mm_set1_ps(drive);
+        __m128 s = _mm_set1_ps(scale);
+        for (; i + 4 <= count; i += 4) {
+          __m128 x = _mm_loadu_ps(samples + i);
+          _mm_storeu_ps(samples + i, _mm_mul_ps(s, fast_atan_ps(_mm_mul_ps(d, x))));
+        }
+#endif
+        for (; i < count; i++) {
+          samples[i] = scale * fast_atan(drive * samples[i]);
+        }
+      }
+      break;
+    case Tanh:
+      {
+        float drive = amount > 0 ? amount : 1;
+        float scale = 1 / fast_tanh(drive);
+#ifdef __SSE2__
+        __m128 d = _mm_set1_ps(drive);
+        __m128 s = _mm_set1_ps(scale);
+        for (; i + 4 <= count; i += 4) {
+          __m128 x = _mm_loadu_ps(samples + i);
+          _mm_storeu_ps(samples + i, _mm_mul_ps(s, fast_tanh_ps(_mm_mul_ps(d, x))));
+        }
+#endif
+        for (; i < count; i++) {
+          samples[i] = scale * fast_tanh(drive * samples[i]);
+        }
+      }
+      break;
+    case BitCrush:
+      {
+        int bits = static_cast<int>(amount);
+        bits = bits < 1 ? 1 : (bits > 24 ? 24 : bits);
+        float steps = static_cast<float>(1 << bits);
+        float inverse_steps = 1 / steps;
+#ifdef __SSE2__
+        // Clamped to full scale first, so that the conversion to integers
+        // cannot overflow.
+        __m128 one = _mm_set1_ps(1.0f);
+        __m128 minus_one = _mm_set1_ps(-1.0f);
+        __m128 s = _mm_set1_ps(steps);
+        __m128 is = _mm_set1_ps(inverse_steps);
+        for (; i + 4 <= count; i += 4) {
+          __m128 x = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(samples + i), minus_one), one);
+          __m128 q = _mm_cvtepi32_ps(_mm_cvttps_epi32(_mm_mul_ps(x, s)));
+          _mm_storeu_ps(samples + i, _mm_mul_ps(q, is));
+        }
+#endif
+        for (; i < count; i++) {
+          float x = samples[i];
+          x = x < -1 ? -1 : (x > 1 ? 1 : x);
+          samples[i] = static_cast<int>(x * steps) * inverse_steps;
+        }
+      }
+      break;
+  }
+}
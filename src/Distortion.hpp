@@ -0,0 +1,95 @@
+#ifndef DISTORTION_HPP
+#define DISTORTION_HPP
+
+#include "types.hpp"
+#include "Effect.hpp"
+#include "Oversampler.hpp"
+
+#include <atomic>
+
+/**
+ * @brief The number of frames shaped at once when oversampling.
+ */
+#define DISTORTION_CHUNK 256
+
+/**
+ * @brief A waveshaper : each sample goes through the same non-linear
+ * curve.
+ *
+ * The curves use the approximations of FastMath.hpp instead of libm, and
+ * run four samples at a time. The new harmonics can go past the Nyquist
+ * frequency and fold back as aliasing : with oversampling, the curve runs
+ * at 2, 4 or 8 times the samplerate (see Oversampler), and the harmonics
+ * above the original band are filtered out before coming back down. This
+ * adds Oversampler::latency() frames of delay.
+ */
+class Distortion : public Effect
+{
+  public:
+    enum Shape {
+      /**
+       * @brief Linear up to the amount, from 0 to 1, then a tanh knee up to
+       * 1.
+       */
+      SoftClip,
+      /**
+       * @brief What goes past the amount, above 0, is folded back towards 0,
+       * as many times as needed.
+       */
+      Foldback,
+      /**
+       * @brief atan(amount * x) / atan(amount), where the amount is the
+       * drive, above 0. Full scale stays full scale.
+       */
+      Atan,
+      /**
+       * @brief tanh(amount * x) / tanh(amount), where the amount is the
+       * drive, above 0. Full scale stays full scale.
+       */
+      Tanh,
+      /**
+       * @brief Truncate to the amount bits of resolution, from 1 to 24.
+       */
+      BitCrush
+    };
+
+    /**
+     * @param oversampling 1 to run at the samplerate, or 2, 4 or 8.
+     */
+    Distortion(Shape shape, size_t channels, size_t oversampling = 1);
+    ~Distortion();
+    /**
+     * @brief See Shape for what the amount means for each curve. Any thread.
+     */
+    void set_amount(float amount);
+    /**
+     * @brief When oversampling, each channel is filtered on its own.
+     */
+    virtual bool planar() const
+    {
+      return oversampler_ != 0;
+    }
+    /**
+     * @brief When oversampling, signals with another number of channels than
+     * the one given to the constructor are left untouched.
+     */
+    virtual void process(SamplesType* samples, size_t length, size_t channels);
+    virtual void process_planar(SamplesType** samples, size_t length, size_t channels);
+    /**
+     * @brief Run the curve on |count| samples, in place.
+     */
+    static void shape(Shape shape, float amount, SamplesType* samples, size_t count);
+  protected:
+    Distortion(const Distortion&);
+    Distortion& operator=(const Distortion&);
+
+    Shape shape_;
+    size_t channels_;
+    std::atomic<float> amount_;
+    Oversampler* oversampler_;
+    /* One chunk per channel, for process() when oversampling. */
+    SamplesType* planar_data_;
+    SamplesType** planar_;
+};
+
+#endif
@@ -6,8 +6,25 @@
 class Effect
 {
   public:
+    virtual ~Effect() {}
     // |length * channels| is the size of |samples|.
     virtual void process(SamplesType* samples, size_t length, size_t channels) = 0;
+    /**
+     * @brief Whether process_planar() should be called instead of process(),
+     * when the chain can provide one buffer per channel.
+     */
+    virtual bool planar() const
+    {
+      return false;
+    }
+    /**
+     * @brief Same as process(), on one contiguous buffer per channel.
+     *
+     * |channels| pointers to |length| samples each.
+     */
+    virtual void process_planar(SamplesType** /* samples */, size_t /* length */,
+                                size_t /* channels */)
+    { }
 };
 
 #endif
@@ -0,0 +1,132 @@
+#include "EffectChain.hpp"
+#include "Interleave.hpp"
+
+EffectChain::EffectChain()
+  :max_frames_(0)
+  ,links_(new Links())
+  ,processed_(0)
+{ }
+
+EffectChain::~EffectChain()
+{
+  for (size_t i = 0; i < retired_.size(); i++) {
+    delete retired_[i].links;
+  }
+  delete links_.load();
+}
+
+int EffectChain::insert(Effect* effect)
+{
+  Links* links = new Links(*links_.load(std::memory_order_acquire));
+  Link link;
+  link.effect = effect;
+  link.bypassed = false;
+  links->push_back(link);
+  publish(links);
+  return 0;
+}
+
+int EffectChain::remove(Effect* effect)
+{
+  Links* links = new Links(*links_.load(std::memory_order_acquire));
+  for (Links::iterator it = links->begin(); it != links->end(); ++it) {
+    if (it->effect == effect) {
+      links->erase(it);
+      publish(links);
+      return 0;
+    }
+  }
+  delete links;
+  return -1;
+}
+
+int EffectChain::bypass(Effect* effect, bool bypassed)
+{
+  Links* links = new Links(*links_.load(std::memory_order_acquire));
+  for (Links::iterator it = links->begin(); it != links->end(); ++it) {
+    if (it->effect == effect) {
+      it->bypassed = bypassed;
+      publish(links);
+      return 0;
+    }
+  }
+  delete links;
+  return -1;
+}
+
+void EffectChain::prepare(size_t max_frames, size_t channels)
+{
+  planar_data_.assign(max_frames * channels, 0);
+  planar_.resize(channels);
+  for (size_t c = 0; c < channels; c++) {
+    planar_[c] = &planar_data_[c * max_frames];
+  }
+  max_frames_ = max_frames;
+}
+
+void EffectChain::process(SamplesType* samples, size_t length, size_t channels)
+{
+  // Sequentially consistent, with the increment below and the two accesses
+  // of publish(), see there.
+  Links* links = links_.load(std::memory_order_seq_cst);
+  bool can_split = length <= max_frames_ && channels == planar_.size();
+  // Whether the block currently lives in |planar_|.
+  bool split = false;
+  for (size_t i = 0; i < links->size(); i++) {
+    const Link& link = (*links)[i];
+    if (link.bypassed) {
+      continue;
+    }
+    if (can_split && link.effect->planar()) {
+      if (! split) {
+        deinterleave(samples, &planar_[0], length, channels);
+        split = true;
+      }
+      link.effect->process_planar(&planar_[0], length, channels);
+    } else {
+      if (split) {
+        interleave(&planar_[0], samples, length, channels);
+        split = false;
+      }
+      link.effect->process(samples, length, channels);
+    }
+  }
+  if (split) {
+    interleave(&planar_[0], samples, length, channels);
+  }
+  processed_.fetch_add(1, std::memory_order_seq_cst);
+}
+
+void EffectChain::publish(Links* links)
+{
+  Retired retired;
+  // A block that started before the swap can still be using the old list,
+  // it will be done when the count goes past the value read after the swap.
+  //
+  // Acquire and release are not enough : the swap and the load of the count
+  // here, and the increment and the load of the list in process(), could
+  // each see a stale value on weakly ordered processors. With the four of
+  // them sequentially consistent, they happen in a single order. If a block
+  // loaded the old list, its load came before the swap, so the increment of
+  // the block before it came before the load of the count here : the count
+  // read is at most one block behind, and the list is only freed once the
+  // count has gone past it, after that block.
+  retired.links = links_.exchange(links, std::memory_order_seq_cst);
+  retired.processed = processed_.load(std::memory_order_seq_cst);
+  retired_.push_back(retired);
+  collect();
+}
+
+void EffectChain::collect()
+{
+  uint64_t processed = processed_.load(std::memory_order_acquire);
+  size_t kept = 0;
+  for (size_t i = 0; i < retired_.size(); i++) {
+    if (processed > retired_[i].processed) {
+      delete retired_[i].links;
+    } else {
+      retired_[kept++] = retired_[i];
+    }
+  }
+  retired_.resize(kept);
+}
@@ -0,0 +1,106 @@
+#ifndef EFFECTCHAIN_HPP
+#define EFFECTCHAIN_HPP
+
+#include "Effect.hpp"
+#include "types.hpp"
+
+#include <atomic>
+#include <vector>
+#include <stdint.h>
+
+/**
+ * @brief An ordered list of effects, processed one after the other, in place,
+ * on the same buffer.
+ *
+ * The list is edited from a control thread, and processed from the audio
+ * thread, without locks : an edit copies the current list, changes the copy,
+ * and publishes it with an atomic pointer swap. The audio thread counts the
+ * blocks it has processed, and a replaced list is only freed, by a later
+ * edit or by the destructor, once the audio thread has finished a block
+ * after the swap, so that it cannot be using it anymore.
+ *
+ * Effects that ask for it get one contiguous buffer per channel : the chain
+ * deinterleaves the block once before the first of them, and interleaves it
+ * back before the next effect that does not, or at the end. The planar
+ * buffers are allocated by prepare(), the audio thread never allocates.
+ *
+ * The effects are not owned by the chain.
+ */
+class EffectChain
+{
+  public:
+    EffectChain();
+    ~EffectChain();
+    /**
+     * @brief Add an effect at the end of the chain. Control thread only.
+     */
+    int insert(Effect* effect);
+    /**
+     * @brief Take an effect out of the chain. Control thread only. Once this
+     * returns, the effect can still be in use until the end of the current
+     * block.
+     *
+     * @return -1 if the effect is not in the chain.
+     */
+    int remove(Effect* effect);
+    /**
+     * @brief Skip an effect, or stop skipping it, without taking it out of
+     * the chain. Control thread only.
+     *
+     * @return -1 if the effect is not in the chain.
+     */
+    int bypass(Effect* effect, bool bypassed);
+    /**
+     * @brief Allocate the planar buffers for blocks of up to |max_frames|
+     * frames of |channels| channels. Not to be called while the audio thread
+     * processes. Larger blocks are processed interleaved.
+     */
+    void prepare(size_t max_frames, size_t channels);
+    /**
+     * @brief Run all the effects that are not bypassed on |samples|, in
+     * order. Audio thread only.
+     *
+     * @param samples |length * channels| interleaved samples.
+     */
+    void process(SamplesType* samples, size_t length, size_t channels);
+  protected:
+    EffectChain(const EffectChain&);
+    EffectChain& operator=(const EffectChain&);
+
+    struct Link {
+      Effect* effect;
+      bool bypassed;
+    };
+    typedef std::vector<Link> Links;
+
+    /**
+     * @brief A list that has been replaced, and the number of blocks
+     * processed when it was.
+     */
+    struct Retired {
+      Links* links;
+      uint64_t processed;
+    };
+
+    /**
+     * @brief Swap |links| in, and retire the previous list.
+     */
+    void publish(Links* links);
+    /**
+     * @brief Free the retired lists that the audio thread cannot be using
+     * anymore.
+     */
+    void collect();
+
+    /* Audio thread only, once prepared. */
+    std::vector<SamplesType> planar_data_;
+    std::vector<SamplesType*> planar_;
+    size_t max_frames_;
+
+    std::atomic<Links*> links_;
+    std::atomic<uint64_t> processed_;
+    /* Control thread only. */
+    std::vector<Retired> retired_;
+};
+
+#endif
@@ -0,0 +1,207 @@
+#include "Equalizer.hpp"
+
+#include <math.h>
+#include <string.h>
+
+#ifdef __SSE__
+  #include <xmmintrin.h>
+#endif
+
+Equalizer::Equalizer(int samplerate, size_t channels)
+  :samplerate_(samplerate)
+  ,channels_(channels <= EQUALIZER_MAX_CHANNELS ? channels : 0)
+  ,band_count_(0)
+{
+  memset(z1_, 0, sizeof(z1_));
+  memset(z2_, 0, sizeof(z2_));
+  publish();
+}
+
+int Equalizer::add_band(Shape shape, float frequency, float gain, float q)
+{
+  if (band_count_ == EQUALIZER_MAX_BANDS) {
+    return -1;
+  }
+  band_count_++;
+  if (set_band(band_count_ - 1, shape, frequency, gain, q)) {
+    band_count_--;
+    return -1;
+  }
+  return band_count_ - 1;
+}
+
+int Equalizer::set_band(size_t band, Shape shape, float frequency, float gain, float q)
+{
+  if (band >= band_count_) {
+    return -1;
+  }
+  // Past these, the coefficients are not finite or the filter is unstable,
+  // and the state of the filters would never recover. Written so that NaN
+  // is rejected too.
+  if (! (q > 0) || ! (frequency > 0 && frequency < samplerate_ / 2.0)) {
+    return -1;
+  }
+  bands_[band].shape = shape;
+  bands_[band].frequency = frequency;
+  bands_[band].gain = gain;
+  bands_[band].q = q;
+  publish();
+  return 0;
+}
+
+void Equalizer::publish()
+{
+  EqualizerCoefficients& coefficients = coefficients_.write_buffer();
+  coefficients.bands = band_count_;
+  for (size_t i = 0; i < band_count_; i++) {
+    const Band& band = bands_[i];
+    double A = pow(10, band.gain / 40);
+    double w0 = 2 * M_PI * band.frequency / samplerate_;
+    double cosw = cos(w0);
+    double alpha = sin(w0) / (2 * band.q);
+    double shelf = 2 * sqrt(A) * alpha;
+    double b0, b1, b2, a0, a1, a2;
+    switch (band.shape) {
+      case Peak:
+        b0 = 1 + alpha * A;
+        b1 = -2 * cosw;
+        b2 = 1 - alpha * A;
+        a0 = 1 + alpha / A;
+        a1 = -2 * cosw;
+        a2 = 1 - alpha / A;
+        break;
+      case LowShelf:
+        b0 = A * ((A + 1) - (A - 1) * cosw + shelf);
+        b1 = 2 * A * ((A - 1) - (A + 1) * cosw);
+        b2 = A * ((A + 1) - (A - 1) * cosw - shelf);
+        a0 = (A + 1) + (A - 1) * cosw + shelf;
+        a1 = -2 * ((A - 1) + (A + 1) * cosw);
+        a2 = (A + 1) + (A - 1) * cosw - shelf;
+        break;
+      case HighShelf:
+        b0 = A * ((A + 1) + (A - 1) * cosw + shelf);
+        b1 = -2 * A * ((A - 1) + (A + 1) * cosw);
+        b2 = A * ((A + 1) + (A - 1) * cosw - shelf);
+        a0 = (A + 1) - (A - 1) * cosw + shelf;
+        a1 = 2 * ((A - 1) - (A + 1) * cosw);
+        a2 = (A + 1) - (A - 1) * cosw - shelf;
+        break;
+      case LowPass:
+        b0 = (1 - cosw) / 2;
+        b1 = 1 - cosw;
+        b2 = (1 - cosw) / 2;
+        a0 = 1 + alpha;
+        a1 = -2 * cosw;
+        a2 = 1 - alpha;
+        break;
+      case HighPass:
+      default:
+        b0 = (1 + cosw) / 2;
+        b1 = -(1 + cosw);
+        b2 = (1 + cosw) / 2;
+        a0 = 1 + alpha;
+        a1 = -2 * cosw;
+        a2 = 1 - alpha;
+        break;
+    }
+    coefficients.b0[i] = b0 / a0;
+    coefficients.b1[i] = b1 / a0;
+    coefficients.b2[i] = b2 / a0;
+    coefficients.a1[i] = a1 / a0;
+    coefficients.a2[i] = a2 / a0;
+  }
+  coefficients_.publish();
+}
+
+void Equalizer::process(SamplesType* samples, size_t length, size_t channels)
+{
+  if (channels != channels_) {
+    return;
+  }
+  coefficients_.update();
+  const EqualizerCoefficients& k = coefficients_.read_buffer();
+#ifdef __SSE__
+  process_sse(k, samples, length, channels);
+#else
+  process_scalar(k, samples, length, channels);
+#endif
+}
+
+#ifdef __SSE__
+void Equalizer::process_sse(const EqualizerCoefficients& k, SamplesType* samples,
+                            size_t length, size_t channels)
+{
+  size_t bands = k.bands;
+  __m128 b0[EQUALIZER_MAX_BANDS], b1[EQUALIZER_MAX_BANDS], b2[EQUALIZER_MAX_BANDS];
+  __m128 a1[EQUALIZER_MAX_BANDS], a2[EQUALIZER_MAX_BANDS];
+  for (size_t b = 0; b < bands; b++) {
+    b0[b] = _mm_set1_ps(k.b0[b]);
+    b1[b] = _mm_set1_ps(k.b1[b]);
+    b2[b] = _mm_set1_ps(k.b2[b]);
+    a1[b] = _mm_set1_ps(k.a1[b]);
+    a2[b] = _mm_set1_ps(k.a2[b]);
+  }
+
+  // Four channels at a time : the state stays in registers for the whole
+  // block.
+  for (size_t group = 0; group < channels; group += 4) {
+    size_t lanes = channels - group < 4 ? channels - group : 4;
+    __m128 z1[EQUALIZER_MAX_BANDS], z2[EQUALIZER_MAX_BANDS];
+    for (size_t b = 0; b < bands; b++) {
+      z1[b] = _mm_loadu_ps(&z1_[b][group]);
+      z2[b] = _mm_loadu_ps(&z2_[b][group]);
+    }
+    SamplesType* frame = samples + group;
+    for (size_t i = 0; i < length; i++) {
+      __m128 x;
+      float partial[4] = {0, 0, 0, 0};
+      if (lanes == 4) {
+        x = _mm_loadu_ps(frame);
+      } else {
+        for (size_t c = 0; c < lanes; c++) {
+          partial[c] = frame[c];
+        }
+        x = _mm_loadu_ps(partial);
+      }
+      for (size_t b = 0; b < bands; b++) {
+        __m128 y = _mm_add_ps(_mm_mul_ps(b0[b], x), z1[b]);
+        z1[b] = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(b1[b], x), _mm_mul_ps(a1[b], y)), z2[b]);
+        z2[b] = _mm_sub_ps(_mm_mul_ps(b2[b], x), _mm_mul_ps(a2[b], y));
+        x = y;
+      }
+      if (lanes == 4) {
+        _mm_storeu_ps(frame, x);
+      } else {
+        _mm_storeu_ps(partial, x);
+        for (size_t c = 0; c < lanes; c++) {
+          frame[c] = partial[c];
+        }
+      }
+      frame += channels;
+    }
+    for (size_t b = 0; b < bands; b++) {
+      _mm_storeu_ps(&z1_[b][group], z1[b]);
+      _mm_storeu_ps(&z2_[b][group], z2[b]);
+    }
+  }
+}
+#endif
+
+void Equalizer::process_scalar(const EqualizerCoefficients& k, SamplesType* samples,
+                               size_t length, size_t channels)
+{
+  size_t bands = k.bands;
+  for (size_t i = 0; i < length; i++) {
+    for (size_t c = 0; c < channels; c++) {
+      float x = samples[c];
+      for (size_t b = 0; b < bands; b++) {
+        float y = k.b0[b] * x + z1_[b][c];
+        z1_[b][c] = k.b1[b] * x - k.a1[b] * y + z2_[b][c];
+        z2_[b][c] = k.b2[b] * x - k.a2[b] * y;
+        x = y;
+      }
+      samples[c] = x;
+    }
+    samples += channels;
+  }
+}
@@ -0,0 +1,110 @@
+#ifndef EQUALIZER_HPP
+#define EQUALIZER_HPP
+
+#include "types.hpp"
+#include "Effect.hpp"
+#include "TripleBuffer.hpp"
+
+#define EQUALIZER_MAX_BANDS 16
+#define EQUALIZER_MAX_CHANNELS 8
+
+/**
+ * @brief The coefficients of all the bands, normalized so that a0 is 1.
+ */
+struct EqualizerCoefficients {
+  size_t bands;
+  float b0[EQUALIZER_MAX_BANDS];
+  float b1[EQUALIZER_MAX_BANDS];
+  float b2[EQUALIZER_MAX_BANDS];
+  float a1[EQUALIZER_MAX_BANDS];
+  float a2[EQUALIZER_MAX_BANDS];
+};
+
+/**
+ * @brief A parametric equalizer : a cascade of biquads, one per band, with
+ * the same settings for all the channels.
+ *
+ * The bands are set from a control thread, that computes the coefficients
+ * (RBJ cookbook formulas) and publishes them all at once through a
+ * TripleBuffer : the audio thread picks the new set up at the start of a
+ * block, and never sees half of an update.
+ *
+ * With SSE, the channels are processed side by side, four per vector : all
+ * the bands run on all the channels of a frame at once. The filters are in
+ * transposed direct form II.
+ */
+class Equalizer : public Effect
+{
+  public:
+    enum Shape {
+      Peak,
+      LowShelf,
+      HighShelf,
+      LowPass,
+      HighPass
+    };
+
+    Equalizer(int samplerate, size_t channels);
+    /**
+     * @brief Add a band after the others. Control thread only.
+     *
+     * @param frequency The center or cutoff frequency, in Hz, above 0 and
+     * below half the samplerate.
+     * @param gain The gain of the peak or the shelf, in dB.
+     * @param q The quality factor, above 0 : the higher, the narrower.
+     *
+     * @return The index of the band, or -1 if there are too many bands or
+     * the parameters are out of range.
+     */
+    int add_band(Shape shape, float frequency, float gain, float q);
+    /**
+     * @brief Change a band. Control thread only.
+     *
+     * @return -1 if there is no such band, or the parameters are out of
+     * range, see add_band(). The band is then left as it was.
+     */
+    int set_band(size_t band, Shape shape, float frequency, float gain, float q);
+    /**
+     * @brief Signals with another number of channels than the one given to
+     * the constructor are left untouched.
+     */
+    virtual void process(SamplesType* samples, size_t length, size_t channels);
+  protected:
+    struct Band {
+      Shape shape;
+      float frequency;
+      float gain;
+      float q;
+    };
+
+    /**
+     * @brief Compute the coefficients of all the bands, and publish them.
+     */
+    void publish();
+#ifdef __SSE__
+    void process_sse(const EqualizerCoefficients& k, SamplesType* samples,
+                     size_t length, size_t channels);
+#endif
+    /**
+     * @brief The same filters, a channel at a time, for processors without
+     * SSE.
+     */
+    void process_scalar(const EqualizerCoefficients& k, SamplesType* samples,
+                        size_t length, size_t channels);
+
+    int samplerate_;
+    size_t channels_;
+
+    /* Control thread only. */
+    Band bands_[EQUALIZER_MAX_BANDS];
+    size_t band_count_;
+
+    TripleBuffer<EqualizerCoefficients> coefficients_;
+
+    /* Audio thread only : the state of each band, for each channel, rounded
+     * up to a whole number of vectors. */
+    float z1_[EQUALIZER_MAX_BANDS][EQUALIZER_MAX_CHANNELS];
+    float z2_[EQUALIZER_MAX_BANDS][EQUALIZER_MAX_CHANNELS];
+};
+
+#endif
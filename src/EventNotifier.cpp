@@ -0,0 +1,79 @@
+#include "EventNotifier.hpp"
+#include "vagg/vagg_macros.h"
+
+#include <poll.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <stdint.h>
+
+#ifdef __linux__
+  #include <sys/eventfd.h>
+#endif
+
+EventNotifier::EventNotifier()
+  :read_fd_(-1)
+  ,write_fd_(-1)
+{
+#ifdef __linux__
+  read_fd_ = write_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (read_fd_ == -1) {
+    VAGG_LOG(VAGG_LOG_FATAL, "eventfd failed : %s", strerror(errno));
+  }
+#else
+  int fds[2];
+  if (pipe(fds) == -1) {
+    VAGG_LOG(VAGG_LOG_FATAL, "pipe failed : %s", strerror(errno));
+    return;
+  }
+  for (int i = 0; i < 2; i++) {
+    fcntl(fds[i], F_SETFL, fcntl(fds[i], F_GETFL) | O_NONBLOCK);
+  }
+  read_fd_ = fds[0];
+  write_fd_ = fds[1];
+#endif
+}
+
+EventNotifier::~EventNotifier()
+{
+  if (read_fd_ != -1) {
+    close(read_fd_);
+  }
+  if (write_fd_ != -1 && write_fd_ != read_fd_) {
+    close(write_fd_);
+  }
+}
+
+void EventNotifier::notify()
+{
+#ifdef __linux__
+  uint64_t one = 1;
+#else
+  char one = 1;
+#endif
+  if (write(write_fd_, &one, sizeof(one)) == -1) {
+    // The counter or the pipe is full : the waiter has been notified already.
+  }
+}
+
+bool EventNotifier::wait(int timeout_ms)
+{
+  struct pollfd p;
+  p.fd = read_fd_;
+  p.events = POLLIN;
+  p.revents = 0;
+  int rv = poll(&p, 1, timeout_ms);
+  if (rv <= 0) {
+    return false;
+  }
+  // Consume all the pending notifications.
+#ifdef __linux__
+  uint64_t count;
+  if (read(read_fd_, &count, sizeof(count)) == -1) {
+    // Someone else consumed it, this is fine.
+  }
+#else
+  char buffer[64];
+  while (read(read_fd_, buffer, sizeof(buffer)) > 0) { }
+#endif
+  return true;
+}
@@ -0,0 +1,41 @@
+#ifndef EVENTNOTIFIER_HPP
+#define EVENTNOTIFIER_HPP
+
+/**
+ * @brief Wake a thread up from another thread, without taking a lock.
+ *
+ * notify() never blocks, so that it can be called from the audio callback.
+ * Several notify() calls before a wait() only wake the waiter once. This is
+ * an eventfd on Linux, and a non-blocking pipe elsewhere.
+ */
+class EventNotifier
+{
+  public:
+    EventNotifier();
+    ~EventNotifier();
+    /**
+     * @brief Wake the waiting thread up. Never blocks.
+     */
+    void notify();
+    /**
+     * @brief Wait for a notify() call.
+     *
+     * @param timeout_ms The maximum time to wait, in milliseconds, or -1 to
+     * wait forever.
+     *
+     * @return true if woken up by notify(), false on timeout or error.
+     */
+    bool wait(int timeout_ms);
+  protected:
+    EventNotifier(const EventNotifier&);
+    EventNotifier& operator=(const EventNotifier&);
+
+    /**
+     * @brief The file descriptor to poll, and the one to write to. Both are
+     * the same eventfd on Linux.
+     */
+    int read_fd_;
+    int write_fd_;
+};
+
+#endif
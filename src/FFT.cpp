@@ -0,0 +1,174 @@
+#include "FFT.hpp"
+#include "vagg/vagg_macros.h"
+
+#include <math.h>
+
+FFT::FFT(size_t size)
+  :size_(size),half_(size / 2)
+{
+  if (size < 4 || (size & (size - 1))) {
+    VAGG_LOG(VAGG_LOG_FATAL, "FFT size must be a power of two, at least 4, was %zu", size);
+  }
+  size_t floats = half_ + half_ + 2 * half_ + 2 * half_;
+  arena_ = new char[floats * sizeof(float) + half_ * sizeof(uint32_t)];
+  twiddles_ = reinterpret_cast<float*>(arena_);
+  inverse_twiddles_ = twiddles_ + half_;
+  split_ = inverse_twiddles_ + half_;
+  work_ = split_ + 2 * half_;
+  reverse_ = reinterpret_cast<uint32_t*>(work_ + 2 * half_);
+
+  for (size_t k = 0; k < half_ / 2; k++) {
+    double angle = -2 * M_PI * k / half_;
+    twiddles_[2 * k] = inverse_twiddles_[2 * k] = cos(angle);
+    twiddles_[2 * k + 1] = sin(angle);
+    inverse_twiddles_[2 * k + 1] = -sin(angle);
+  }
+  for (size_t k = 0; k < half_; k++) {
+    double angle = -2 * M_PI * k / size_;
+    split_[2 * k] = cos(angle);
+    split_[2 * k + 1] = sin(angle);
+  }
+  size_t bits = 0;
+  while ((static_cast<size_t>(1) << bits) < half_) {
+    bits++;
+  }
+  for (size_t i = 0; i < half_; i++) {
+    uint32_t reversed = 0;
+    for (size_t b = 0; b < bits; b++) {
+      reversed |= ((i >> b) & 1) << (bits - 1 - b);
+    }
+    reverse_[i] = reversed;
+  }
+}
+
+FFT::~FFT()
+{
+  delete [] arena_;
+}
+
+void FFT::forward(const float* in, float* out)
+{
+  // The even samples as the real parts, the odd samples as the imaginary
+  // parts, in bit-reversed order.
+  for (size_t i = 0; i < half_; i++) {
+    size_t r = reverse_[i];
+    work_[2 * r] = in[2 * i];
+    work_[2 * r + 1] = in[2 * i + 1];
+  }
+  transform(work_, twiddles_, false);
+
+  // Split : X[k] = E[k] + exp(-2 pi i k / N) O[k], where E and O are the
+  // transforms of the even and odd samples, taken from Z[k] and Z[N/2 - k].
+  out[0] = work_[0] + work_[1];
+  out[1] = 0;
+  out[size_] = work_[0] - work_[1];
+  out[size_ + 1] = 0;
+  for (size_t k = 1; k < half_; k++) {
+    size_t m = half_ - k;
+    float zr = work_[2 * k], zi = work_[2 * k + 1];
+    float yr = work_[2 * m], yi = -work_[2 * m + 1];
+    float er = 0.5f * (zr + yr), ei = 0.5f * (zi + yi);
+    // O[k] = (Z[k] - conj(Z[N/2 - k])) / 2i
+    float or_ = 0.5f * (zi - yi), oi = -0.5f * (zr - yr);
+    float wr = split_[2 * k], wi = split_[2 * k + 1];
+    out[2 * k] = er + wr * or_ - wi * oi;
+    out[2 * k + 1] = ei + wr * oi + wi * or_;
+  }
+}
+
+void FFT::inverse(const float* in, float* out)
+{
+  // The reverse of the split step : Z[k] = E[k] + i O[k], with E and O taken
+  // back from X[k] and X[N/2 - k]. Each is twice its value, so that the
+  // output ends up multiplied by N.
+  for (size_t k = 0; k < half_; k++) {
+    size_t m = half_ - k;
+    float xr = in[2 * k], xi = in[2 * k + 1];
+    float yr = in[2 * m], yi = -in[2 * m + 1];
+    float er = xr + yr, ei = xi + yi;
+    float dr = xr - yr, di = xi - yi;
+    // O[k] = (X[k] - conj(X[N/2 - k])) exp(2 pi i k / N)
+    float wr = split_[2 * k], wi = -split_[2 * k + 1];
+    float or_ = dr * wr - di * wi, oi = dr * wi + di * wr;
+    size_t r = reverse_[k];
+    work_[2 * r] = er - oi;
+    work_[2 * r + 1] = ei + or_;
+  }
+  transform(work_, inverse_twiddles_, true);
+  for (size_t i = 0; i < half_; i++) {
+    out[2 * i] = work_[2 * i];
+    out[2 * i + 1] = work_[2 * i + 1];
+  }
+}
+
+void FFT::transform(float* data, const float* twiddles, bool inverse)
+{
+  size_t n = half_;
+  size_t q = 1;
+
+  // An odd number of stages : one radix-2 pass first, with no twiddles.
+  size_t stages = 0;
+  while ((static_cast<size_t>(1) << stages) < n) {
+    stages++;
+  }
+  if (stages & 1) {
+    for (size_t i = 0; i < n; i += 2) {
+      float ar = data[2 * i], ai = data[2 * i + 1];
+      float br = data[2 * i + 2], bi = data[2 * i + 3];
+      data[2 * i] = ar + br;
+      data[2 * i + 1] = ai + bi;
+      data[2 * i + 2] = ar - br;
+      data[2 * i + 3] = ai - bi;
+    }
+    q = 2;
+  }
+
+  // Two radix-2 stages per pass : blocks of 4q made of four transforms of
+  // size q, combined into two of size 2q, then into one of size 4q.
+  for (; q < n; q *= 4) {
+    size_t step1 = n / (2 * q);
+    size_t step2 = n / (4 * q);
+    for (size_t block = 0; block < n; block += 4 * q) {
+      float* x = data + 2 * block;
+      for (size_t j = 0; j < q; j++) {
+        float w1r = twiddles[2 * j * step1], w1i = twiddles[2 * j * step1 + 1];
+        float w2r = twiddles[2 * j * step2], w2i = twiddles[2 * j * step2 + 1];
+
+        float* a = x + 2 * j;
+        float* b = a + 2 * q;
+        float* c = b + 2 * q;
+        float* d = c + 2 * q;
+
+        // First stage : (a, b) and (c, d), with w1.
+        float tr = w1r * b[0] - w1i * b[1], ti = w1r * b[1] + w1i * b[0];
+        float a1r = a[0] + tr, a1i = a[1] + ti;
+        float b1r = a[0] - tr, b1i = a[1] - ti;
+        tr = w1r * d[0] - w1i * d[1];
+        ti = w1r * d[1] + w1i * d[0];
+        float c1r = c[0] + tr, c1i = c[1] + ti;
+        float d1r = c[0] - tr, d1i = c[1] - ti;
+
+        // Second stage : (a, c) with w2, (b, d) with w2 times -i (i for the
+        // inverse).
+        tr = w2r * c1r - w2i * c1i;
+        ti = w2r * c1i + w2i * c1r;
+        a[0] = a1r + tr;
+        a[1] = a1i + ti;
+        c[0] = a1r - tr;
+        c[1] = a1i - ti;
+        float ur = w2r * d1r - w2i * d1i, ui = w2r * d1i + w2i * d1r;
+        if (inverse) {
+          tr = -ui;
+          ti = ur;
+        } else {
+          tr = ui;
+          ti = -ur;
+        }
+        b[0] = b1r + tr;
+        b[1] = b1i + ti;
+        d[0] = b1r - tr;
+        d[1] = b1i - ti;
+      }
+    }
+  }
+}
@@ -0,0 +1,75 @@
+#ifndef FFT_HPP
+#define FFT_HPP
+
+#include "types.hpp"
+
+#include <stdint.h>
+
+/**
+ * @brief A fast Fourier transform of real signals, of a fixed power of two
+ * size.
+ *
+ * A real transform of size N is done as a complex transform of size N/2 on
+ * the even and odd samples, followed by a split step. The complex transform
+ * is iterative : the input is put in bit-reversed order, then the butterflies
+ * are done two radix-2 stages per pass (radix 2^2), with a single radix-2
+ * pass first when log2(N/2) is odd.
+ *
+ * The twiddle factors and the bit-reversal table are computed once, in a
+ * single allocation owned by the instance. forward() and inverse() do not
+ * allocate, and can be called from the audio thread.
+ *
+ * The spectra have N/2 + 1 bins, stored as interleaved real and imaginary
+ * parts, so N + 2 floats.
+ */
+class FFT
+{
+  public:
+    /**
+     * @param size The number of real samples, a power of two, at least 4.
+     */
+    FFT(size_t size);
+    ~FFT();
+    size_t size() const
+    {
+      return size_;
+    }
+    /**
+     * @brief The spectrum of |size()| real samples.
+     *
+     * @param out size() + 2 floats. Can't be |in|.
+     */
+    void forward(const float* in, float* out);
+    /**
+     * @brief The real samples of a spectrum, multiplied by size() : there is
+     * no scaling, so that callers can fold it into their own.
+     *
+     * @param in size() + 2 floats. Left untouched.
+     * @param out size() floats.
+     */
+    void inverse(const float* in, float* out);
+  protected:
+    FFT(const FFT&);
+    FFT& operator=(const FFT&);
+
+    /**
+     * @brief A complex transform of size() / 2 on interleaved data, in place,
+     * with the given twiddles.
+     */
+    void transform(float* data, const float* twiddles, bool inverse);
+
+    size_t size_;
+    size_t half_;
+    /* Everything below points in |arena_|. */
+    char* arena_;
+    /* exp(-2 pi i k / half_), then its conjugate, for k < half_ / 2. */
+    float* twiddles_;
+    float* inverse_twiddles_;
+    /* exp(-2 pi i k / size_), for k < half_, for the split step. */
+    float* split_;
+    /* A work buffer of half_ complex values. */
+    float* work_;
+    uint32_t* reverse_;
+};
+
+#endif
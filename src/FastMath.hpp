@@ -0,0 +1,123 @@
+#ifndef FASTMATH_HPP
+#define FASTMATH_HPP
+
+#ifdef __SSE2__
+  #include <emmintrin.h>
+#endif
+
+/**
+ * Approximations of the libm functions used by the waveshapers, as plain
+ * polynomials and fractions, so that they are cheap and vectorise. Each one
+ * has a scalar and an SSE version, that give the same results.
+ */
+
+/**
+ * @brief Past this, fast_tanh() is 1. This is where the fraction crosses 1.
+ */
+#define FAST_TANH_CLAMP 4.9719f
+
+/**
+ * @brief tanh, from the continued fraction of Lambert cut after seven
+ * terms.
+ *
+ * The maximum absolute error is 1e-4, near the clamp. Below |x| = 3 it is
+ * under 1.1e-6. The result is never above 1 in magnitude, and is odd and
+ * monotonic, like tanh.
+ */
+static inline float fast_tanh(float x)
+{
+  if (x > FAST_TANH_CLAMP) {
+    return 1;
+  }
+  if (x < -FAST_TANH_CLAMP) {
+    return -1;
+  }
+  float x2 = x * x;
+  float p = x * (135135.0f + x2 * (17325.0f + x2 * (378.0f + x2)));
+  float q = 135135.0f + x2 * (62370.0f + x2 * (3150.0f + x2 * 28.0f));
+  float r = p / q;
+  // At the clamp, the fraction is slightly above 1.
+  return r > 1 ? 1 : (r < -1 ? -1 : r);
+}
+
+/**
+ * @brief atan, from a minimax polynomial on [-1, 1] (Abramowitz and Stegun
+ * 4.4.49), and atan(x) = pi/2 - atan(1/x) above.
+ *
+ * The maximum absolute error is 1.2e-5 radians.
+ */
+static inline float fast_atan(float x)
+{
+  float a = x < 0 ? -x : x;
+  bool inverted = a > 1;
+  if (inverted) {
+    a = 1 / a;
+  }
+  float a2 = a * a;
+  float r = a * (0.9998660f + a2 * (-0.3302995f + a2 * (0.1801410f +
+                 a2 * (-0.0851330f + a2 * 0.0208351f))));
+  if (inverted) {
+    r = 1.57079632f - r;
+  }
+  return x < 0 ? -r : r;
+}
+
+#ifdef __SSE2__
+/**
+ * @brief fast_tanh() on four samples.
+ */
+static inline __m128 fast_tanh_ps(__m128 x)
+{
+  __m128 sign = _mm_and_ps(x, _mm_castsi128_ps(_mm_set1_epi32(0x80000000)));
+  __m128 clamp = _mm_set1_ps(FAST_TANH_CLAMP);
+  __m128 past = _mm_cmpgt_ps(_mm_xor_ps(x, sign), clamp);
+  x = _mm_min_ps(_mm_max_ps(x, _mm_sub_ps(_mm_setzero_ps(), clamp)), clamp);
+  __m128 x2 = _mm_mul_ps(x, x);
+  __m128 p = _mm_add_ps(_mm_set1_ps(378.0f), x2);
+  p = _mm_add_ps(_mm_set1_ps(17325.0f), _mm_mul_ps(x2, p));
+  p = _mm_add_ps(_mm_set1_ps(135135.0f), _mm_mul_ps(x2, p));
+  p = _mm_mul_ps(x, p);
+  __m128 q = _mm_add_ps(_mm_set1_ps(3150.0f), _mm_mul_ps(x2, _mm_set1_ps(28.0f)));
+  q = _mm_add_ps(_mm_set1_ps(62370.0f), _mm_mul_ps(x2, q));
+  q = _mm_add_ps(_mm_set1_ps(135135.0f), _mm_mul_ps(x2, q));
+  __m128 one = _mm_set1_ps(1.0f);
+  __m128 r = _mm_min_ps(_mm_max_ps(_mm_div_ps(p, q), _mm_sub_ps(_mm_setzero_ps(), one)), one);
+  // Past the clamp, exactly 1 with the sign of x, like fast_tanh().
+  return _mm_or_ps(_mm_andnot_ps(past, r), _mm_and_ps(past, _mm_or_ps(one, sign)));
+}
+
+/**
+ * @brief fast_atan() on four samples.
+ */
+static inline __m128 fast_atan_ps(__m128 x)
+{
+  __m128 sign = _mm_and_ps(x, _mm_castsi128_ps(_mm_set1_epi32(0x80000000)));
+  __m128 a = _mm_xor_ps(x, sign);
+  __m128 one = _mm_set1_ps(1.0f);
+  __m128 inverted = _mm_cmpgt_ps(a, one);
+  // min(a, 1/a), without dividing by zero.
+  a = _mm_or_ps(_mm_andnot_ps(inverted, a),
+                _mm_and_ps(inverted, _mm_div_ps(one, _mm_max_ps(a, one))));
+  __m128 a2 = _mm_mul_ps(a, a);
+  __m128 r = _mm_add_ps(_mm_set1_ps(-0.0851330f), _mm_mul_ps(a2, _mm_set1_ps(0.0208351f)));
+  r = _mm_add_ps(_mm_set1_ps(0.1801410f), _mm_mul_ps(a2, r));
+  r = _mm_add_ps(_mm_set1_ps(-0.3302995f), _mm_mul_ps(a2, r));
+  r = _mm_add_ps(_mm_set1_ps(0.9998660f), _mm_mul_ps(a2, r));
+  r = _mm_mul_ps(a, r);
+  r = _mm_or_ps(_mm_andnot_ps(inverted, r),
+                _mm_and_ps(inverted, _mm_sub_ps(_mm_set1_ps(1.57079632f), r)));
+  return _mm_xor_ps(r, sign);
+}
+
+/**
+ * @brief Round four samples towards minus infinity.
+ */
+static inline __m128 floor_ps(__m128 x)
+{
+  // Truncation rounds negative values up, take one off these.
+  __m128 t = _mm_cvtepi32_ps(_mm_cvttps_epi32(x));
+  return _mm_sub_ps(t, _mm_and_ps(_mm_cmpgt_ps(t, x), _mm_set1_ps(1.0f)));
+}
+#endif
+
+#endif
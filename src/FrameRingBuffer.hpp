@@ -0,0 +1,318 @@
+#ifndef FRAMERINGBUFFER_HPP
+#define FRAMERINGBUFFER_HPP
+
+#include "vagg/vagg_macros.h"
+#include "types.hpp"
+#include "MirroredMemory.hpp"
+
+#include <atomic>
+#include <string.h>
+
+/**
+ * @brief Where the storage of a FrameRingBuffer comes from.
+ */
+enum RingStorage {
+  /**
+   * @brief A plain allocation : reads and writes are split in two when they
+   * wrap around.
+   */
+  HeapStorage,
+  /**
+   * @brief The same pages mapped twice in a row (see MirroredMemory) : any
+   * read or write is contiguous. Falls back to HeapStorage if the system
+   * cannot do it.
+   */
+  MirroredStorage
+};
+
+/**
+ * @brief A ring buffer of interleaved frames, that accepts reads and writes
+ * of any length.
+ *
+ * Unlike RingBuffer, which moves whole slots of a fixed size, this moves
+ * frames one by one : a write or a read of any number of frames is accepted,
+ * and split in two when it wraps around the end of the storage, unless the
+ * storage is mirrored. The size is chosen at runtime, and rounded up to a
+ * power of two number of frames.
+ *
+ * This is a single-producer/single-consumer queue, with the same threading
+ * rules as RingBuffer. The indices are frame counters that only grow, so
+ * that the whole capacity is usable.
+ */
+template<typename T>
+class FrameRingBuffer {
+  public:
+    FrameRingBuffer(size_t frames, size_t channels, RingStorage storage = HeapStorage)
+      :read_index_(0),cached_write_index_(0)
+      ,write_index_(0),cached_read_index_(0)
+      ,capacity_(round_up_power_of_two(frames, storage)),channels_(channels)
+      ,mirrored_(false)
+    {
+      size_t bytes = capacity_ * channels_ * sizeof(T);
+      if (storage == MirroredStorage && mirror_.allocate(bytes) == 0) {
+        if (mirror_.size() == bytes) {
+          data_ = static_cast<T*>(mirror_.data());
+          mirrored_ = true;
+        } else {
+          VAGG_LOG(VAGG_LOG_WARNING, "Mirrored size mismatch : %zu instead of %zu", mirror_.size(), bytes);
+        }
+      }
+      if (! mirrored_) {
+        data_ = new T[capacity_ * channels_];
+      }
+      memset(data_, 0, bytes);
+    }
+
+    ~FrameRingBuffer()
+    {
+      if (! mirrored_) {
+        delete [] data_;
+      }
+    }
+
+    /**
+     * @brief Copy up to |frames| frames in the buffer. Producer side only.
+     *
+     * @return The number of frames actually written.
+     */
+    size_t write(const T* data, size_t frames)
+    {
+      size_t written = 0;
+      while (written != frames) {
+        size_t contiguous;
+        T* span = reserve_write(&contiguous);
+        if (! contiguous) {
+          break;
+        }
+        if (contiguous > frames - written) {
+          contiguous = frames - written;
+        }
+        memcpy(span, data + written * channels_, contiguous * channels_ * sizeof(T));
+        commit_write(contiguous);
+        written += contiguous;
+      }
+      return written;
+    }
+
+    /**
+     * @brief Copy up to |frames| frames out of the buffer. Consumer side only.
+     *
+     * @return The number of frames actually read.
+     */
+    size_t read(T* data, size_t frames)
+    {
+      size_t read = 0;
+      while (read != frames) {
+        size_t contiguous;
+        T* span = peek_read(&contiguous);
+        if (! contiguous) {
+          break;
+        }
+        if (contiguous > frames - read) {
+          contiguous = frames - read;
+        }
+        memcpy(data + read * channels_, span, contiguous * channels_ * sizeof(T));
+        release_read(contiguous);
+        read += contiguous;
+      }
+      return read;
+    }
+
+    /**
+     * @brief Get the free space that directly follows the write position, to
+     * fill it in place. Producer side only.
+     *
+     * @param frames Set to the number of frames that can be written at the
+     * returned address, which can be less than available_write() when the
+     * free space wraps around, unless the storage is mirrored.
+     */
+    T* reserve_write(size_t* frames)
+    {
+      size_t write = write_index_.load(std::memory_order_relaxed);
+      if (write - cached_read_index_ == capacity_) {
+        cached_read_index_ = read_index_.load(std::memory_order_acquire);
+      }
+      size_t offset = write & (capacity_ - 1);
+      size_t available = capacity_ - (write - cached_read_index_);
+      *frames = clip(available, offset);
+      return data_ + offset * channels_;
+    }
+
+    /**
+     * @brief Publish |frames| frames written after a reserve_write().
+     */
+    void commit_write(size_t frames)
+    {
+      write_index_.store(write_index_.load(std::memory_order_relaxed) + frames,
+                         std::memory_order_release);
+    }
+
+    /**
+     * @brief Get the data that directly follows the read position, to read it
+     * in place. Consumer side only.
+     *
+     * @param frames Set to the number of frames that can be read at the
+     * returned address, which can be less than available_read() when the data
+     * wraps around, unless the storage is mirrored.
+     */
+    T* peek_read(size_t* frames)
+    {
+      size_t read = read_index_.load(std::memory_order_relaxed);
+      if (read == cached_write_index_) {
+        cached_write_index_ = write_index_.load(std::memory_order_acquire);
+      }
+      size_t offset = read & (capacity_ - 1);
+      size_t available = cached_write_index_ - read;
+      *frames = clip(available, offset);
+      return data_ + offset * channels_;
+    }
+
+    /**
+     * @brief Give |frames| frames read after a peek_read() back to the
+     * producer.
+     */
+    void release_read(size_t frames)
+    {
+      read_index_.store(read_index_.load(std::memory_order_relaxed) + frames,
+                        std::memory_order_release);
+    }
+
+    /**
+     * @brief Drop all the frames that can be read. Consumer side only.
+     */
+    void clear()
+    {
+      cached_write_index_ = write_index_.load(std::memory_order_acquire);
+      read_index_.store(cached_write_index_, std::memory_order_release);
+    }
+
+    /**
+     * @brief The position of the next frame to be written, counted since the
+     * creation of the buffer. Producer side only.
+     */
+    size_t write_position() const
+    {
+      return write_index_.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Drop the frames that can be read, up to a position returned by
+     * write_position(). Consumer side only.
+     *
+     * This lets the producer mark where some data stops being relevant, and
+     * the consumer skip exactly up to there. Positions already read, or not
+     * written yet, are ignored.
+     */
+    void skip_to(size_t position)
+    {
+      size_t read = read_index_.load(std::memory_order_relaxed);
+      // peek_read() counts the frames it can read from the cached write
+      // index : it must not be behind the new read position.
+      cached_write_index_ = write_index_.load(std::memory_order_acquire);
+      if (position - read > cached_write_index_ - read) {
+        return;
+      }
+      read_index_.store(position, std::memory_order_release);
+    }
+
+    /**
+     * @brief The number of frames that can be read.
+     */
+    size_t available_read() const
+    {
+      return write_index_.load(std::memory_order_acquire) -
+             read_index_.load(std::memory_order_acquire);
+    }
+
+    /**
+     * @brief The number of frames that can be written.
+     */
+    size_t available_write() const
+    {
+      return capacity_ - available_read();
+    }
+
+    bool empty() const
+    {
+      return available_read() == 0;
+    }
+
+    bool full() const
+    {
+      return available_read() == capacity_;
+    }
+
+    /**
+     * @brief The size of the buffer, in frames.
+     */
+    size_t capacity() const
+    {
+      return capacity_;
+    }
+
+    size_t channels() const
+    {
+      return channels_;
+    }
+
+    /**
+     * @brief Whether reads and writes are always contiguous.
+     */
+    bool mirrored() const
+    {
+      return mirrored_;
+    }
+
+  protected:
+    FrameRingBuffer(const FrameRingBuffer&);
+    FrameRingBuffer& operator=(const FrameRingBuffer&);
+
+    /**
+     * @brief Round up to a power of two. A mirrored storage also needs a
+     * whole number of pages, which any power of two number of frames above
+     * a page worth of items is.
+     */
+    static size_t round_up_power_of_two(size_t value, RingStorage storage)
+    {
+      size_t power = 1;
+      if (storage == MirroredStorage) {
+        power = MirroredMemory::page_size() / sizeof(T);
+      }
+      while (power < value) {
+        power <<= 1;
+      }
+      return power;
+    }
+
+    /**
+     * @brief The part of |available| frames from |offset| that can be
+     * accessed without wrapping around.
+     */
+    size_t clip(size_t available, size_t offset) const
+    {
+      if (mirrored_ || available < capacity_ - offset) {
+        return available;
+      }
+      return capacity_ - offset;
+    }
+
+    char pad_front_[CACHE_LINE_SIZE];
+
+    /* Consumer side. */
+    std::atomic<size_t> read_index_;
+    size_t cached_write_index_;
+    char pad_consumer_[CACHE_LINE_SIZE];
+
+    /* Producer side. */
+    std::atomic<size_t> write_index_;
+    size_t cached_read_index_;
+    char pad_producer_[CACHE_LINE_SIZE];
+
+    const size_t capacity_;
+    const size_t channels_;
+    T* data_;
+    MirroredMemory mirror_;
+    bool mirrored_;
+};
+
+#endif
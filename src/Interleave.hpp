@@ -0,0 +1,68 @@
+#ifndef INTERLEAVE_HPP
+#define INTERLEAVE_HPP
+
+#include "types.hpp"
+
+#ifdef __SSE__
+  #include <xmmintrin.h>
+#endif
+
+/**
+ * @brief Split |frames| interleaved frames into one contiguous buffer per
+ * channel.
+ *
+ * @param out |channels| pointers to |frames| samples each.
+ */
+static inline void deinterleave(const SamplesType* in, SamplesType** out,
+                                size_t frames, size_t channels)
+{
+  size_t i = 0;
+#ifdef __SSE__
+  if (channels == 2) {
+    SamplesType* left = out[0];
+    SamplesType* right = out[1];
+    for (; i + 4 <= frames; i += 4) {
+      __m128 a = _mm_loadu_ps(in + 2 * i);
+      __m128 b = _mm_loadu_ps(in + 2 * i + 4);
+      _mm_storeu_ps(left + i, _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+      _mm_storeu_ps(right + i, _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+    }
+  }
+#endif
+  for (; i < frames; i++) {
+    for (size_t c = 0; c < channels; c++) {
+      out[c][i] = in[i * channels + c];
+    }
+  }
+}
+
+/**
+ * @brief Merge one contiguous buffer per channel into |frames| interleaved
+ * frames.
+ *
+ * @param in |channels| pointers to |frames| samples each.
+ */
+static inline void interleave(SamplesType* const* in, SamplesType* out,
+                              size_t frames, size_t channels)
+{
+  size_t i = 0;
+#ifdef __SSE__
+  if (channels == 2) {
+    const SamplesType* left = in[0];
+    const SamplesType* right = in[1];
+    for (; i + 4 <= frames; i += 4) {
+      __m128 l = _mm_loadu_ps(left + i);
+      __m128 r = _mm_loadu_ps(right + i);
+      _mm_storeu_ps(out + 2 * i, _mm_unpacklo_ps(l, r));
+      _mm_storeu_ps(out + 2 * i + 4, _mm_unpackhi_ps(l, r));
+    }
+  }
+#endif
+  for (; i < frames; i++) {
+    for (size_t c = 0; c < channels; c++) {
+      out[i * channels + c] = in[c][i];
+    }
+  }
+}
+
+#endif
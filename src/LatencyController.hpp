@@ -0,0 +1,157 @@
+#ifndef LATENCYCONTROLLER_HPP
+#define LATENCYCONTROLLER_HPP
+
+#include "types.hpp"
+
+#include <atomic>
+#include <math.h>
+
+/**
+ * @brief Pick the number of chunks to keep buffered ahead of the audio
+ * callback.
+ *
+ * The depth is the number of chunks the decoder fills the ring buffer up to,
+ * the low-water mark is the number of chunks under which the callback asks
+ * for more. When adaptive, the depth grows by one chunk on each underrun, or
+ * when the callbacks arrive so irregularly that the margin between the
+ * low-water mark and the depth would not cover the delay. It shrinks back by
+ * one chunk after a while without any of this.
+ *
+ * update() is called by the audio callback, the getters can be called from
+ * any thread.
+ */
+class LatencyController
+{
+  public:
+    /**
+     * @brief The time without underrun nor jitter after which the depth is
+     * decreased, in seconds.
+     */
+    static const int STABLE_TIME = 10;
+    /**
+     * @brief The smallest depth the adaptive mode goes down to.
+     */
+    static const size_t MIN_DEPTH = 2;
+
+    /**
+     * @brief Four chunks, more asked under three, as if reset(4, 3, 4, false).
+     */
+    LatencyController()
+      :depth_(4),low_water_(3),underruns_(0),margin_(1),max_depth_(4),adaptive_(false)
+      ,last_time_(0),stable_time_(0)
+    { }
+
+    /**
+     * @brief Start over with the given settings. Not to be called while the
+     * audio callback runs.
+     *
+     * @param depth The number of chunks to buffer.
+     * @param low_water The number of chunks under which more data is asked.
+     * @param max_depth The depth the adaptive mode can grow up to.
+     * @param adaptive Whether to adapt the depth to the underruns and jitter.
+     */
+    void reset(size_t depth, size_t low_water, size_t max_depth, bool adaptive)
+    {
+      if (depth < 1) {
+        depth = 1;
+      }
+      if (low_water >= depth) {
+        low_water = depth - 1;
+      }
+      if (max_depth < depth) {
+        max_depth = depth;
+      }
+      margin_ = depth - low_water;
+      max_depth_ = max_depth;
+      adaptive_ = adaptive;
+      last_time_ = 0;
+      stable_time_ = 0;
+      underruns_.store(0, std::memory_order_relaxed);
+      low_water_.store(low_water, std::memory_order_relaxed);
+      depth_.store(depth, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Account for a callback. Audio thread only.
+     *
+     * @param time The stream time at which this callback is called, in
+     * seconds, or 0 if the host does not provide it.
+     * @param frames The number of frames asked by this callback.
+     * @param samplerate The samplerate of the stream.
+     * @param underrun Whether there was not enough data for this callback.
+     */
+    void update(double time, unsigned long frames, int samplerate, bool underrun)
+    {
+      double period = static_cast<double>(frames) / samplerate;
+      double jitter = 0;
+      if (time != 0 && last_time_ != 0) {
+        jitter = fabs(time - last_time_ - period);
+      }
+      last_time_ = time;
+
+      if (underrun) {
+        underruns_.fetch_add(1, std::memory_order_relaxed);
+      }
+      if (! adaptive_) {
+        return;
+      }
+
+      size_t depth = depth_.load(std::memory_order_relaxed);
+      if (underrun || jitter > (depth - low_water()) * period) {
+        stable_time_ = 0;
+        if (depth < max_depth_) {
+          set_depth(depth + 1);
+        }
+      } else {
+        stable_time_ += period;
+        if (stable_time_ > STABLE_TIME) {
+          stable_time_ = 0;
+          if (depth > MIN_DEPTH) {
+            set_depth(depth - 1);
+          }
+        }
+      }
+    }
+
+    /**
+     * @brief The number of chunks to buffer.
+     */
+    size_t depth() const
+    {
+      return depth_.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief The number of chunks under which the decoder should be woken up.
+     */
+    size_t low_water() const
+    {
+      return low_water_.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief The number of underruns since the last reset().
+     */
+    size_t underruns() const
+    {
+      return underruns_.load(std::memory_order_relaxed);
+    }
+
+  protected:
+    void set_depth(size_t depth)
+    {
+      low_water_.store(depth > margin_ ? depth - margin_ : 1, std::memory_order_relaxed);
+      depth_.store(depth, std::memory_order_relaxed);
+    }
+
+    std::atomic<size_t> depth_;
+    std::atomic<size_t> low_water_;
+    std::atomic<size_t> underruns_;
+    size_t margin_;
+    size_t max_depth_;
+    bool adaptive_;
+    double last_time_;
+    double stable_time_;
+};
+
+#endif
@@ -0,0 +1,166 @@
+#include "Limiter.hpp"
+
+#include <math.h>
+#include <string.h>
+
+/**
+ * @brief The coefficient of a one pole smoother that goes 63% of the way in
+ * |ms| milliseconds.
+ */
+static float time_constant(float ms, int samplerate)
+{
+  return ms > 0 ? 1 - exp(-1000.0 / (ms * samplerate)) : 1;
+}
+
+Limiter::Limiter(int samplerate, size_t channels, float lookahead, float release)
+  :channels_(channels),release_(time_constant(release, samplerate)),threshold_(1)
+  ,queue_head_(0),queue_tail_(0),sum_(0),gain_(1),frame_(0)
+{
+  window_ = lookahead * samplerate / 1000;
+  if (window_ < 1) {
+    window_ = 1;
+  }
+  capacity_ = 1;
+  while (capacity_ < window_ + 1) {
+    capacity_ <<= 1;
+  }
+  delay_ = new SamplesType[capacity_ * channels_];
+  queue_gains_ = new float[capacity_];
+  queue_frames_ = new size_t[capacity_];
+  gains_ = new float[capacity_];
+  reset();
+}
+
+Limiter::~Limiter()
+{
+  delete [] delay_;
+  delete [] queue_gains_;
+  delete [] queue_frames_;
+  delete [] gains_;
+}
+
+void Limiter::set_threshold(float threshold)
+{
+  threshold_.store(pow(10, threshold / 20), std::memory_order_relaxed);
+}
+
+void Limiter::reset()
+{
+  memset(delay_, 0, capacity_ * channels_ * sizeof(SamplesType));
+  for (size_t i = 0; i < capacity_; i++) {
+    gains_[i] = 1;
+  }
+  sum_ = window_;
+  queue_head_ = 0;
+  queue_tail_ = 0;
+  gain_ = 1;
+}
+
+void Limiter::process(SamplesType* samples, size_t length, size_t channels)
+{
+  if (channels != channels_) {
+    return;
+  }
+  float threshold = threshold_.load(std::memory_order_relaxed);
+  size_t mask = capacity_ - 1;
+
+  for (size_t i = 0; i < length; i++) {
+    float peak = 0;
+    for (size_t c = 0; c < channels; c++) {
+      float value = fabsf(samples[c]);
+      peak = value > peak ? value : peak;
+    }
+    float target = peak > threshold ? threshold / peak : 1;
+
+    // The smallest gain over the window : drop the larger gains from the
+    // back, they can't be the smallest anymore, and the gain that leaves
+    // the window from the front.
+    while (queue_tail_ != queue_head_ && queue_gains_[(queue_tail_ - 1) & mask] >= target) {
+      queue_tail_--;
+    }
+    queue_gains_[queue_tail_ & mask] = target;
+    queue_frames_[queue_tail_ & mask] = frame_;
+    queue_tail_++;
+    if (frame_ - queue_frames_[queue_head_ & mask] > window_) {
+      queue_head_++;
+    }
+    float minimum = queue_gains_[queue_head_ & mask];
+
+    // Go down at once, up at the release rate : this stays under the
+    // minimum, so that the average below does too.
+    if (minimum < gain_) {
+      gain_ = minimum;
+    } else {
+      gain_ += (minimum - gain_) * release_;
+    }
+    size_t slot = frame_ & mask;
+    size_t oldest = (frame_ - window_) & mask;
+    sum_ += gain_ - gains_[oldest];
+    gains_[slot] = gain_;
+    float gain = sum_ / window_;
+
+    // Swap the frame with the one |window_| frames earlier.
+    SamplesType* delayed = delay_ + slot * channels;
+    const SamplesType* out = delay_ + oldest * channels;
+    for (size_t c = 0; c < channels; c++) {
+      delayed[c] = samples[c];
+      samples[c] = out[c] * gain;
+    }
+    samples += channels;
+    frame_++;
+  }
+}
+
+Compressor::Compressor(int samplerate, float attack, float release, float window)
+  :attack_(time_constant(attack, samplerate)),release_(time_constant(release, samplerate))
+  ,window_(time_constant(window, samplerate)),threshold_(-20),ratio_(4),makeup_(1)
+  ,power_(0),gain_(1)
+{ }
+
+void Compressor::set_threshold(float threshold)
+{
+  threshold_.store(threshold, std::memory_order_relaxed);
+}
+
+void Compressor::set_ratio(float ratio)
+{
+  ratio_.store(ratio >= 1 ? ratio : 1, std::memory_order_relaxed);
+}
+
+void Compressor::set_makeup(float makeup)
+{
+  makeup_.store(pow(10, makeup / 20), std::memory_order_relaxed);
+}
+
+void Compressor::reset()
+{
+  power_ = 0;
+  gain_ = 1;
+}
+
+void Compressor::process(SamplesType* samples, size_t length, size_t channels)
+{
+  // The threshold as a power, and the exponent that turns the power above
+  // it in a gain : (power / threshold) ^ ((1 / ratio - 1) / 2).
+  float threshold = pow(10, threshold_.load(std::memory_order_relaxed) / 10);
+  float exponent = (1 / ratio_.load(std::memory_order_relaxed) - 1) / 2;
+  float makeup = makeup_.load(std::memory_order_relaxed);
+  float scale = 1.0f / channels;
+
+  for (size_t i = 0; i < length; i++) {
+    float power = 0;
+    for (size_t c = 0; c < channels; c++) {
+      power += samples[c] * samples[c];
+    }
+    power_ += (power * scale - power_) * window_;
+
+    float target = power_ > threshold ? powf(power_ / threshold, exponent) : 1;
+    gain_ += (target - gain_) * (target < gain_ ? attack_ : release_);
+
+    float gain = gain_ * makeup;
+    for (size_t c = 0; c < channels; c++) {
+      samples[c] *= gain;
+    }
+    samples += channels;
+  }
+}
@@ -0,0 +1,131 @@
+#ifndef LIMITER_HPP
+#define LIMITER_HPP
+
+#include "types.hpp"
+#include "Effect.hpp"
+
+#include <atomic>
+
+/**
+ * @brief A look-ahead peak limiter : the output never goes above the
+ * threshold, without clipping.
+ *
+ * The signal is delayed by the look-ahead time. For each input frame, the
+ * gain that would bring its loudest channel down to the threshold is
+ * computed, and the smallest of these gains over the look-ahead window is
+ * tracked with a monotonic queue, in constant amortized time. That gain
+ * recovers at the release rate, then is averaged over the look-ahead window
+ * with a running sum : the gain ramps down smoothly before a peak, and is
+ * low enough on the peak itself. All the channels get the same gain.
+ */
+class Limiter : public Effect
+{
+  public:
+    /**
+     * @param lookahead The look-ahead time, and the latency, in
+     * milliseconds.
+     * @param release The time the gain takes to recover by 63%, in
+     * milliseconds.
+     */
+    Limiter(int samplerate, size_t channels, float lookahead = 5, float release = 50);
+    ~Limiter();
+    /**
+     * @brief The highest level out, in dBFS. Any thread.
+     */
+    void set_threshold(float threshold);
+    /**
+     * @brief Forget the signal so far : empty the look-ahead, and bring the
+     * gain back to 1. Not to be called while the audio thread processes.
+     */
+    void reset();
+    /**
+     * @brief The delay of the output, in frames.
+     */
+    size_t latency() const
+    {
+      return window_;
+    }
+    /**
+     * @brief Signals with another number of channels than the one given to
+     * the constructor are left untouched.
+     */
+    virtual void process(SamplesType* samples, size_t length, size_t channels);
+  protected:
+    Limiter(const Limiter&);
+    Limiter& operator=(const Limiter&);
+
+    size_t channels_;
+    /* The look-ahead, in frames. */
+    size_t window_;
+    /* The size of the circular buffers, a power of two above |window_|. */
+    size_t capacity_;
+    float release_;
+    std::atomic<float> threshold_;
+
+    /* The delayed input, interleaved. */
+    SamplesType* delay_;
+    /* The monotonic queue of the gains of the window : increasing gains,
+     * and the frames they come from. */
+    float* queue_gains_;
+    size_t* queue_frames_;
+    size_t queue_head_;
+    size_t queue_tail_;
+    /* The last |window_| smoothed gains, and their sum. */
+    float* gains_;
+    double sum_;
+    float gain_;
+    size_t frame_;
+};
+
+/**
+ * @brief A compressor : the level above the threshold is divided by the
+ * ratio, as measured by the RMS over a short window.
+ *
+ * The gain is computed and smoothed, with separate attack and release
+ * times, on every frame. All the channels get the same gain, computed on
+ * their mean power.
+ */
+class Compressor : public Effect
+{
+  public:
+    /**
+     * @param attack The time the gain takes to go 63% of the way down, in
+     * milliseconds.
+     * @param release The time the gain takes to go 63% of the way up, in
+     * milliseconds.
+     * @param window The time constant of the RMS measure, in milliseconds.
+     */
+    Compressor(int samplerate, float attack = 10, float release = 100, float window = 10);
+    /**
+     * @brief The level above which the signal is compressed, in dBFS. Any
+     * thread.
+     */
+    void set_threshold(float threshold);
+    /**
+     * @brief How much the level above the threshold is divided by. Any
+     * thread.
+     */
+    void set_ratio(float ratio);
+    /**
+     * @brief The gain applied after the compression, in dB. Any thread.
+     */
+    void set_makeup(float makeup);
+    /**
+     * @brief Forget the level so far. Not to be called while the audio
+     * thread processes.
+     */
+    void reset();
+    virtual void process(SamplesType* samples, size_t length, size_t channels);
+  protected:
+    float attack_;
+    float release_;
+    float window_;
+    std::atomic<float> threshold_;
+    std::atomic<float> ratio_;
+    std::atomic<float> makeup_;
+    /* Audio thread only. */
+    float power_;
+    float gain_;
+};
+
+#endif
@@ -0,0 +1,272 @@
+#include "LoudnessMeter.hpp"
+
+#include <math.h>
+#include <string.h>
+
+#ifdef __SSE__
+  #include <xmmintrin.h>
+#endif
+
+/**
+ * @brief The polyphase filter to upsample by 4, from ITU-R BS.1770-4, annex
+ * 2, one phase per row.
+ */
+static const float TRUE_PEAK_FILTER[TRUE_PEAK_PHASES][TRUE_PEAK_TAPS] = {
+  { 0.0017089843750f,  0.0109863281250f, -0.0196533203125f,  0.0332031250000f,
+   -0.0594482421875f,  0.1373291015625f,  0.9721679687500f, -0.1022949218750f,
+    0.0476074218750f, -0.0266113281250f,  0.0148925781250f, -0.0083007812500f },
+  {-0.0291748046875f,  0.0292968750000f, -0.0517578125000f,  0.0891113281250f,
+   -0.1665039062500f,  0.4650878906250f,  0.7797851562500f, -0.2003173828125f,
+    0.1015625000000f, -0.0582275390625f,  0.0330810546875f, -0.0189208984375f },
+  {-0.0189208984375f,  0.0330810546875f, -0.0582275390625f,  0.1015625000000f,
+   -0.2003173828125f,  0.7797851562500f,  0.4650878906250f, -0.1665039062500f,
+    0.0891113281250f, -0.0517578125000f,  0.0292968750000f, -0.0291748046875f },
+  {-0.0083007812500f,  0.0148925781250f, -0.0266113281250f,  0.0476074218750f,
+   -0.1022949218750f,  0.9721679687500f,  0.1373291015625f, -0.0594482421875f,
+    0.0332031250000f, -0.0196533203125f,  0.0109863281250f,  0.0017089843750f }
+};
+
+#ifdef __SSE__
+static float max_lane(__m128 value)
+{
+  float lanes[4];
+  _mm_storeu_ps(lanes, value);
+  float max = lanes[0];
+  for (size_t i = 1; i < 4; i++) {
+    max = lanes[i] > max ? lanes[i] : max;
+  }
+  return max;
+}
+#endif
+
+/**
+ * @brief The loudness of a mean weighted energy, in LUFS.
+ */
+static double loudness(double energy)
+{
+  return energy > 0 ? -0.691 + 10 * log10(energy) : -HUGE_VAL;
+}
+
+/**
+ * @brief The weight of channel |c| in the sum : the surround channels of a
+ * 5.0 or 5.1 layout count more, the LFE channel of a 5.1 layout not at all.
+ */
+static double channel_weight(size_t c, size_t channels)
+{
+  if (channels == 6) {
+    if (c == 3) {
+      return 0;
+    }
+    return c > 3 ? 1.41 : 1;
+  }
+  if (channels == 5) {
+    return c > 2 ? 1.41 : 1;
+  }
+  return 1;
+}
+
+LoudnessMeter::LoudnessMeter(int samplerate)
+  :pending_samplerate_(0)
+{
+  for (size_t j = 0; j < TRUE_PEAK_TAPS; j++) {
+    for (size_t p = 0; p < TRUE_PEAK_PHASES; p++) {
+      // The history is in time order, the filter is applied newest first.
+      taps_[j][p] = TRUE_PEAK_FILTER[p][TRUE_PEAK_TAPS - 1 - j];
+    }
+  }
+  setup(samplerate, 0);
+}
+
+void LoudnessMeter::reset(int samplerate)
+{
+  pending_samplerate_.store(samplerate, std::memory_order_release);
+}
+
+bool LoudnessMeter::read(LoudnessValues* values)
+{
+  if (! values_.update()) {
+    return false;
+  }
+  *values = values_.read_buffer();
+  return true;
+}
+
+void LoudnessMeter::setup(int samplerate, size_t channels)
+{
+  samplerate_ = samplerate;
+  channels_ = channels;
+  block_frames_ = samplerate / 10 ? samplerate / 10 : 1;
+  frames_ = 0;
+  for (size_t c = 0; c < LOUDNESS_MAX_CHANNELS; c++) {
+    weights_[c] = channel_weight(c, channels);
+  }
+
+  // The K-weighting filters of BS.1770, for any samplerate.
+  double K = tan(M_PI * 1681.974450955533 / samplerate);
+  double Q = 0.7071752369554196;
+  double Vh = pow(10, 3.999843853973347 / 20);
+  double Vb = pow(Vh, 0.4996667741545416);
+  double a0 = 1 + K / Q + K * K;
+  shelf_b_[0] = (Vh + Vb * K / Q + K * K) / a0;
+  shelf_b_[1] = 2 * (K * K - Vh) / a0;
+  shelf_b_[2] = (Vh - Vb * K / Q + K * K) / a0;
+  shelf_a_[0] = 1;
+  shelf_a_[1] = 2 * (K * K - 1) / a0;
+  shelf_a_[2] = (1 - K / Q + K * K) / a0;
+
+  K = tan(M_PI * 38.13547087602444 / samplerate);
+  Q = 0.5003270373238773;
+  a0 = 1 + K / Q + K * K;
+  pass_b_[0] = 1;
+  pass_b_[1] = -2;
+  pass_b_[2] = 1;
+  pass_a_[0] = 1;
+  pass_a_[1] = 2 * (K * K - 1) / a0;
+  pass_a_[2] = (1 - K / Q + K * K) / a0;
+
+  memset(shelf_state_, 0, sizeof(shelf_state_));
+  memset(pass_state_, 0, sizeof(pass_state_));
+  energy_ = 0;
+  memset(blocks_, 0, sizeof(blocks_));
+  block_index_ = 0;
+  block_count_ = 0;
+  memset(histogram_count_, 0, sizeof(histogram_count_));
+  memset(histogram_energy_, 0, sizeof(histogram_energy_));
+  memset(history_, 0, sizeof(history_));
+  history_index_ = 0;
+  peak_ = 0;
+}
+
+void LoudnessMeter::process(SamplesType* samples, size_t length, size_t channels)
+{
+  int samplerate = pending_samplerate_.exchange(0, std::memory_order_acquire);
+  size_t measured = channels < LOUDNESS_MAX_CHANNELS ? channels : LOUDNESS_MAX_CHANNELS;
+  if (samplerate || measured != channels_) {
+    setup(samplerate ? samplerate : samplerate_, measured);
+  }
+
+#ifdef __SSE__
+  const __m128 sign = _mm_set1_ps(-0.0f);
+  __m128 peak = _mm_set1_ps(peak_);
+#else
+  float peak = peak_;
+#endif
+
+  for (size_t i = 0; i < length; i++) {
+    const SamplesType* frame = samples + i * channels;
+    for (size_t c = 0; c < channels_; c++) {
+      double x = frame[c];
+      double* shelf = shelf_state_[c];
+      double y = shelf_b_[0] * x + shelf[0];
+      shelf[0] = shelf_b_[1] * x - shelf_a_[1] * y + shelf[1];
+      shelf[1] = shelf_b_[2] * x - shelf_a_[2] * y;
+      double* pass = pass_state_[c];
+      double z = pass_b_[0] * y + pass[0];
+      pass[0] = pass_b_[1] * y - pass_a_[1] * z + pass[1];
+      pass[1] = pass_b_[2] * y - pass_a_[2] * z;
+      energy_ += weights_[c] * z * z;
+
+      float* history = history_[c];
+      history[history_index_] = history[history_index_ + TRUE_PEAK_TAPS] = frame[c];
+      const float* window = history + history_index_ + 1;
+#ifdef __SSE__
+      // The four phases are computed side by side, one tap at a time.
+      __m128 phases = _mm_setzero_ps();
+      for (size_t j = 0; j < TRUE_PEAK_TAPS; j++) {
+        phases = _mm_add_ps(phases, _mm_mul_ps(_mm_loadu_ps(taps_[j]), _mm_set1_ps(window[j])));
+      }
+      peak = _mm_max_ps(peak, _mm_andnot_ps(sign, phases));
+      peak = _mm_max_ps(peak, _mm_andnot_ps(sign, _mm_set1_ps(frame[c])));
+#else
+      for (size_t p = 0; p < TRUE_PEAK_PHASES; p++) {
+        float phase = 0;
+        for (size_t j = 0; j < TRUE_PEAK_TAPS; j++) {
+          phase += taps_[j][p] * window[j];
+        }
+        peak = fabsf(phase) > peak ? fabsf(phase) : peak;
+      }
+      peak = fabsf(frame[c]) > peak ? fabsf(frame[c]) : peak;
+#endif
+    }
+    history_index_ = (history_index_ + 1) % TRUE_PEAK_TAPS;
+
+    if (++frames_ == block_frames_) {
+#ifdef __SSE__
+      peak_ = max_lane(peak);
+#else
+      peak_ = peak;
+#endif
+      end_block();
+    }
+  }
+
+#ifdef __SSE__
+  peak_ = max_lane(peak);
+#else
+  peak_ = peak;
+#endif
+}
+
+void LoudnessMeter::end_block()
+{
+  blocks_[block_index_] = energy_ / block_frames_;
+  block_index_ = (block_index_ + 1) % LOUDNESS_SHORT_TERM_BLOCKS;
+  block_count_++;
+  energy_ = 0;
+  frames_ = 0;
+
+  LoudnessValues& values = values_.write_buffer();
+  values.momentary = -HUGE_VAL;
+  values.short_term = -HUGE_VAL;
+
+  double energy = 0;
+  for (size_t i = 1; i <= LOUDNESS_SHORT_TERM_BLOCKS; i++) {
+    size_t index = (block_index_ + LOUDNESS_SHORT_TERM_BLOCKS - i) % LOUDNESS_SHORT_TERM_BLOCKS;
+    energy += blocks_[index];
+    if (i == LOUDNESS_MOMENTARY_BLOCKS && block_count_ >= LOUDNESS_MOMENTARY_BLOCKS) {
+      // The momentary loudness is also the loudness of a gating block, that
+      // overlaps the previous one by 75%.
+      double momentary = energy / LOUDNESS_MOMENTARY_BLOCKS;
+      values.momentary = loudness(momentary);
+      if (values.momentary > LOUDNESS_ABSOLUTE_GATE) {
+        size_t bin = (values.momentary - LOUDNESS_ABSOLUTE_GATE) * 10;
+        if (bin >= LOUDNESS_HISTOGRAM_BINS) {
+          bin = LOUDNESS_HISTOGRAM_BINS - 1;
+        }
+        histogram_count_[bin]++;
+        histogram_energy_[bin] += momentary;
+      }
+    }
+  }
+  if (block_count_ >= LOUDNESS_SHORT_TERM_BLOCKS) {
+    values.short_term = loudness(energy / LOUDNESS_SHORT_TERM_BLOCKS);
+  }
+  values.integrated = integrated();
+  values.true_peak = peak_ > 0 ? 20 * log10(peak_) : -HUGE_VAL;
+  values_.publish();
+}
+
+double LoudnessMeter::integrated() const
+{
+  uint64_t count = 0;
+  double energy = 0;
+  for (size_t i = 0; i < LOUDNESS_HISTOGRAM_BINS; i++) {
+    count += histogram_count_[i];
+    energy += histogram_energy_[i];
+  }
+  if (! count) {
+    return -HUGE_VAL;
+  }
+
+  // Keep the bins from the one the relative threshold falls in.
+  double threshold = loudness(energy / count) + LOUDNESS_RELATIVE_GATE;
+  double position = (threshold - LOUDNESS_ABSOLUTE_GATE) * 10;
+  size_t first = position > 0 ? static_cast<size_t>(position) : 0;
+  count = 0;
+  energy = 0;
+  for (size_t i = first; i < LOUDNESS_HISTOGRAM_BINS; i++) {
+    count += histogram_count_[i];
+    energy += histogram_energy_[i];
+  }
+  return count ? loudness(energy / count) : -HUGE_VAL;
+}
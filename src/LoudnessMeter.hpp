@@ -0,0 +1,142 @@
+#ifndef LOUDNESSMETER_HPP
+#define LOUDNESSMETER_HPP
+
+#include "types.hpp"
+#include "Effect.hpp"
+#include "TripleBuffer.hpp"
+
+#include <atomic>
+#include <stdint.h>
+
+/**
+ * @brief The largest number of channels a LoudnessMeter measures. Further
+ * channels are ignored.
+ */
+#define LOUDNESS_MAX_CHANNELS 8
+/**
+ * @brief The loudness is measured on blocks of 100 ms, the momentary
+ * loudness spans 4 of them, the short-term loudness 30.
+ */
+#define LOUDNESS_MOMENTARY_BLOCKS 4
+#define LOUDNESS_SHORT_TERM_BLOCKS 30
+/**
+ * @brief Below this, in LUFS, a block is silence, and not part of the
+ * integrated loudness.
+ */
+#define LOUDNESS_ABSOLUTE_GATE -70
+/**
+ * @brief Blocks quieter than the loudness of the louder blocks minus this, in
+ * LU, are not part of the integrated loudness.
+ */
+#define LOUDNESS_RELATIVE_GATE -10
+/**
+ * @brief The histogram of the block loudnesses goes from the absolute gate to
+ * +5 LUFS, by 0.1 LU.
+ */
+#define LOUDNESS_HISTOGRAM_BINS 750
+/**
+ * @brief The true peak is measured by upsampling by 4, with 12 taps per
+ * phase.
+ */
+#define TRUE_PEAK_PHASES 4
+#define TRUE_PEAK_TAPS 12
+
+/**
+ * @brief The values a LoudnessMeter publishes. The loudnesses are in LUFS,
+ * the true peak in dBTP, and are -HUGE_VAL when there is nothing to measure
+ * yet.
+ */
+struct LoudnessValues {
+  double momentary;
+  double short_term;
+  double integrated;
+  double true_peak;
+};
+
+/**
+ * @brief Measure the loudness as per EBU R128 / ITU-R BS.1770 : K-weighting,
+ * momentary (400 ms) and short-term (3 s) loudness, gated integrated
+ * loudness, and true peak. The samples are left untouched.
+ *
+ * All the state is allocated with the object, and the work per block is
+ * bounded : two biquads and a 48 taps upsampler per sample, and one pass over
+ * the histogram of the block loudnesses every 100 ms. The integrated
+ * loudness is computed from that histogram rather than from the list of all
+ * the blocks, which would grow with the length of the stream : the relative
+ * gate is placed with a precision of 0.1 LU, the energies are summed
+ * exactly.
+ *
+ * The values are published every 100 ms through a TripleBuffer, to be read
+ * by another thread.
+ */
+class LoudnessMeter : public Effect
+{
+  public:
+    LoudnessMeter(int samplerate);
+    virtual void process(SamplesType* samples, size_t length, size_t channels);
+    /**
+     * @brief Start the measure over, at |samplerate|, from the next block on.
+     * Any thread.
+     */
+    void reset(int samplerate);
+    /**
+     * @brief Get the latest values. Reader thread only.
+     *
+     * @return false if nothing was published since the last call, |values|
+     * is then left untouched.
+     */
+    bool read(LoudnessValues* values);
+  protected:
+    /**
+     * @brief Clear the state, and compute the filters for |samplerate|.
+     */
+    void setup(int samplerate, size_t channels);
+    /**
+     * @brief Account for a finished 100 ms block, and publish.
+     */
+    void end_block();
+    /**
+     * @brief The gated loudness of all the blocks so far.
+     */
+    double integrated() const;
+
+    TripleBuffer<LoudnessValues> values_;
+    /* The samplerate to reset to, or 0. */
+    std::atomic<int> pending_samplerate_;
+
+    /* Audio thread only. */
+    int samplerate_;
+    size_t channels_;
+    size_t block_frames_;
+    size_t frames_;
+    double weights_[LOUDNESS_MAX_CHANNELS];
+
+    /* K-weighting : a high shelf, then a high pass, in transposed direct
+     * form II. */
+    double shelf_b_[3];
+    double shelf_a_[3];
+    double pass_b_[3];
+    double pass_a_[3];
+    double shelf_state_[LOUDNESS_MAX_CHANNELS][2];
+    double pass_state_[LOUDNESS_MAX_CHANNELS][2];
+
+    /* The weighted energy of the current block, and of the last blocks. */
+    double energy_;
+    double blocks_[LOUDNESS_SHORT_TERM_BLOCKS];
+    size_t block_index_;
+    uint64_t block_count_;
+
+    /* The number and the total energy of the gating blocks per loudness. */
+    uint64_t histogram_count_[LOUDNESS_HISTOGRAM_BINS];
+    double histogram_energy_[LOUDNESS_HISTOGRAM_BINS];
+
+    /* The upsampling filter, tap by tap, with the phases side by side. */
+    float taps_[TRUE_PEAK_TAPS][TRUE_PEAK_PHASES];
+    /* The last samples of each channel, twice in a row, so that the last
+     * TRUE_PEAK_TAPS are always contiguous. */
+    float history_[LOUDNESS_MAX_CHANNELS][2 * TRUE_PEAK_TAPS];
+    size_t history_index_;
+    float peak_;
+};
+
+#endif
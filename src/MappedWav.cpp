@@ -0,0 +1,246 @@
+#include "MappedWav.hpp"
+#include "vagg/vagg_macros.h"
+
+#include <string.h>
+
+#ifdef __linux__
+  #include <fcntl.h>
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+  #include <unistd.h>
+#endif
+
+#ifdef __SSE2__
+  #include <emmintrin.h>
+#endif
+
+#define WAVE_FORMAT_PCM 1
+#define WAVE_FORMAT_IEEE_FLOAT 3
+#define WAVE_FORMAT_EXTENSIBLE 0xFFFE
+
+static uint16_t read16(const unsigned char* p)
+{
+  return p[0] | (p[1] << 8);
+}
+
+static uint32_t read32(const unsigned char* p)
+{
+  return p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+static void convert_pcm16(const unsigned char* in, float* out, size_t count)
+{
+  const float scale = 1.0f / 32768;
+  size_t i = 0;
+#ifdef __SSE2__
+  __m128 s = _mm_set1_ps(scale);
+  for (; i + 8 <= count; i += 8) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + 2 * i));
+    // Put each sample in the top half of a 32 bits lane, then shift it back
+    // down with its sign.
+    __m128i low = _mm_srai_epi32(_mm_unpacklo_epi16(_mm_setzero_si128(), v), 16);
+    __m128i high = _mm_srai_epi32(_mm_unpackhi_epi16(_mm_setzero_si128(), v), 16);
+    _mm_storeu_ps(out + i, _mm_mul_ps(_mm_cvtepi32_ps(low), s));
+    _mm_storeu_ps(out + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(high), s));
+  }
+#endif
+  for (; i < count; i++) {
+    out[i] = static_cast<int16_t>(read16(in + 2 * i)) * scale;
+  }
+}
+
+static void convert_pcm24(const unsigned char* in, float* out, size_t count)
+{
+  const float scale = 1.0f / 8388608;
+  size_t i = 0;
+#ifdef __SSE2__
+  __m128 s = _mm_set1_ps(scale);
+  // Each sample is read as the low three bytes of a 32 bits load, which
+  // reads one byte past it : the last group is left to the scalar loop.
+  for (; i + 4 < count; i += 4) {
+    int32_t words[4];
+    for (size_t j = 0; j < 4; j++) {
+      memcpy(&words[j], in + 3 * (i + j), 4);
+    }
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(words));
+    v = _mm_srai_epi32(_mm_slli_epi32(v, 8), 8);
+    _mm_storeu_ps(out + i, _mm_mul_ps(_mm_cvtepi32_ps(v), s));
+  }
+#endif
+  for (; i < count; i++) {
+    const unsigned char* p = in + 3 * i;
+    int32_t v = static_cast<int32_t>((p[0] << 8) | (p[1] << 16) |
+                                     (static_cast<uint32_t>(p[2]) << 24)) >> 8;
+    out[i] = v * scale;
+  }
+}
+
+static void convert_pcm32(const unsigned char* in, float* out, size_t count)
+{
+  const float scale = 1.0f / 2147483648.0f;
+  size_t i = 0;
+#ifdef __SSE2__
+  __m128 s = _mm_set1_ps(scale);
+  for (; i + 4 <= count; i += 4) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + 4 * i));
+    _mm_storeu_ps(out + i, _mm_mul_ps(_mm_cvtepi32_ps(v), s));
+  }
+#endif
+  for (; i < count; i++) {
+    out[i] = static_cast<int32_t>(read32(in + 4 * i)) * scale;
+  }
+}
+
+MappedWav::MappedWav()
+  :mapping_(0),mapping_size_(0),data_(0),encoding_(Pcm16)
+  ,channels_(0),samplerate_(0),frame_bytes_(0),frames_(0),position_(0)
+{ }
+
+MappedWav::~MappedWav()
+{
+  release();
+}
+
+void MappedWav::close()
+{
+  release();
+}
+
+void MappedWav::release()
+{
+#ifdef __linux__
+  if (mapping_) {
+    munmap(mapping_, mapping_size_);
+  }
+#endif
+  mapping_ = 0;
+  mapping_size_ = 0;
+  data_ = 0;
+  frames_ = position_ = 0;
+}
+
+int MappedWav::open(const char* path)
+{
+  release();
+#ifdef __linux__
+  int fd = ::open(path, O_RDONLY);
+  if (fd == -1) {
+    return -1;
+  }
+  struct stat st;
+  if (fstat(fd, &st) == -1 || st.st_size < 12) {
+    ::close(fd);
+    return -1;
+  }
+  size_t size = st.st_size;
+  void* mapping = mmap(0, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  // The mapping keeps the file alive.
+  ::close(fd);
+  if (mapping == MAP_FAILED) {
+    VAGG_LOG(VAGG_LOG_WARNING, "mmap failed : %s", strerror(errno));
+    return -1;
+  }
+  mapping_ = mapping;
+  mapping_size_ = size;
+
+  const unsigned char* file = static_cast<const unsigned char*>(mapping);
+  if (memcmp(file, "RIFF", 4) || memcmp(file + 8, "WAVE", 4)) {
+    release();
+    return -1;
+  }
+
+  // Walk the chunks, that are padded to an even size, for the format and the
+  // data.
+  bool has_format = false;
+  unsigned format = 0;
+  unsigned bits = 0;
+  size_t block_align = 0;
+  size_t offset = 12;
+  while (offset + 8 <= size) {
+    const unsigned char* chunk = file + offset;
+    size_t length = read32(chunk + 4);
+    offset += 8;
+    if (! memcmp(chunk, "fmt ", 4) && length >= 16 && offset + length <= size) {
+      format = read16(chunk + 8);
+      channels_ = read16(chunk + 10);
+      samplerate_ = read32(chunk + 12);
+      block_align = read16(chunk + 20);
+      bits = read16(chunk + 22);
+      // The sub format GUID starts with the format tag.
+      if (format == WAVE_FORMAT_EXTENSIBLE && length >= 40) {
+        format = read16(chunk + 32);
+      }
+      has_format = true;
+    } else if (! memcmp(chunk, "data", 4)) {
+      if (! has_format) {
+        break;
+      }
+      // Files that were not closed properly have a wrong data size : use
+      // what is there.
+      if (length > size - offset) {
+        length = size - offset;
+      }
+      data_ = file + offset;
+      frame_bytes_ = block_align;
+      frames_ = block_align ? length / block_align : 0;
+      break;
+    }
+    offset += length + (length & 1);
+  }
+
+  bool supported = true;
+  if (format == WAVE_FORMAT_PCM && bits == 16) {
+    encoding_ = Pcm16;
+  } else if (format == WAVE_FORMAT_PCM && bits == 24) {
+    encoding_ = Pcm24;
+  } else if (format == WAVE_FORMAT_PCM && bits == 32) {
+    encoding_ = Pcm32;
+  } else if (format == WAVE_FORMAT_IEEE_FLOAT && bits == 32) {
+    encoding_ = Float32;
+  } else {
+    supported = false;
+  }
+  if (! data_ || ! supported || channels_ <= 0 ||
+      frame_bytes_ != channels_ * bits / 8) {
+    release();
+    return -1;
+  }
+
+  madvise(mapping_, mapping_size_, MADV_SEQUENTIAL);
+  return 0;
+#else
+  (void)path;
+  return -1;
+#endif
+}
+
+size_t MappedWav::read(float* out, size_t samples)
+{
+  uint64_t frames = samples / channels_;
+  if (frames > frames_ - position_) {
+    frames = frames_ - position_;
+  }
+  size_t count = frames * channels_;
+  const unsigned char* in = data_ + position_ * frame_bytes_;
+  switch (encoding_) {
+    case Pcm16:
+      convert_pcm16(in, out, count);
+      break;
+    case Pcm24:
+      convert_pcm24(in, out, count);
+      break;
+    case Pcm32:
+      convert_pcm32(in, out, count);
+      break;
+    case Float32:
+      memcpy(out, in, count * sizeof(float));
+      break;
+  }
+  position_ += frames;
+  return count;
+}
+
+void MappedWav::seek(uint64_t frame)
+{
+  position_ = frame < frames_ ? frame : frames_;
+}
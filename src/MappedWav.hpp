@@ -0,0 +1,92 @@
+#ifndef MAPPEDWAV_HPP
+#define MAPPEDWAV_HPP
+
+#include "types.hpp"
+
+#include <stdint.h>
+
+/**
+ * @brief Read the samples of a plain WAV file straight from a memory mapping
+ * of it, without going through libsndfile.
+ *
+ * open() parses the RIFF header, and only accepts 16, 24 and 32 bits integer
+ * PCM and 32 bits float, in a WAV or WAVE_FORMAT_EXTENSIBLE file : anything
+ * else fails, and the caller is expected to fall back to libsndfile. The
+ * data chunk is mapped read-only, marked as read sequentially, and read()
+ * converts from there to floats in the caller's buffer, with SSE2 for the
+ * integer formats. Seeking moves a frame index. Once the pages are in,
+ * reading does not make any system call.
+ *
+ * The samples are scaled like libsndfile does : divided by 2^(bits - 1).
+ */
+class MappedWav
+{
+  public:
+    enum Encoding {
+      Pcm16,
+      Pcm24,
+      Pcm32,
+      Float32
+    };
+
+    MappedWav();
+    ~MappedWav();
+    /**
+     * @return 0 if |path| is a WAV file that can be mapped, -1 otherwise.
+     */
+    int open(const char* path);
+    /**
+     * @brief Unmap the file.
+     */
+    void close();
+    /**
+     * @brief Convert up to |samples| samples, rounded down to whole frames,
+     * to |out|, from the current position.
+     *
+     * @return The number of samples written.
+     */
+    size_t read(float* out, size_t samples);
+    /**
+     * @brief Move to |frame|, clamped to the end of the file.
+     */
+    void seek(uint64_t frame);
+    bool is_open() const
+    {
+      return data_ != 0;
+    }
+    int channels() const
+    {
+      return channels_;
+    }
+    int samplerate() const
+    {
+      return samplerate_;
+    }
+    uint64_t frames() const
+    {
+      return frames_;
+    }
+    Encoding encoding() const
+    {
+      return encoding_;
+    }
+  protected:
+    MappedWav(const MappedWav&);
+    MappedWav& operator=(const MappedWav&);
+
+    void release();
+
+    /* The whole file, mapped. */
+    void* mapping_;
+    size_t mapping_size_;
+    /* The first sample, in the mapping. */
+    const unsigned char* data_;
+    Encoding encoding_;
+    int channels_;
+    int samplerate_;
+    size_t frame_bytes_;
+    uint64_t frames_;
+    uint64_t position_;
+};
+
+#endif
@@ -0,0 +1,110 @@
+#include "MetadataCache.hpp"
+#include "SampleCache.hpp"
+#include "vagg/vagg_macros.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+/* The first word of a sidecar, followed by the version of the format. */
+#define METADATA_SIDECAR_MAGIC "vaggmeta"
+#define METADATA_SIDECAR_VERSION 1
+
+std::atomic<bool> MetadataCache::enabled_(false);
+
+void MetadataCache::set_enabled(bool enabled)
+{
+  enabled_.store(enabled);
+}
+
+bool MetadataCache::enabled()
+{
+  return enabled_.load();
+}
+
+std::string MetadataCache::sidecar_path(const char* path)
+{
+  return std::string(path) + METADATA_SIDECAR_SUFFIX;
+}
+
+int MetadataCache::load(const char* path, AudioMetadata* metadata)
+{
+  if (! enabled()) {
+    return -1;
+  }
+  int64_t mtime_ns;
+  int64_t file_size;
+  if (! SampleCache::stat_file(path, &mtime_ns, &file_size)) {
+    return -1;
+  }
+  FILE* sidecar = fopen(sidecar_path(path).c_str(), "r");
+  if (! sidecar) {
+    return -1;
+  }
+  int version;
+  int64_t sidecar_mtime_ns;
+  int64_t sidecar_file_size;
+  AudioMetadata read;
+  int fields = fscanf(sidecar, METADATA_SIDECAR_MAGIC " %d %" SCNd64 " %" SCNd64
+                      " %d %d %d %" SCNu64 " %f",
+                      &version, &sidecar_mtime_ns, &sidecar_file_size,
+                      &read.channels, &read.samplerate, &read.format,
+                      &read.frames, &read.peak);
+  fclose(sidecar);
+  if (fields != 8 || version != METADATA_SIDECAR_VERSION) {
+    VAGG_LOG(VAGG_LOG_DEBUG, "Ignoring the malformed sidecar of %s", path);
+    return -1;
+  }
+  if (sidecar_mtime_ns != mtime_ns || sidecar_file_size != file_size ||
+      read.channels <= 0 || read.samplerate <= 0) {
+    return -1;
+  }
+  *metadata = read;
+  return 0;
+}
+
+int MetadataCache::store(const char* path, const AudioMetadata& metadata)
+{
+  if (! enabled()) {
+    return -1;
+  }
+  int64_t mtime_ns;
+  int64_t file_size;
+  if (! SampleCache::stat_file(path, &mtime_ns, &file_size)) {
+    return -1;
+  }
+  std::string sidecar = sidecar_path(path);
+  // A temporary file of its own, so that two threads or processes writing
+  // the same sidecar never write to the same file.
+  std::vector<char> temporary(sidecar.begin(), sidecar.end());
+  const char pattern[] = ".XXXXXX";
+  temporary.insert(temporary.end(), pattern, pattern + sizeof(pattern));
+  int fd = mkstemp(&temporary[0]);
+  if (fd == -1) {
+    VAGG_LOG(VAGG_LOG_DEBUG, "Cannot write the sidecar of %s", path);
+    return -1;
+  }
+  // mkstemp() makes it readable by its owner only : like the files next to
+  // it, a sidecar is readable by all.
+  fchmod(fd, 0644);
+  FILE* out = fdopen(fd, "w");
+  if (! out) {
+    close(fd);
+    unlink(&temporary[0]);
+    return -1;
+  }
+  int written = fprintf(out, METADATA_SIDECAR_MAGIC " %d %" PRId64 " %" PRId64
+                        " %d %d %d %" PRIu64 " %.9g\n",
+                        METADATA_SIDECAR_VERSION, mtime_ns, file_size,
+                        metadata.channels, metadata.samplerate, metadata.format,
+                        metadata.frames, metadata.peak);
+  if (fclose(out) != 0 || written < 0 ||
+      rename(&temporary[0], sidecar.c_str()) != 0) {
+    unlink(&temporary[0]);
+    return -1;
+  }
+  return 0;
+}
@@ -0,0 +1,69 @@
+#ifndef METADATACACHE_HPP
+#define METADATACACHE_HPP
+
+#include <stdint.h>
+#include <atomic>
+#include <string>
+
+/**
+ * @brief The suffix added to the path of a file to get the path of its
+ * sidecar.
+ */
+#define METADATA_SIDECAR_SUFFIX ".vaggmeta"
+
+/**
+ * @brief What is known about a file without reading its samples.
+ */
+struct AudioMetadata {
+  int channels;
+  int samplerate;
+  /* The libsndfile format of the file. */
+  int format;
+  uint64_t frames;
+  /* The largest absolute sample value, or a negative value if the file has
+   * never been decoded whole. */
+  float peak;
+};
+
+/**
+ * @brief Keep the metadata of the audio files in small sidecar files, next to
+ * them, so that listing a library does not have to open the audio files.
+ *
+ * A sidecar records the size and modification time of its file, and is
+ * ignored when they do not match anymore. Sidecars are only read and written
+ * once enabled : they are written next to the user's files, which may not be
+ * wanted, or possible on a read-only library. Writing is atomic, a sidecar is
+ * written to a temporary file made by mkstemp(), then renamed.
+ *
+ * Any thread, but it does file I/O, do not use it from the audio thread.
+ */
+class MetadataCache
+{
+  public:
+    /**
+     * @brief Read and write sidecars, or not. Disabled by default.
+     */
+    static void set_enabled(bool enabled);
+    static bool enabled();
+    /**
+     * @brief The path of the sidecar of |path|.
+     */
+    static std::string sidecar_path(const char* path);
+    /**
+     * @brief Read the sidecar of |path|.
+     *
+     * @return 0 if it is there and matches the file, -1 otherwise, or if the
+     * sidecars are disabled.
+     */
+    static int load(const char* path, AudioMetadata* metadata);
+    /**
+     * @brief Write the sidecar of |path|.
+     *
+     * @return 0 if written, -1 otherwise, or if the sidecars are disabled.
+     */
+    static int store(const char* path, const AudioMetadata& metadata);
+  protected:
+    static std::atomic<bool> enabled_;
+};
+
+#endif
@@ -0,0 +1,278 @@
+#include "Meter.hpp"
+
+#include <math.h>
+
+#ifdef __SSE2__
+  #include <emmintrin.h>
+#endif
+
+#if defined(__x86_64__) && defined(__GNUC__) && \
+    (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 8))
+  #define METER_AVX2
+  #include <immintrin.h>
+#endif
+
+/* The vector paths go through the interleaved samples 8 at a time : when
+ * the number of channels divides 8, lane l always holds channel
+ * l % channels. */
+#define METER_LANES 8
+
+/**
+ * @brief Fold the per-lane results into per-channel results, and go on with
+ * the samples that do not fill a vector.
+ */
+static void finish(const SamplesType* samples, size_t start, size_t count, size_t channels,
+                   const float* lane_squares, const float* lane_peak,
+                   float* sum_squares, float* peak)
+{
+  for (size_t c = 0; c < channels; c++) {
+    sum_squares[c] = 0;
+    peak[c] = 0;
+  }
+  for (size_t l = 0; l < METER_LANES; l++) {
+    size_t c = l % channels;
+    sum_squares[c] += lane_squares[l];
+    if (lane_peak[l] > peak[c]) {
+      peak[c] = lane_peak[l];
+    }
+  }
+  for (size_t i = start; i < count; i++) {
+    size_t c = i % channels;
+    float value = fabsf(samples[i]);
+    sum_squares[c] += value * value;
+    if (value > peak[c]) {
+      peak[c] = value;
+    }
+  }
+}
+
+/**
+ * @brief Measure the first |channels| channels of frames of |stride| samples.
+ */
+static void measure_scalar(const SamplesType* samples, size_t frames, size_t stride,
+                           size_t channels, float* sum_squares, float* peak)
+{
+  for (size_t c = 0; c < channels; c++) {
+    sum_squares[c] = 0;
+    peak[c] = 0;
+  }
+  for (size_t i = 0; i < frames; i++) {
+    for (size_t c = 0; c < channels; c++) {
+      float value = fabsf(samples[c]);
+      sum_squares[c] += value * value;
+      if (value > peak[c]) {
+        peak[c] = value;
+      }
+    }
+    samples += stride;
+  }
+}
+
+#ifdef __SSE2__
+static void measure_sse2(const SamplesType* samples, size_t count, size_t channels,
+                         float* sum_squares, float* peak)
+{
+  const __m128 sign = _mm_set1_ps(-0.0f);
+  __m128 squares0 = _mm_setzero_ps();
+  __m128 squares1 = _mm_setzero_ps();
+  __m128 peak0 = _mm_setzero_ps();
+  __m128 peak1 = _mm_setzero_ps();
+  size_t i = 0;
+  for (; i + METER_LANES <= count; i += METER_LANES) {
+    __m128 a = _mm_loadu_ps(samples + i);
+    __m128 b = _mm_loadu_ps(samples + i + 4);
+    squares0 = _mm_add_ps(squares0, _mm_mul_ps(a, a));
+    squares1 = _mm_add_ps(squares1, _mm_mul_ps(b, b));
+    peak0 = _mm_max_ps(peak0, _mm_andnot_ps(sign, a));
+    peak1 = _mm_max_ps(peak1, _mm_andnot_ps(sign, b));
+  }
+  float lane_squares[METER_LANES];
+  float lane_peak[METER_LANES];
+  _mm_storeu_ps(lane_squares, squares0);
+  _mm_storeu_ps(lane_squares + 4, squares1);
+  _mm_storeu_ps(lane_peak, peak0);
+  _mm_storeu_ps(lane_peak + 4, peak1);
+  finish(samples, i, count, channels, lane_squares, lane_peak, sum_squares, peak);
+}
+#endif
+
+#ifdef METER_AVX2
+__attribute__((target("avx2")))
+static void measure_avx2(const SamplesType* samples, size_t count, size_t channels,
+                         float* sum_squares, float* peak)
+{
+  const __m256 sign = _mm256_set1_ps(-0.0f);
+  // Two sets of accumulators, to hide the latency of the additions.
+  __m256 squares0 = _mm256_setzero_ps();
+  __m256 squares1 = _mm256_setzero_ps();
+  __m256 peak0 = _mm256_setzero_ps();
+  __m256 peak1 = _mm256_setzero_ps();
+  size_t i = 0;
+  for (; i + 2 * METER_LANES <= count; i += 2 * METER_LANES) {
+    __m256 a = _mm256_loadu_ps(samples + i);
+    __m256 b = _mm256_loadu_ps(samples + i + METER_LANES);
+    squares0 = _mm256_add_ps(squares0, _mm256_mul_ps(a, a));
+    squares1 = _mm256_add_ps(squares1, _mm256_mul_ps(b, b));
+    peak0 = _mm256_max_ps(peak0, _mm256_andnot_ps(sign, a));
+    peak1 = _mm256_max_ps(peak1, _mm256_andnot_ps(sign, b));
+  }
+  if (i + METER_LANES <= count) {
+    __m256 a = _mm256_loadu_ps(samples + i);
+    squares0 = _mm256_add_ps(squares0, _mm256_mul_ps(a, a));
+    peak0 = _mm256_max_ps(peak0, _mm256_andnot_ps(sign, a));
+    i += METER_LANES;
+  }
+  float lane_squares[METER_LANES];
+  float lane_peak[METER_LANES];
+  _mm256_storeu_ps(lane_squares, _mm256_add_ps(squares0, squares1));
+  _mm256_storeu_ps(lane_peak, _mm256_max_ps(peak0, peak1));
+  finish(samples, i, count, channels, lane_squares, lane_peak, sum_squares, peak);
+}
+#endif
+
+typedef void (*VectorKernel)(const SamplesType*, size_t, size_t, float*, float*);
+
+/**
+ * @brief |kernel|, if this processor can run it, or 0.
+ */
+static VectorKernel vector_kernel(Meter::Kernel kernel)
+{
+  switch (kernel) {
+#ifdef METER_AVX2
+    case Meter::AVX2:
+      __builtin_cpu_init();
+      return __builtin_cpu_supports("avx2") ? measure_avx2 : 0;
+#endif
+#ifdef __SSE2__
+    case Meter::SSE2:
+      return measure_sse2;
+#endif
+    default:
+      return 0;
+  }
+}
+
+/**
+ * @brief The best vector kernel this processor can run, or 0.
+ */
+static VectorKernel best_vector_kernel()
+{
+  VectorKernel avx2 = vector_kernel(Meter::AVX2);
+  return avx2 ? avx2 : vector_kernel(Meter::SSE2);
+}
+
+static const VectorKernel kernel = best_vector_kernel();
+
+Meter::Meter(size_t window)
+  :window_(window),frames_(0),channels_(0)
+{
+  for (size_t c = 0; c < METER_MAX_CHANNELS; c++) {
+    sum_squares_[c] = 0;
+    peak_[c] = 0;
+  }
+}
+
+void Meter::set_window(size_t frames)
+{
+  window_.store(frames ? frames : 1, std::memory_order_relaxed);
+}
+
+bool Meter::read(MeterValues* values)
+{
+  if (! values_.update()) {
+    return false;
+  }
+  *values = values_.read_buffer();
+  return true;
+}
+
+void Meter::measure(const SamplesType* samples, size_t frames, size_t channels,
+                    float* sum_squares, float* peak)
+{
+  if (kernel && channels && METER_LANES % channels == 0) {
+    kernel(samples, frames * channels, channels, sum_squares, peak);
+  } else {
+    measure_scalar(samples, frames, channels, channels, sum_squares, peak);
+  }
+}
+
+int Meter::measure_with(Kernel kernel, const SamplesType* samples, size_t frames,
+                        size_t channels, float* sum_squares, float* peak)
+{
+  if (kernel == Scalar) {
+    measure_scalar(samples, frames, channels, channels, sum_squares, peak);
+    return 0;
+  }
+  VectorKernel vector = vector_kernel(kernel);
+  if (! vector || ! channels || METER_LANES % channels != 0) {
+    return -1;
+  }
+  vector(samples, frames * channels, channels, sum_squares, peak);
+  return 0;
+}
+
+void Meter::process(SamplesType* samples, size_t length, size_t channels)
+{
+  if (channels == 0) {
+    return;
+  }
+  size_t measured = channels < METER_MAX_CHANNELS ? channels : METER_MAX_CHANNELS;
+  if (measured != channels_) {
+    // A new stream : start over.
+    channels_ = measured;
+    frames_ = 0;
+    for (size_t c = 0; c < METER_MAX_CHANNELS; c++) {
+      sum_squares_[c] = 0;
+      peak_[c] = 0;
+    }
+  }
+
+  float sum_squares[METER_MAX_CHANNELS];
+  float peak[METER_MAX_CHANNELS];
+  if (measured == channels) {
+    measure(samples, length, channels, sum_squares, peak);
+  } else {
+    measure_scalar(samples, length, channels, measured, sum_squares, peak);
+  }
+  for (size_t c = 0; c < measured; c++) {
+    sum_squares_[c] += sum_squares[c];
+    if (peak[c] > peak_[c]) {
+      peak_[c] = peak[c];
+    }
+  }
+  frames_ += length;
+
+  if (frames_ >= window_.load(std::memory_order_relaxed)) {
+    publish();
+  }
+}
+
+void Meter::publish()
+{
+  MeterValues& values = values_.write_buffer();
+  values.channels = channels_;
+  for (size_t c = 0; c < channels_; c++) {
+    values.rms[c] = sqrtf(sum_squares_[c] / frames_);
+    values.peak[c] = peak_[c];
+  }
+  if (! values_.publish()) {
+    // The previous window was dropped without being read, and is now the
+    // write buffer : publish again with its peaks folded in, so that the
+    // reader does not miss them.
+    MeterValues& merged = values_.write_buffer();
+    bool same = merged.channels == channels_;
+    merged.channels = channels_;
+    for (size_t c = 0; c < channels_; c++) {
+      merged.rms[c] = sqrtf(sum_squares_[c] / frames_);
+      if (! same || peak_[c] > merged.peak[c]) {
+        merged.peak[c] = peak_[c];
+      }
+    }
+    values_.publish();
+  }
+  for (size_t c = 0; c < channels_; c++) {
+    sum_squares_[c] = 0;
+    peak_[c] = 0;
+  }
+  frames_ = 0;
+}
@@ -0,0 +1,102 @@
+#ifndef METER_HPP
+#define METER_HPP
+
+#include "types.hpp"
+#include "Effect.hpp"
+#include "TripleBuffer.hpp"
+
+#include <atomic>
+
+/**
+ * @brief The largest number of channels a Meter measures. Further channels
+ * are ignored.
+ */
+#define METER_MAX_CHANNELS 8
+
+/**
+ * @brief The number of frames over which the values are measured, until
+ * Meter::set_window() is called.
+ */
+#define METER_DEFAULT_WINDOW 1024
+
+/**
+ * @brief The values a Meter publishes, linear.
+ */
+struct MeterValues {
+  size_t channels;
+  float rms[METER_MAX_CHANNELS];
+  float peak[METER_MAX_CHANNELS];
+};
+
+/**
+ * @brief Measure the RMS and the absolute peak of each channel, and publish
+ * them for another thread to display. The samples are left untouched.
+ *
+ * Both values are computed in a single pass over the interleaved block, with
+ * SSE2 or AVX2 when the processor has it and the channels fit evenly in a
+ * vector (1, 2, 4 or 8 channels), and a scalar loop otherwise.
+ *
+ * The blocks are gathered in windows of a fixed number of frames, whatever
+ * their size, and the values of each window are published through a
+ * TripleBuffer : the audio thread never waits for the reader, and the reader
+ * polls at its own rate. A peak published but not read is carried over to
+ * the next window, so that the reader sees all the peaks.
+ */
+class Meter : public Effect
+{
+  public:
+    Meter(size_t window = METER_DEFAULT_WINDOW);
+    virtual void process(SamplesType* samples, size_t length, size_t channels);
+    /**
+     * @brief Measure over |frames| frames, from the next window on. Any
+     * thread.
+     */
+    void set_window(size_t frames);
+    /**
+     * @brief Get the latest values. Reader thread only.
+     *
+     * @return false if nothing was published since the last call, |values|
+     * is then left untouched.
+     */
+    bool read(MeterValues* values);
+
+    /**
+     * @brief Sum the squares and find the absolute peak of each channel of
+     * |frames| interleaved frames, in one pass.
+     *
+     * @param sum_squares |channels| sums, overwritten.
+     * @param peak |channels| peaks, overwritten.
+     */
+    static void measure(const SamplesType* samples, size_t frames, size_t channels,
+                        float* sum_squares, float* peak);
+
+    enum Kernel {
+      Scalar,
+      SSE2,
+      AVX2
+    };
+    /**
+     * @brief measure(), with a given kernel rather than the best one, to
+     * compare them.
+     *
+     * @return -1 if this build or this processor cannot run |kernel|, or if
+     * it is a vector one and the channels do not fit evenly in a vector.
+     */
+    static int measure_with(Kernel kernel, const SamplesType* samples, size_t frames,
+                            size_t channels, float* sum_squares, float* peak);
+  protected:
+    /**
+     * @brief Publish the current window, and start the next one.
+     */
+    void publish();
+
+    TripleBuffer<MeterValues> values_;
+    std::atomic<size_t> window_;
+    /* Audio thread only : the window being measured. */
+    size_t frames_;
+    size_t channels_;
+    float sum_squares_[METER_MAX_CHANNELS];
+    float peak_[METER_MAX_CHANNELS];
+};
+
+#endif
@@ -0,0 +1,98 @@
+#include "MirroredMemory.hpp"
+#include "vagg/vagg_macros.h"
+
+#ifdef __linux__
+  #include <sys/mman.h>
+  #include <sys/syscall.h>
+  #include <unistd.h>
+#endif
+
+MirroredMemory::MirroredMemory()
+  :data_(0)
+  ,size_(0)
+{ }
+
+MirroredMemory::~MirroredMemory()
+{
+  release();
+}
+
+int MirroredMemory::allocate(size_t bytes)
+{
+  release();
+#if defined(__linux__) && defined(SYS_memfd_create)
+  size_t page = page_size();
+  size_t size = (bytes + page - 1) / page * page;
+
+  int fd = syscall(SYS_memfd_create, "ringbuffer", 0);
+  if (fd == -1) {
+    VAGG_LOG(VAGG_LOG_WARNING, "memfd_create failed : %s", strerror(errno));
+    return -1;
+  }
+  if (ftruncate(fd, size) == -1) {
+    VAGG_LOG(VAGG_LOG_WARNING, "ftruncate failed : %s", strerror(errno));
+    close(fd);
+    return -1;
+  }
+
+  // Reserve enough address space for both mappings, then map the same pages
+  // over each half.
+  char* base = static_cast<char*>(mmap(0, 2 * size, PROT_NONE,
+                                       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+  if (base == MAP_FAILED) {
+    VAGG_LOG(VAGG_LOG_WARNING, "mmap failed : %s", strerror(errno));
+    close(fd);
+    return -1;
+  }
+  for (size_t i = 0; i < 2; i++) {
+    void* half = mmap(base + i * size, size, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_FIXED, fd, 0);
+    if (half == MAP_FAILED) {
+      VAGG_LOG(VAGG_LOG_WARNING, "mmap failed : %s", strerror(errno));
+      munmap(base, 2 * size);
+      close(fd);
+      return -1;
+    }
+  }
+  // The mappings keep the memory alive.
+  close(fd);
+
+  data_ = base;
+  size_ = size;
+  return 0;
+#else
+  (void)bytes;
+  VAGG_LOG(VAGG_LOG_WARNING, "Mirrored memory is not supported on that system.");
+  return -1;
+#endif
+}
+
+void* MirroredMemory::data()
+{
+  return data_;
+}
+
+size_t MirroredMemory::size()
+{
+  return size_;
+}
+
+size_t MirroredMemory::page_size()
+{
+#ifdef __linux__
+  return sysconf(_SC_PAGESIZE);
+#else
+  return 4096;
+#endif
+}
+
+void MirroredMemory::release()
+{
+#ifdef __linux__
+  if (data_) {
+    munmap(data_, 2 * size_);
+  }
+#endif
+  data_ = 0;
+  size_ = 0;
+}
@@ -0,0 +1,51 @@
+#ifndef MIRROREDMEMORY_HPP
+#define MIRROREDMEMORY_HPP
+
+#include <stddef.h>
+
+/**
+ * @brief A piece of memory mapped twice, back to back, in the address space.
+ *
+ * The byte at |data() + size() + i| is the byte at |data() + i|, so that a
+ * ring buffer stored in there can hand out any window of up to size() bytes
+ * as a single contiguous span, even when it wraps around.
+ *
+ * This relies on memfd on Linux. allocate() fails on other systems, or if the
+ * kernel refuses the mapping, and the caller is expected to fall back to a
+ * plain heap allocation.
+ */
+class MirroredMemory
+{
+  public:
+    MirroredMemory();
+    ~MirroredMemory();
+    /**
+     * @brief Map at least |bytes| bytes, twice.
+     *
+     * @param bytes The size asked, rounded up to a multiple of page_size().
+     *
+     * @return 0 in case of success, -1 otherwise.
+     */
+    int allocate(size_t bytes);
+    /**
+     * @brief The start of the first mapping, 0 if nothing is mapped.
+     */
+    void* data();
+    /**
+     * @brief The size of one mapping, in bytes.
+     */
+    size_t size();
+    /**
+     * @brief The granularity of the mappings.
+     */
+    static size_t page_size();
+  protected:
+    void release();
+    MirroredMemory(const MirroredMemory&);
+    MirroredMemory& operator=(const MirroredMemory&);
+
+    void* data_;
+    size_t size_;
+};
+
+#endif
@@ -0,0 +1,322 @@
+#include "OscillatorBank.hpp"
+
+#include <math.h>
+#include <string.h>
+
+#ifdef __SSE2__
+  #include <emmintrin.h>
+#endif
+
+/* A voice cannot go past this fraction of the samplerate, so that the
+ * corrections of PolyBLEP, two samples wide, do not overlap. */
+#define OSCILLATOR_MAX_INCREMENT 0.45f
+
+OscillatorBank::OscillatorBank(int samplerate)
+  :samplerate_(samplerate)
+{
+  for (size_t i = 0; i <= OSCILLATOR_TABLE_SIZE; i++) {
+    table_[i] = sin(2 * M_PI * i / OSCILLATOR_TABLE_SIZE);
+  }
+  memset(&parameters_, 0, sizeof(parameters_));
+  memset(phases_, 0, sizeof(phases_));
+  memset(gains_, 0, sizeof(gains_));
+}
+
+int OscillatorBank::add(Waveform waveform, float frequency, float gain)
+{
+  if (waveform >= WaveformCount ||
+      parameters_.count[waveform] == OSCILLATOR_MAX_VOICES) {
+    return -1;
+  }
+  int voice = waveform * OSCILLATOR_MAX_VOICES + parameters_.count[waveform];
+  parameters_.count[waveform]++;
+  set(voice, frequency, gain);
+  return voice;
+}
+
+int OscillatorBank::set(int voice, float frequency, float gain)
+{
+  if (voice < 0 || voice >= WaveformCount * OSCILLATOR_MAX_VOICES) {
+    return -1;
+  }
+  size_t waveform = voice / OSCILLATOR_MAX_VOICES;
+  size_t slot = voice % OSCILLATOR_MAX_VOICES;
+  if (slot >= parameters_.count[waveform]) {
+    return -1;
+  }
+  float increment = frequency / samplerate_;
+  if (increment < 0) {
+    increment = 0;
+  }
+  if (increment > OSCILLATOR_MAX_INCREMENT) {
+    increment = OSCILLATOR_MAX_INCREMENT;
+  }
+  parameters_.increment[waveform][slot] = increment;
+  parameters_.gain[waveform][slot] = gain;
+  return 0;
+}
+
+void OscillatorBank::commit()
+{
+  OscillatorParameters& published = published_.write_buffer();
+  for (size_t w = 0; w < WaveformCount; w++) {
+    // The slots past the count are silent, up to a whole vector.
+    size_t rounded = (parameters_.count[w] + 3) & ~static_cast<size_t>(3);
+    published.count[w] = rounded;
+    memcpy(published.increment[w], parameters_.increment[w], rounded * sizeof(float));
+    memcpy(published.gain[w], parameters_.gain[w], rounded * sizeof(float));
+  }
+  published_.publish();
+}
+
+void OscillatorBank::process(SamplesType* samples, size_t length, size_t channels)
+{
+  for (size_t offset = 0; offset < length; offset += OSCILLATOR_CHUNK) {
+    size_t frames = length - offset < OSCILLATOR_CHUNK ? length - offset : OSCILLATOR_CHUNK;
+    render_chunk(mix_, frames);
+    SamplesType* frame = samples + offset * channels;
+    for (size_t i = 0; i < frames; i++) {
+      for (size_t c = 0; c < channels; c++) {
+        frame[c] += mix_[i];
+      }
+      frame += channels;
+    }
+  }
+}
+
+void OscillatorBank::render(SamplesType* out, size_t frames)
+{
+  for (size_t offset = 0; offset < frames; offset += OSCILLATOR_CHUNK) {
+    size_t length = frames - offset < OSCILLATOR_CHUNK ? frames - offset : OSCILLATOR_CHUNK;
+    render_chunk(out + offset, length);
+  }
+}
+
+/**
+ * @brief The PolyBLEP residual : what to add to a naive upward step of 2 at
+ * phase 0 to band-limit it. |t| is the phase, |dt| the increment, both in
+ * cycles.
+ */
+static inline float blep(float t, float dt, float inverse_dt)
+{
+  if (t < dt) {
+    float x = t * inverse_dt - 1;
+    return -x * x;
+  }
+  if (t > 1 - dt) {
+    float x = (t - 1) * inverse_dt + 1;
+    return x * x;
+  }
+  return 0;
+}
+
+/**
+ * @brief The PolyBLAMP residual : the integral of blep(), for a corner where
+ * the slope goes up by 2 per frame.
+ */
+static inline float blamp(float t, float dt, float inverse_dt)
+{
+  if (t < dt) {
+    float x = t * inverse_dt - 1;
+    return -x * x * x / 3;
+  }
+  if (t > 1 - dt) {
+    float x = (t - 1) * inverse_dt + 1;
+    return x * x * x / 3;
+  }
+  return 0;
+}
+
+static inline float wrap(float t)
+{
+  return t >= 1 ? t - 1 : t;
+}
+
+/**
+ * @brief One sample of |waveform| at phase |t|.
+ */
+static inline float oscillator(Waveform waveform, const float* table,
+                               float t, float dt, float inverse_dt)
+{
+  switch (waveform) {
+    case Sine:
+      {
+        float x = t * OSCILLATOR_TABLE_SIZE;
+        int i = static_cast<int>(x);
+        float frac = x - i;
+        return table[i] + frac * (table[i + 1] - table[i]);
+      }
+    case Saw:
+      return 2 * t - 1 - blep(t, dt, inverse_dt);
+    case Square:
+      return (t < 0.5f ? 1 : -1) + blep(t, dt, inverse_dt) -
+             blep(wrap(t + 0.5f), dt, inverse_dt);
+    case Triangle:
+    default:
+      {
+        // Starts at 0 going up, like the sine : the lowest corner is a
+        // quarter of a cycle before phase 0.
+        float s = wrap(t + 0.25f);
+        float naive = 1 - 4 * fabsf(s - 0.5f);
+        // The slope changes by 8 per cycle at each corner.
+        return naive + 4 * dt * (blamp(s, dt, inverse_dt) -
+                                 blamp(wrap(s + 0.5f), dt, inverse_dt));
+      }
+  }
+}
+
+#ifdef __SSE2__
+static inline __m128 select_ps(__m128 mask, __m128 a, __m128 b)
+{
+  return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+static inline __m128 wrap_ps(__m128 t)
+{
+  __m128 one = _mm_set1_ps(1.0f);
+  return _mm_sub_ps(t, _mm_and_ps(_mm_cmpge_ps(t, one), one));
+}
+
+static inline __m128 blep_ps(__m128 t, __m128 dt, __m128 inverse_dt)
+{
+  __m128 one = _mm_set1_ps(1.0f);
+  __m128 x = _mm_sub_ps(_mm_mul_ps(t, inverse_dt), one);
+  __m128 y = _mm_add_ps(_mm_mul_ps(_mm_sub_ps(t, one), inverse_dt), one);
+  __m128 start = _mm_and_ps(_mm_cmplt_ps(t, dt), _mm_mul_ps(x, x));
+  __m128 end = _mm_and_ps(_mm_cmpgt_ps(t, _mm_sub_ps(one, dt)), _mm_mul_ps(y, y));
+  return _mm_sub_ps(end, start);
+}
+
+static inline __m128 blamp_ps(__m128 t, __m128 dt, __m128 inverse_dt)
+{
+  __m128 one = _mm_set1_ps(1.0f);
+  __m128 third = _mm_set1_ps(1.0f / 3);
+  __m128 x = _mm_sub_ps(_mm_mul_ps(t, inverse_dt), one);
+  __m128 y = _mm_add_ps(_mm_mul_ps(_mm_sub_ps(t, one), inverse_dt), one);
+  __m128 start = _mm_and_ps(_mm_cmplt_ps(t, dt), _mm_mul_ps(_mm_mul_ps(x, x), x));
+  __m128 end = _mm_and_ps(_mm_cmpgt_ps(t, _mm_sub_ps(one, dt)), _mm_mul_ps(_mm_mul_ps(y, y), y));
+  return _mm_mul_ps(third, _mm_sub_ps(end, start));
+}
+
+static inline __m128 oscillator_ps(Waveform waveform, const float* table,
+                                   __m128 t, __m128 dt, __m128 inverse_dt)
+{
+  __m128 one = _mm_set1_ps(1.0f);
+  __m128 half = _mm_set1_ps(0.5f);
+  switch (waveform) {
+    case Sine:
+      {
+        // No gather in SSE : the four lookups are scalar.
+        __m128 x = _mm_mul_ps(t, _mm_set1_ps(OSCILLATOR_TABLE_SIZE));
+        __m128i i = _mm_cvttps_epi32(x);
+        __m128 frac = _mm_sub_ps(x, _mm_cvtepi32_ps(i));
+        int index[4];
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(index), i);
+        __m128 a = _mm_setr_ps(table[index[0]], table[index[1]],
+                               table[index[2]], table[index[3]]);
+        __m128 b = _mm_setr_ps(table[index[0] + 1], table[index[1] + 1],
+                               table[index[2] + 1], table[index[3] + 1]);
+        return _mm_add_ps(a, _mm_mul_ps(frac, _mm_sub_ps(b, a)));
+      }
+    case Saw:
+      return _mm_sub_ps(_mm_sub_ps(_mm_add_ps(t, t), one), blep_ps(t, dt, inverse_dt));
+    case Square:
+      {
+        __m128 naive = select_ps(_mm_cmplt_ps(t, half), one, _mm_sub_ps(_mm_setzero_ps(), one));
+        return _mm_sub_ps(_mm_add_ps(naive, blep_ps(t, dt, inverse_dt)),
+                          blep_ps(wrap_ps(_mm_add_ps(t, half)), dt, inverse_dt));
+      }
+    case Triangle:
+    default:
+      {
+        __m128 abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+        __m128 s = wrap_ps(_mm_add_ps(t, _mm_set1_ps(0.25f)));
+        __m128 distance = _mm_and_ps(_mm_sub_ps(s, half), abs_mask);
+        __m128 naive = _mm_sub_ps(one, _mm_mul_ps(_mm_set1_ps(4.0f), distance));
+        __m128 corners = _mm_sub_ps(blamp_ps(s, dt, inverse_dt),
+                                    blamp_ps(wrap_ps(_mm_add_ps(s, half)), dt, inverse_dt));
+        return _mm_add_ps(naive, _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(4.0f), dt), corners));
+      }
+  }
+}
+#endif
+
+void OscillatorBank::render_chunk(SamplesType* out, size_t frames)
+{
+  published_.update();
+#ifdef __SSE2__
+  render_chunk_sse(published_.read_buffer(), out, frames);
+#else
+  render_chunk_scalar(published_.read_buffer(), out, frames);
+#endif
+}
+
+#ifdef __SSE2__
+void OscillatorBank::render_chunk_sse(const OscillatorParameters& p, SamplesType* out,
+                                      size_t frames)
+{
+  float inverse_frames = 1.0f / frames;
+  memset(lanes_, 0, 4 * frames * sizeof(float));
+  for (size_t w = 0; w < WaveformCount; w++) {
+    Waveform waveform = static_cast<Waveform>(w);
+    for (size_t v = 0; v < p.count[w]; v += 4) {
+      __m128 t = _mm_loadu_ps(&phases_[w][v]);
+      __m128 dt = _mm_loadu_ps(&p.increment[w][v]);
+      // Silent voices have no increment, and never use the inverse.
+      __m128 inverse_dt = _mm_div_ps(_mm_set1_ps(1.0f), dt);
+      __m128 gain = _mm_loadu_ps(&gains_[w][v]);
+      __m128 target = _mm_loadu_ps(&p.gain[w][v]);
+      __m128 step = _mm_mul_ps(_mm_sub_ps(target, gain), _mm_set1_ps(inverse_frames));
+      for (size_t i = 0; i < frames; i++) {
+        __m128 value = oscillator_ps(waveform, table_, t, dt, inverse_dt);
+        _mm_storeu_ps(lanes_ + 4 * i, _mm_add_ps(_mm_loadu_ps(lanes_ + 4 * i),
+                                                 _mm_mul_ps(value, gain)));
+        gain = _mm_add_ps(gain, step);
+        t = wrap_ps(_mm_add_ps(t, dt));
+      }
+      _mm_storeu_ps(&phases_[w][v], t);
+      _mm_storeu_ps(&gains_[w][v], target);
+    }
+  }
+  // Sum the lanes of four frames at once.
+  size_t i = 0;
+  for (; i + 4 <= frames; i += 4) {
+    __m128 a = _mm_loadu_ps(lanes_ + 4 * i);
+    __m128 b = _mm_loadu_ps(lanes_ + 4 * i + 4);
+    __m128 c = _mm_loadu_ps(lanes_ + 4 * i + 8);
+    __m128 d = _mm_loadu_ps(lanes_ + 4 * i + 12);
+    _MM_TRANSPOSE4_PS(a, b, c, d);
+    _mm_storeu_ps(out + i, _mm_add_ps(_mm_add_ps(a, b), _mm_add_ps(c, d)));
+  }
+  for (; i < frames; i++) {
+    const float* l = lanes_ + 4 * i;
+    // In the same order as above, so that the output does not depend on
+    // where the blocks end.
+    out[i] = (l[0] + l[1]) + (l[2] + l[3]);
+  }
+}
+#endif
+
+void OscillatorBank::render_chunk_scalar(const OscillatorParameters& p, SamplesType* out,
+                                         size_t frames)
+{
+  float inverse_frames = 1.0f / frames;
+  memset(out, 0, frames * sizeof(SamplesType));
+  for (size_t w = 0; w < WaveformCount; w++) {
+    Waveform waveform = static_cast<Waveform>(w);
+    for (size_t v = 0; v < p.count[w]; v++) {
+      float t = phases_[w][v];
+      float dt = p.increment[w][v];
+      float inverse_dt = dt > 0 ? 1 / dt : 0;
+      float gain = gains_[w][v];
+      float step = (p.gain[w][v] - gain) * inverse_frames;
+      for (size_t i = 0; i < frames; i++) {
+        out[i] += oscillator(waveform, table_, t, dt, inverse_dt) * gain;
+        gain += step;
+        t = wrap(t + dt);
+      }
+      phases_[w][v] = t;
+      gains_[w][v] = p.gain[w][v];
+    }
+  }
+}
@@ -0,0 +1,124 @@
+#ifndef OSCILLATORBANK_HPP
+#define OSCILLATORBANK_HPP
+
+#include "types.hpp"
+#include "Effect.hpp"
+#include "TripleBuffer.hpp"
+
+/**
+ * @brief The number of voices of each waveform.
+ */
+#define OSCILLATOR_MAX_VOICES 256
+/**
+ * @brief The number of points of the sine table. With linear interpolation,
+ * the error is under 1.2e-6.
+ */
+#define OSCILLATOR_TABLE_SIZE 2048
+/**
+ * @brief The number of frames rendered at once.
+ */
+#define OSCILLATOR_CHUNK 256
+
+enum Waveform {
+  Sine,
+  Saw,
+  Square,
+  Triangle,
+  WaveformCount
+};
+
+/**
+ * @brief The settings of all the voices, grouped by waveform. The arrays
+ * are filled with silent voices up to a multiple of four.
+ */
+struct OscillatorParameters {
+  size_t count[WaveformCount];
+  /* In cycles per frame. */
+  float increment[WaveformCount][OSCILLATOR_MAX_VOICES];
+  float gain[WaveformCount][OSCILLATOR_MAX_VOICES];
+};
+
+/**
+ * @brief Many oscillators, mixed down to one signal.
+ *
+ * Each voice has a phase in cycles, a float between 0 and 1 that wraps
+ * around, so that the precision does not depend on how long it has been
+ * running. The sine is read from a table with linear interpolation. The saw
+ * and the square are corrected with PolyBLEP, and the corners of the
+ * triangle with PolyBLAMP, so that they alias much less than the naive
+ * waveforms.
+ *
+ * The voices of each waveform are stored as arrays of phases, increments
+ * and gains. With SSE, four voices run side by side, and their sum is
+ * written back once per chunk. Voices are set from a control thread, and
+ * the whole set is published through a TripleBuffer by commit() : the audio
+ * thread picks it up at the start of a block. Voices are never removed, a
+ * voice with a gain of 0 is silent. Changing the frequency of a voice keeps
+ * its phase.
+ */
+class OscillatorBank : public Effect
+{
+  public:
+    OscillatorBank(int samplerate);
+    /**
+     * @brief Add a voice. Control thread only, applied on the next
+     * commit().
+     *
+     * @param frequency In Hz, up to a bit less than half the samplerate.
+     *
+     * @return An identifier for the voice, or -1 if there are already
+     * OSCILLATOR_MAX_VOICES voices of that waveform.
+     */
+    int add(Waveform waveform, float frequency, float gain);
+    /**
+     * @brief Change a voice. Control thread only, applied on the next
+     * commit().
+     *
+     * @return -1 if there is no such voice.
+     */
+    int set(int voice, float frequency, float gain);
+    /**
+     * @brief Publish the changes since the last commit(). Control thread
+     * only.
+     */
+    void commit();
+    /**
+     * @brief Write the next |frames| frames of the mix to |out|. Audio
+     * thread only.
+     */
+    void render(SamplesType* out, size_t frames);
+    /**
+     * @brief Add the mix to every channel.
+     */
+    virtual void process(SamplesType* samples, size_t length, size_t channels);
+  protected:
+    OscillatorBank(const OscillatorBank&);
+    OscillatorBank& operator=(const OscillatorBank&);
+
+    void render_chunk(SamplesType* out, size_t frames);
+#ifdef __SSE2__
+    void render_chunk_sse(const OscillatorParameters& p, SamplesType* out, size_t frames);
+#endif
+    /**
+     * @brief The same voices, one at a time, for processors without SSE2.
+     */
+    void render_chunk_scalar(const OscillatorParameters& p, SamplesType* out, size_t frames);
+
+    int samplerate_;
+    float table_[OSCILLATOR_TABLE_SIZE + 1];
+
+    /* Control thread only. */
+    OscillatorParameters parameters_;
+
+    TripleBuffer<OscillatorParameters> published_;
+
+    /* Audio thread only. The gains move to the published ones over a
+     * chunk, to avoid clicks. */
+    float phases_[WaveformCount][OSCILLATOR_MAX_VOICES];
+    float gains_[WaveformCount][OSCILLATOR_MAX_VOICES];
+    SamplesType mix_[OSCILLATOR_CHUNK];
+    /* The partial sums of each lane of a vector, for each frame. */
+    float lanes_[4 * OSCILLATOR_CHUNK];
+};
+
+#endif
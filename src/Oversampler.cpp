@@ -0,0 +1,176 @@
+#include "Oversampler.hpp"
+#include "Interleave.hpp"
+
+#include <math.h>
+#include <string.h>
+
+#ifdef __SSE__
+  #include <xmmintrin.h>
+#endif
+
+/* The Kaiser window parameter for about 80 dB of stop band attenuation. */
+#define OVERSAMPLER_KAISER_BETA 7.86
+
+/* Each stage and channel keeps the history of the filter on the way up, of
+ * the even phase on the way down, and of the odd phase on the way down. */
+#define UP_HISTORY (OVERSAMPLER_PHASE_TAPS - 1)
+#define EVEN_HISTORY (OVERSAMPLER_PHASE_TAPS - 1)
+#define ODD_HISTORY (OVERSAMPLER_PHASE_TAPS / 2)
+#define HISTORY (UP_HISTORY + EVEN_HISTORY + ODD_HISTORY)
+
+/**
+ * @brief The modified Bessel function of the first kind, of order 0.
+ */
+static double bessel_i0(double x)
+{
+  double sum = 1;
+  double term = 1;
+  for (int k = 1; k < 32; k++) {
+    term *= (x / (2 * k)) * (x / (2 * k));
+    sum += term;
+  }
+  return sum;
+}
+
+Oversampler::Oversampler(size_t channels, size_t factor, size_t max_frames)
+  :channels_(channels),stages_(0),max_frames_(max_frames)
+{
+  while (static_cast<size_t>(2) << stages_ <= factor && stages_ < 3) {
+    stages_++;
+  }
+
+  // The half-band filter has 2 * OVERSAMPLER_PHASE_TAPS - 1 taps centered on
+  // an odd one : the taps at an even distance from the center are zero,
+  // except for the center, which is 0.5. Only the others are kept. They are
+  // scaled so that they sum to 1 : the up stage takes the gain of 2 that
+  // makes up for the zeros inserted, the down stage halves it.
+  const int center = OVERSAMPLER_PHASE_TAPS - 1;
+  double sum = 0;
+  for (int j = 0; j < OVERSAMPLER_PHASE_TAPS; j++) {
+    int distance = center - 2 * j;
+    double t = M_PI * distance / 2;
+    double ratio = static_cast<double>(distance) / center;
+    double window = bessel_i0(OVERSAMPLER_KAISER_BETA * sqrt(1 - ratio * ratio)) /
+                    bessel_i0(OVERSAMPLER_KAISER_BETA);
+    taps_[j] = sin(t) / t * window;
+    sum += taps_[j];
+  }
+  for (int j = 0; j < OVERSAMPLER_PHASE_TAPS; j++) {
+    taps_[j] /= sum;
+  }
+
+  size_t longest = max_frames_ << (stages_ ? stages_ - 1 : 0);
+  extended_ = new SamplesType[UP_HISTORY + longest];
+  odd_ = new SamplesType[ODD_HISTORY + longest];
+  even_ = new SamplesType[longest];
+  levels_ = new SamplesType*[stages_ + 1];
+  for (size_t s = 0; s <= stages_; s++) {
+    levels_[s] = new SamplesType[max_frames_ << s];
+  }
+  histories_ = new float[HISTORY * stages_ * channels_ + 1];
+  memset(histories_, 0, (HISTORY * stages_ * channels_ + 1) * sizeof(float));
+}
+
+Oversampler::~Oversampler()
+{
+  for (size_t s = 0; s <= stages_; s++) {
+    delete [] levels_[s];
+  }
+  delete [] levels_;
+  delete [] extended_;
+  delete [] odd_;
+  delete [] even_;
+  delete [] histories_;
+}
+
+double Oversampler::latency() const
+{
+  // Each filter delays by its center tap, at the rate it runs.
+  double latency = 0;
+  for (size_t s = 0; s < stages_; s++) {
+    latency += 2.0 * (OVERSAMPLER_PHASE_TAPS - 1) / (2 << s);
+  }
+  return latency;
+}
+
+float* Oversampler::history(size_t stage, size_t channel, size_t which) const
+{
+  static const size_t offsets[3] = {0, UP_HISTORY, UP_HISTORY + EVEN_HISTORY};
+  return histories_ + (stage * channels_ + channel) * HISTORY + offsets[which];
+}
+
+void Oversampler::filter(const SamplesType* in, SamplesType* out, size_t length) const
+{
+  size_t n = 0;
+#ifdef __SSE__
+  for (; n + 4 <= length; n += 4) {
+    __m128 sum = _mm_setzero_ps();
+    for (size_t j = 0; j < OVERSAMPLER_PHASE_TAPS; j++) {
+      sum = _mm_add_ps(sum, _mm_mul_ps(_mm_load1_ps(taps_ + j),
+                                       _mm_loadu_ps(in + n - j)));
+    }
+    _mm_storeu_ps(out + n, sum);
+  }
+#endif
+  for (; n < length; n++) {
+    float sum = 0;
+    for (size_t j = 0; j < OVERSAMPLER_PHASE_TAPS; j++) {
+      sum += taps_[j] * in[n - j];
+    }
+    out[n] = sum;
+  }
+}
+
+SamplesType* Oversampler::up(const SamplesType* in, size_t frames, size_t channel)
+{
+  if (! stages_) {
+    memcpy(levels_[0], in, frames * sizeof(SamplesType));
+    return levels_[0];
+  }
+  for (size_t s = 0; s < stages_; s++) {
+    const SamplesType* x = s ? levels_[s] : in;
+    size_t length = frames << s;
+    float* saved = history(s, channel, 0);
+    memcpy(extended_, saved, UP_HISTORY * sizeof(SamplesType));
+    memcpy(extended_ + UP_HISTORY, x, length * sizeof(SamplesType));
+    // The even samples are filtered, the odd ones only hit the center tap,
+    // which makes them a delayed copy of the input.
+    filter(extended_ + UP_HISTORY, even_, length);
+    SamplesType* phases[2] = {even_, extended_ + OVERSAMPLER_PHASE_TAPS / 2};
+    interleave(phases, levels_[s + 1], length, 2);
+    memcpy(saved, extended_ + length, UP_HISTORY * sizeof(SamplesType));
+  }
+  return levels_[stages_];
+}
+
+void Oversampler::down(SamplesType* out, size_t frames, size_t channel)
+{
+  if (! stages_) {
+    memcpy(out, levels_[0], frames * sizeof(SamplesType));
+    return;
+  }
+  for (size_t s = stages_; s-- > 0;) {
+    SamplesType* y = s ? levels_[s] : out;
+    size_t length = frames << s;
+    float* even_saved = history(s, channel, 1);
+    float* odd_saved = history(s, channel, 2);
+    memcpy(extended_, even_saved, EVEN_HISTORY * sizeof(SamplesType));
+    memcpy(odd_, odd_saved, ODD_HISTORY * sizeof(SamplesType));
+    SamplesType* phases[2] = {extended_ + EVEN_HISTORY, odd_ + ODD_HISTORY};
+    deinterleave(levels_[s + 1], phases, length, 2);
+    filter(extended_ + EVEN_HISTORY, even_, length);
+    size_t n = 0;
+#ifdef __SSE__
+    __m128 half = _mm_set1_ps(0.5f);
+    for (; n + 4 <= length; n += 4) {
+      _mm_storeu_ps(y + n, _mm_mul_ps(half, _mm_add_ps(_mm_loadu_ps(even_ + n),
+                                                       _mm_loadu_ps(odd_ + n))));
+    }
+#endif
+    for (; n < length; n++) {
+      y[n] = 0.5f * (even_[n] + odd_[n]);
+    }
+    memcpy(even_saved, extended_ + length, EVEN_HISTORY * sizeof(SamplesType));
+    memcpy(odd_saved, odd_ + length, ODD_HISTORY * sizeof(SamplesType));
+  }
+}
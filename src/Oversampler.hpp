@@ -0,0 +1,88 @@
+#ifndef OVERSAMPLER_HPP
+#define OVERSAMPLER_HPP
+
+#include "types.hpp"
+
+/**
+ * @brief The number of non-zero taps of the even phase of the half-band
+ * filter. The whole filter has 2 * OVERSAMPLER_PHASE_TAPS - 1 taps.
+ */
+#define OVERSAMPLER_PHASE_TAPS 24
+
+/**
+ * @brief Run a block at 2, 4, ... times the samplerate, so that a non-linear
+ * process aliases less.
+ *
+ * Each factor of two is a stage of half-band FIR filters : zeros are
+ * inserted between the samples and filtered out on the way up, and the
+ * signal is filtered again before dropping every other sample on the way
+ * down. Half of the taps of a half-band filter are zero, and the other half
+ * is split in two phases that run at the lower rate. The filters are a
+ * Kaiser windowed sinc : a round trip is flat within 0.03 dB up to 0.4
+ * times the lower samplerate, and images are 80 dB down from 0.64 times
+ * it.
+ *
+ * The channels are processed one at a time : up() and down() are called in
+ * pairs, with the same number of frames, for each channel. Each channel
+ * keeps its own filter state from one block to the next. Nothing is
+ * allocated after the constructor.
+ */
+class Oversampler
+{
+  public:
+    /**
+     * @param factor 1, 2, 4 or 8. Anything else is rounded down to one of
+     * these.
+     * @param max_frames The longest block passed to up().
+     */
+    Oversampler(size_t channels, size_t factor, size_t max_frames);
+    ~Oversampler();
+    /**
+     * @brief Upsample |frames| samples of |channel|.
+     *
+     * @return |frames| * factor() samples, to modify in place and pass to
+     * down().
+     */
+    SamplesType* up(const SamplesType* in, size_t frames, size_t channel);
+    /**
+     * @brief Downsample the block returned by the last up() to |frames|
+     * samples.
+     */
+    void down(SamplesType* out, size_t frames, size_t channel);
+    size_t factor() const
+    {
+      return 1 << stages_;
+    }
+    /**
+     * @brief The delay added by a pair of up() and down(), in frames at the
+     * lower rate.
+     */
+    double latency() const;
+  protected:
+    Oversampler(const Oversampler&);
+    Oversampler& operator=(const Oversampler&);
+
+    /**
+     * @brief out[n] = sum of taps_[j] * in[n - j], for |length| samples.
+     * |in| is preceded by OVERSAMPLER_PHASE_TAPS - 1 samples of history.
+     */
+    void filter(const SamplesType* in, SamplesType* out, size_t length) const;
+    float* history(size_t stage, size_t channel, size_t which) const;
+
+    size_t channels_;
+    size_t stages_;
+    size_t max_frames_;
+    /* The even phase of the half-band filter. */
+    float taps_[OVERSAMPLER_PHASE_TAPS];
+    /* The input of a stage with its history in front, and the two phases
+     * of its output, or the reverse on the way down. */
+    SamplesType* extended_;
+    SamplesType* odd_;
+    SamplesType* even_;
+    /* The signal at each rate above the input. */
+    SamplesType** levels_;
+    /* The filter histories of each stage and channel. */
+    float* histories_;
+};
+
+#endif
@@ -30,6 +30,26 @@ class RMS : public Effect
       callback_(acc, channels, userdata_);
     }
 
+    virtual bool planar() const
+    {
+      return true;
+    }
+
+    // Each channel is contiguous : one straight pass per channel.
+    virtual void process_planar(SamplesType** samples, size_t length, size_t channels)
+    {
+      float acc[channels];
+      for (size_t c = 0; c < channels; c++) {
+        const SamplesType* channel = samples[c];
+        float sum = 0;
+        for (size_t i = 0; i < length; i++) {
+          sum += channel[i] * channel[i];
+        }
+        acc[c] = sqrt(sum / length);
+      }
+      callback_(acc, channels, userdata_);
+    }
+
   protected:
    void (*callback_)(float*, size_t, void*);
    void* userdata_;
@@ -0,0 +1,447 @@
+#include "ReadAhead.hpp"
+#include "vagg/vagg_macros.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef __linux__
+  #include <sys/syscall.h>
+#endif
+
+// Without liburing : the system calls are made by hand, which only needs the
+// kernel headers.
+#if defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter)
+  #define READ_AHEAD_IO_URING
+  #include <linux/io_uring.h>
+  #include <sys/mman.h>
+#endif
+
+/**
+ * @brief pread() |length| bytes at |offset|, or up to the end of the file.
+ *
+ * @return The number of bytes read, or minus the errno.
+ */
+static int64_t read_fully(int fd, unsigned char* data, int64_t offset, int64_t length)
+{
+  int64_t done = 0;
+  while (done < length) {
+    ssize_t count = pread(fd, data + done, length - done, offset + done);
+    if (count == -1) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return -errno;
+    }
+    if (count == 0) {
+      break;
+    }
+    done += count;
+  }
+  return done;
+}
+
+ReadAhead::ReadAhead(bool use_io_uring)
+  :fd_(-1),size_(0),position_(0),next_offset_(0),head_(0)
+  ,engine_(ThreadPool),use_io_uring_(use_io_uring)
+  ,ring_fd_(-1),sq_ring_(0),sq_ring_size_(0),cq_ring_(0),cq_ring_size_(0)
+  ,sqes_(0),sqes_size_(0),sq_tail_(0),sq_mask_(0),sq_array_(0)
+  ,cq_head_(0),cq_tail_(0),cq_mask_(0),cqes_(0)
+  ,stopping_(false)
+{
+  blocks_.resize(READ_AHEAD_DEPTH);
+  iovecs_.resize(READ_AHEAD_DEPTH);
+  for (size_t i = 0; i < blocks_.size(); i++) {
+    void* data;
+    if (posix_memalign(&data, READ_AHEAD_ALIGNMENT, READ_AHEAD_BLOCK_SIZE) != 0) {
+      data = 0;
+    }
+    blocks_[i].data = static_cast<unsigned char*>(data);
+    blocks_[i].offset = 0;
+    blocks_[i].length = 0;
+    blocks_[i].state = Idle;
+  }
+}
+
+ReadAhead::~ReadAhead()
+{
+  if (fd_ != -1) {
+    // The kernel or the threads may still write to the blocks.
+    wait_all();
+    ::close(fd_);
+  }
+  teardown_io_uring();
+  stop_threads();
+  for (size_t i = 0; i < blocks_.size(); i++) {
+    free(blocks_[i].data);
+  }
+}
+
+int ReadAhead::open(const char* path)
+{
+  for (size_t i = 0; i < blocks_.size(); i++) {
+    if (! blocks_[i].data) {
+      return -1;
+    }
+  }
+  fd_ = ::open(path, O_RDONLY);
+  if (fd_ == -1) {
+    return -1;
+  }
+  struct stat st;
+  if (fstat(fd_, &st) == -1 || ! S_ISREG(st.st_mode)) {
+    ::close(fd_);
+    fd_ = -1;
+    return -1;
+  }
+  size_ = st.st_size;
+#ifdef POSIX_FADV_SEQUENTIAL
+  posix_fadvise(fd_, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+  if (use_io_uring_ && setup_io_uring()) {
+    engine_ = IoUring;
+  } else {
+    engine_ = ThreadPool;
+    start_threads();
+  }
+  VAGG_LOG(VAGG_LOG_DEBUG, "Reading %s ahead with %s", path,
+           engine_ == IoUring ? "io_uring" : "threads");
+  restart(0);
+  return 0;
+}
+
+int64_t ReadAhead::read(void* out, int64_t count)
+{
+  unsigned char* destination = static_cast<unsigned char*>(out);
+  int64_t copied = 0;
+  while (copied < count && position_ < size_) {
+    Block& block = blocks_[head_];
+    if (position_ < block.offset || position_ >= next_offset_) {
+      // Not in any block requested : a seek.
+      restart(position_);
+      continue;
+    }
+    if (position_ >= block.offset + READ_AHEAD_BLOCK_SIZE) {
+      // Done with the first block, request it again after the last one.
+      wait(head_);
+      request(head_);
+      head_ = (head_ + 1) % blocks_.size();
+      continue;
+    }
+    wait(head_);
+    if (block.length < 0) {
+      VAGG_LOG(VAGG_LOG_WARNING, "Read error : %s", strerror(-block.length));
+      break;
+    }
+    int64_t end = block.offset + block.length;
+    if (position_ >= end) {
+      // The file got shorter.
+      break;
+    }
+    int64_t length = end - position_;
+    if (length > count - copied) {
+      length = count - copied;
+    }
+    memcpy(destination + copied, block.data + (position_ - block.offset), length);
+    copied += length;
+    position_ += length;
+  }
+  return copied;
+}
+
+int64_t ReadAhead::seek(int64_t offset, int whence)
+{
+  int64_t position;
+  switch (whence) {
+    case SEEK_SET:
+      position = offset;
+      break;
+    case SEEK_CUR:
+      position = position_ + offset;
+      break;
+    case SEEK_END:
+      position = size_ + offset;
+      break;
+    default:
+      return -1;
+  }
+  if (position < 0) {
+    return -1;
+  }
+  // The blocks are requested again on the next read, if needed.
+  position_ = position;
+  return position_;
+}
+
+void ReadAhead::restart(int64_t offset)
+{
+  wait_all();
+  next_offset_ = offset - offset % READ_AHEAD_ALIGNMENT;
+  head_ = 0;
+  for (size_t i = 0; i < blocks_.size(); i++) {
+    request(i);
+  }
+}
+
+void ReadAhead::request(size_t index)
+{
+  Block& block = blocks_[index];
+  block.offset = next_offset_;
+  next_offset_ += READ_AHEAD_BLOCK_SIZE;
+  if (block.offset < size_) {
+    submit(index);
+  } else {
+    block.length = 0;
+    block.state = Idle;
+  }
+}
+
+void ReadAhead::submit(size_t index)
+{
+  if (engine_ == IoUring) {
+    blocks_[index].state = InFlight;
+    submit_io_uring(index);
+  } else {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      blocks_[index].state = InFlight;
+      queue_.push_back(index);
+    }
+    requested_.notify_one();
+  }
+}
+
+void ReadAhead::wait(size_t index)
+{
+  if (engine_ == IoUring) {
+    while (blocks_[index].state == InFlight) {
+      reap_io_uring(true);
+    }
+  } else {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (blocks_[index].state == InFlight) {
+      completed_.wait(lock);
+    }
+  }
+}
+
+void ReadAhead::wait_all()
+{
+  for (size_t i = 0; i < blocks_.size(); i++) {
+    wait(i);
+  }
+}
+
+bool ReadAhead::setup_io_uring()
+{
+#ifdef READ_AHEAD_IO_URING
+  struct io_uring_params params;
+  memset(&params, 0, sizeof(params));
+  int fd = syscall(__NR_io_uring_setup, READ_AHEAD_DEPTH, &params);
+  if (fd == -1) {
+    // Older kernels, or disabled by the administrator or a sandbox.
+    VAGG_LOG(VAGG_LOG_DEBUG, "No io_uring : %s", strerror(errno));
+    return false;
+  }
+  ring_fd_ = fd;
+  sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  cq_ring_size_ = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+  bool single_mapping = false;
+#ifdef IORING_FEAT_SINGLE_MMAP
+  if (params.features & IORING_FEAT_SINGLE_MMAP) {
+    single_mapping = true;
+    if (cq_ring_size_ > sq_ring_size_) {
+      sq_ring_size_ = cq_ring_size_;
+    }
+    cq_ring_size_ = sq_ring_size_;
+  }
+#endif
+  void* sq_ring = mmap(0, sq_ring_size_, PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+  if (sq_ring == MAP_FAILED) {
+    teardown_io_uring();
+    return false;
+  }
+  sq_ring_ = sq_ring;
+  if (single_mapping) {
+    cq_ring_ = sq_ring_;
+  } else {
+    void* cq_ring = mmap(0, cq_ring_size_, PROT_READ | PROT_WRITE,
+                         MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+    if (cq_ring == MAP_FAILED) {
+      teardown_io_uring();
+      return false;
+    }
+    cq_ring_ = cq_ring;
+  }
+  sqes_size_ = params.sq_entries * sizeof(struct io_uring_sqe);
+  void* sqes = mmap(0, sqes_size_, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+  if (sqes == MAP_FAILED) {
+    teardown_io_uring();
+    return false;
+  }
+  sqes_ = sqes;
+
+  unsigned char* sq = static_cast<unsigned char*>(sq_ring_);
+  unsigned char* cq = static_cast<unsigned char*>(cq_ring_);
+  sq_tail_ = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+  sq_mask_ = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+  sq_array_ = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+  cq_head_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+  cq_tail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+  cq_mask_ = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+  cqes_ = cq + params.cq_off.cqes;
+  return true;
+#else
+  return false;
+#endif
+}
+
+void ReadAhead::teardown_io_uring()
+{
+#ifdef READ_AHEAD_IO_URING
+  if (sqes_) {
+    munmap(sqes_, sqes_size_);
+  }
+  if (cq_ring_ && cq_ring_ != sq_ring_) {
+    munmap(cq_ring_, cq_ring_size_);
+  }
+  if (sq_ring_) {
+    munmap(sq_ring_, sq_ring_size_);
+  }
+  if (ring_fd_ != -1) {
+    ::close(ring_fd_);
+  }
+#endif
+  sqes_ = cq_ring_ = sq_ring_ = 0;
+  ring_fd_ = -1;
+}
+
+void ReadAhead::submit_io_uring(size_t index)
+{
+#ifdef READ_AHEAD_IO_URING
+  Block& block = blocks_[index];
+  iovecs_[index].iov_base = block.data;
+  iovecs_[index].iov_len = READ_AHEAD_BLOCK_SIZE;
+
+  // This thread is the only one to write the submission queue, the kernel
+  // reads it.
+  unsigned tail = *sq_tail_;
+  unsigned slot = tail & *sq_mask_;
+  struct io_uring_sqe* sqe = static_cast<struct io_uring_sqe*>(sqes_) + slot;
+  memset(sqe, 0, sizeof(*sqe));
+  // IORING_OP_READV is there since the first io_uring kernels.
+  sqe->opcode = IORING_OP_READV;
+  sqe->fd = fd_;
+  sqe->addr = reinterpret_cast<uintptr_t>(&iovecs_[index]);
+  sqe->len = 1;
+  sqe->off = block.offset;
+  sqe->user_data = index;
+  sq_array_[slot] = slot;
+  __atomic_store_n(sq_tail_, tail + 1, __ATOMIC_RELEASE);
+
+  int submitted;
+  do {
+    submitted = syscall(__NR_io_uring_enter, ring_fd_, 1, 0, 0, NULL, 0);
+  } while (submitted == -1 && errno == EINTR);
+  if (submitted == -1) {
+    VAGG_LOG(VAGG_LOG_FATAL, "io_uring_enter : %s", strerror(errno));
+    block.length = -errno;
+    block.state = Ready;
+  }
+#else
+  (void)index;
+#endif
+}
+
+void ReadAhead::reap_io_uring(bool block)
+{
+#ifdef READ_AHEAD_IO_URING
+  unsigned head = *cq_head_;
+  unsigned tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+  if (head == tail && block) {
+    int result = syscall(__NR_io_uring_enter, ring_fd_, 0, 1,
+                         IORING_ENTER_GETEVENTS, NULL, 0);
+    if (result == -1 && errno != EINTR) {
+      VAGG_LOG(VAGG_LOG_FATAL, "io_uring_enter : %s", strerror(errno));
+      // Do not wait forever for completions that will not come.
+      for (size_t i = 0; i < blocks_.size(); i++) {
+        if (blocks_[i].state == InFlight) {
+          blocks_[i].length = -EIO;
+          blocks_[i].state = Ready;
+        }
+      }
+      return;
+    }
+    tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+  }
+  for (; head != tail; head++) {
+    struct io_uring_cqe* cqe = static_cast<struct io_uring_cqe*>(cqes_) + (head & *cq_mask_);
+    Block& completed = blocks_[cqe->user_data];
+    completed.length = cqe->res;
+    int64_t end = completed.offset + completed.length;
+    if (completed.length >= 0 && completed.length < READ_AHEAD_BLOCK_SIZE && end < size_) {
+      // A short read before the end of the file, which is rare with regular
+      // files : finish it here.
+      int64_t rest = read_fully(fd_, completed.data + completed.length, end,
+                                READ_AHEAD_BLOCK_SIZE - completed.length);
+      completed.length = rest < 0 ? rest : completed.length + rest;
+    }
+    completed.state = Ready;
+  }
+  __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+#else
+  (void)block;
+#endif
+}
+
+void ReadAhead::start_threads()
+{
+  stopping_ = false;
+  for (size_t i = 0; i < READ_AHEAD_THREADS; i++) {
+    threads_.push_back(std::thread(&ReadAhead::worker_loop, this));
+  }
+}
+
+void ReadAhead::stop_threads()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  requested_.notify_all();
+  for (size_t i = 0; i < threads_.size(); i++) {
+    threads_[i].join();
+  }
+  threads_.clear();
+}
+
+void ReadAhead::worker_loop()
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    while (! stopping_ && queue_.empty()) {
+      requested_.wait(lock);
+    }
+    if (stopping_) {
+      return;
+    }
+    size_t index = queue_.front();
+    queue_.pop_front();
+    unsigned char* data = blocks_[index].data;
+    int64_t offset = blocks_[index].offset;
+
+    lock.unlock();
+    int64_t length = read_fully(fd_, data, offset, READ_AHEAD_BLOCK_SIZE);
+    lock.lock();
+
+    blocks_[index].length = length;
+    blocks_[index].state = Ready;
+    completed_.notify_all();
+  }
+}
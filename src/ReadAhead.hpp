@@ -0,0 +1,176 @@
+#ifndef READAHEAD_HPP
+#define READAHEAD_HPP
+
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief The size of a read request, in bytes. A multiple of
+ * READ_AHEAD_ALIGNMENT.
+ */
+#define READ_AHEAD_BLOCK_SIZE (256 * 1024)
+/**
+ * @brief The number of read requests kept in flight.
+ */
+#define READ_AHEAD_DEPTH 4
+/**
+ * @brief The alignment of the buffers and of the offsets of the requests.
+ */
+#define READ_AHEAD_ALIGNMENT 4096
+/**
+ * @brief The number of threads doing the reads, when io_uring is not there.
+ */
+#define READ_AHEAD_THREADS 2
+
+/**
+ * @brief Read a file sequentially, with the next blocks already being read
+ * in the background, so that a slow disk does not stall the reader.
+ *
+ * The file is read in aligned blocks of READ_AHEAD_BLOCK_SIZE bytes, and
+ * READ_AHEAD_DEPTH of them are requested ahead of the read position. When
+ * the reader is done with a block, it is requested again further in the
+ * file. The requests go through an io_uring when the kernel has it, and to a
+ * few threads calling pread() otherwise. read() only waits if the block it
+ * needs is not there yet.
+ *
+ * Seeking within the blocks that are requested is free. Seeking elsewhere
+ * waits for the requests in flight, then requests from the new position.
+ *
+ * The interface is the one of a file, so that it can be given to
+ * libsndfile's sf_open_virtual(). Reader thread only.
+ */
+class ReadAhead
+{
+  public:
+    enum Engine {
+      IoUring,
+      ThreadPool
+    };
+
+    /**
+     * @param use_io_uring false to always read with threads.
+     */
+    ReadAhead(bool use_io_uring = true);
+    ~ReadAhead();
+    /**
+     * @return 0 if |path| is opened and the first blocks are requested, -1
+     * otherwise.
+     */
+    int open(const char* path);
+    /**
+     * @brief Copy up to |count| bytes from the current position to |out|.
+     *
+     * @return The number of bytes copied, less than |count| at the end of the
+     * file or on error.
+     */
+    int64_t read(void* out, int64_t count);
+    /**
+     * @brief Move the position, like lseek().
+     *
+     * @return The new position, or -1.
+     */
+    int64_t seek(int64_t offset, int whence);
+    int64_t tell() const
+    {
+      return position_;
+    }
+    int64_t size() const
+    {
+      return size_;
+    }
+    Engine engine() const
+    {
+      return engine_;
+    }
+  protected:
+    ReadAhead(const ReadAhead&);
+    ReadAhead& operator=(const ReadAhead&);
+
+    enum BlockState {
+      Idle,
+      InFlight,
+      Ready
+    };
+    struct Block {
+      unsigned char* data;
+      int64_t offset;
+      /* The bytes read, or minus the errno. */
+      int64_t length;
+      BlockState state;
+    };
+
+    /**
+     * @brief Wait for the requests in flight, then request the blocks from
+     * |offset| on, rounded down to the alignment.
+     */
+    void restart(int64_t offset);
+    /**
+     * @brief Request |blocks_[index]| at |next_offset_|, and move
+     * |next_offset_| to the next block.
+     */
+    void request(size_t index);
+    void submit(size_t index);
+    /**
+     * @brief Return once |blocks_[index]| is not in flight anymore.
+     */
+    void wait(size_t index);
+    void wait_all();
+
+    bool setup_io_uring();
+    void teardown_io_uring();
+    void submit_io_uring(size_t index);
+    /**
+     * @brief Mark the completed requests Ready, waiting for one if |block|
+     * is true.
+     */
+    void reap_io_uring(bool block);
+
+    void start_threads();
+    void stop_threads();
+    void worker_loop();
+
+    int fd_;
+    int64_t size_;
+    int64_t position_;
+    /* Where the next block will be requested. */
+    int64_t next_offset_;
+    /* The blocks, by increasing offset from |head_| on, wrapping around. */
+    std::vector<Block> blocks_;
+    size_t head_;
+    Engine engine_;
+    bool use_io_uring_;
+
+    /* The io_uring, mapped. */
+    int ring_fd_;
+    void* sq_ring_;
+    size_t sq_ring_size_;
+    void* cq_ring_;
+    size_t cq_ring_size_;
+    void* sqes_;
+    size_t sqes_size_;
+    unsigned* sq_tail_;
+    unsigned* sq_mask_;
+    unsigned* sq_array_;
+    unsigned* cq_head_;
+    unsigned* cq_tail_;
+    unsigned* cq_mask_;
+    void* cqes_;
+    /* One iovec per block, for IORING_OP_READV. */
+    std::vector<struct iovec> iovecs_;
+
+    /* The thread pool. The states of the blocks are under |mutex_|. */
+    std::vector<std::thread> threads_;
+    std::mutex mutex_;
+    std::condition_variable requested_;
+    std::condition_variable completed_;
+    std::deque<size_t> queue_;
+    bool stopping_;
+};
+
+#endif
@@ -1,19 +1,34 @@
-#ifndef RINGBUFFER_HPP 
+#ifndef RINGBUFFER_HPP
 #define RINGBUFFER_HPP
 
 #include "vagg/vagg_macros.h"
 #include "types.hpp"
 
+#include <atomic>
+
 #define DEBUG_RINGBUFFER
 
 /**
  * @brief A ring buffer, with a fixed size.
+ *
+ * This is a single-producer/single-consumer queue : one thread may call
+ * push() or reserve_write()/commit_write(), another thread may call pop() or
+ * peek_read()/release_read(), without any lock. The producer owns
+ * |tail_|, the consumer owns |head_|. Each side publishes its index with a
+ * release store, and reads the other side's index with an acquire load, so
+ * that the content of a slot is visible before the index that covers it.
+ *
+ * Both indices live on their own cache line, and each side keeps a cached
+ * copy of the other side's index, so that the audio thread and the decoder
+ * thread do not bounce the same cache line back and forth on each call. The
+ * padding is a full line wide, so that this holds whatever the alignment of
+ * the object is.
  */
 template<typename T, size_t Slots>
 class RingBuffer {
   public:
     RingBuffer(size_t slots_size)
-      :head_(0),tail_(0),slots_size_(slots_size)
+      :head_(0),cached_tail_(0),tail_(0),cached_head_(0),slots_size_(slots_size)
     {
       for (size_t i = 0; i < Slots; i++) {
         data_[i] = new T[slots_size];
@@ -22,51 +37,129 @@ class RingBuffer {
 
     ~RingBuffer() {
       for (size_t i = 0; i < Slots; i++) {
-        delete data_[i];
+        delete [] data_[i];
       }
     }
     bool empty() const
     {
-      return head_ == tail_;
+      return head_.load(std::memory_order_acquire) ==
+             tail_.load(std::memory_order_acquire);
     }
 
     bool full() const
     {
-      return ((tail_ + 1) % Slots == head_);
+      return increment(tail_.load(std::memory_order_acquire)) ==
+             head_.load(std::memory_order_acquire);
     }
 
-    bool push(SamplesType* data, size_t length)
+    /**
+     * @brief Copy |length| items in the next free slot. Producer side only.
+     *
+     * @return false if the buffer is full or if |length| is not the slot size.
+     */
+    bool push(T* data, size_t length)
     {
       if (length != slots_size_) {
         VAGG_LOG(VAGG_LOG_FATAL, "Bad push size asked : %zu, slot size : %zu", length, slots_size_);
         return false;
       }
-      size_t next = increment(tail_);
-      if(next != head_) {
-        for (size_t i = 0; i < length; i++) {
-          data_[tail_][i] = data[i];
-        }
-        tail_ = next;
-        return true;
+      T* slot = reserve_write();
+      if (! slot) {
+        return false;
+      }
+      for (size_t i = 0; i < length; i++) {
+        slot[i] = data[i];
       }
-      return false;
+      commit_write();
+      return true;
     }
 
-    bool pop(SamplesType* data, size_t length)
+    /**
+     * @brief Copy the oldest slot in |data|. Consumer side only.
+     *
+     * @return false if the buffer is empty or if |length| is not the slot
+     * size.
+     */
+    bool pop(T* data, size_t length)
     {
       if (length != slots_size_) {
         VAGG_LOG(VAGG_LOG_FATAL, "Bad pop size");
+        return false;
       }
-      if(head_ == tail_) {
-         return false;
+      T* slot = peek_read();
+      if (! slot) {
+        return false;
       }
       for (size_t i = 0; i < length; i++) {
-        data[i] = data_[head_][i];
+        data[i] = slot[i];
       }
-      head_ = increment(head_);
+      release_read();
       return true;
     }
 
+    /**
+     * @brief Get the next free slot, to fill it in place. Producer side only.
+     *
+     * The slot is handed to the consumer by commit_write().
+     *
+     * @return A pointer to |slot_size()| items, or 0 if the buffer is full.
+     */
+    T* reserve_write()
+    {
+      size_t tail = tail_.load(std::memory_order_relaxed);
+      size_t next = increment(tail);
+      if (next == cached_head_) {
+        cached_head_ = head_.load(std::memory_order_acquire);
+        if (next == cached_head_) {
+          return 0;
+        }
+      }
+      return data_[tail];
+    }
+
+    /**
+     * @brief Publish the slot returned by the last reserve_write().
+     */
+    void commit_write()
+    {
+      tail_.store(increment(tail_.load(std::memory_order_relaxed)),
+                  std::memory_order_release);
+    }
+
+    /**
+     * @brief Get the oldest slot, to read it in place. Consumer side only.
+     *
+     * The slot stays owned by the consumer until release_read() is called.
+     *
+     * @return A pointer to |slot_size()| items, or 0 if the buffer is empty.
+     */
+    T* peek_read()
+    {
+      size_t head = head_.load(std::memory_order_relaxed);
+      if (head == cached_tail_) {
+        cached_tail_ = tail_.load(std::memory_order_acquire);
+        if (head == cached_tail_) {
+          return 0;
+        }
+      }
+      return data_[head];
+    }
+
+    /**
+     * @brief Give the slot returned by the last peek_read() back to the
+     * producer.
+     */
+    void release_read()
+    {
+      head_.store(increment(head_.load(std::memory_order_relaxed)),
+                  std::memory_order_release);
+    }
+
+    size_t slot_size() const
+    {
+      return slots_size_;
+    }
+
     void clear()
     {
       for (size_t i = 0; i < Slots; i++) {
@@ -76,22 +169,39 @@ class RingBuffer {
       }
     }
 
-    size_t available_read()
+    size_t available_read() const
     {
-      if (head_ <= tail_) {
-        return tail_ - head_;
+      size_t head = head_.load(std::memory_order_acquire);
+      size_t tail = tail_.load(std::memory_order_acquire);
+      if (head <= tail) {
+        return tail - head;
       }
-      return Slots - (head_ - tail_);
+      return Slots - (head - tail);
     }
 
   protected:
-    size_t increment(size_t index)
+    RingBuffer(const RingBuffer&);
+    RingBuffer& operator=(const RingBuffer&);
+
+    static size_t increment(size_t index)
     {
       return (index + 1) % Slots;
     }
 
-    volatile size_t head_;
-    volatile size_t tail_;
+    char pad_front_[CACHE_LINE_SIZE];
+
+    /* Consumer side : |head_| is written by the consumer, |cached_tail_| is
+     * the last value of |tail_| the consumer has seen. */
+    std::atomic<size_t> head_;
+    size_t cached_tail_;
+    char pad_consumer_[CACHE_LINE_SIZE];
+
+    /* Producer side : |tail_| is written by the producer, |cached_head_| is
+     * the last value of |head_| the producer has seen. */
+    std::atomic<size_t> tail_;
+    size_t cached_head_;
+    char pad_producer_[CACHE_LINE_SIZE];
+
     const size_t slots_size_;
     T* data_[Slots];
 };
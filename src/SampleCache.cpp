@@ -0,0 +1,116 @@
+#include "SampleCache.hpp"
+
+#include <sys/stat.h>
+
+SampleCache::SampleCache()
+  :budget_(SAMPLE_CACHE_BUDGET)
+  ,threshold_(SAMPLE_CACHE_THRESHOLD)
+  ,size_(0)
+{ }
+
+SampleCache& SampleCache::instance()
+{
+  static SampleCache cache;
+  return cache;
+}
+
+void SampleCache::set_budget(size_t bytes)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  budget_ = bytes;
+  evict();
+}
+
+void SampleCache::set_threshold(size_t bytes)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  threshold_ = bytes;
+}
+
+bool SampleCache::fits(uint64_t frames, int channels)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  uint64_t bytes = frames * channels * sizeof(SamplesType);
+  return bytes <= threshold_ && bytes <= budget_;
+}
+
+size_t SampleCache::size()
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  return size_;
+}
+
+bool SampleCache::stat_file(const char* path, int64_t* mtime_ns, int64_t* file_size)
+{
+  struct stat st;
+  if (stat(path, &st) == -1) {
+    return false;
+  }
+#ifdef __linux__
+  *mtime_ns = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+#else
+  *mtime_ns = static_cast<int64_t>(st.st_mtime) * 1000000000;
+#endif
+  *file_size = st.st_size;
+  return true;
+}
+
+SampleCache::Entry SampleCache::find(const char* path)
+{
+  int64_t mtime_ns;
+  int64_t file_size;
+  bool exists = stat_file(path, &mtime_ns, &file_size);
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::map<std::string, Items::iterator>::iterator it = index_.find(path);
+  if (it == index_.end()) {
+    return Entry();
+  }
+  Items::iterator item = it->second;
+  if (! exists || item->mtime_ns != mtime_ns || item->file_size != file_size) {
+    // The file changed or went away since it was decoded.
+    erase(it);
+    return Entry();
+  }
+  items_.splice(items_.begin(), items_, item);
+  return item->samples;
+}
+
+bool SampleCache::insert(const char* path, Entry samples, int64_t mtime_ns, int64_t file_size)
+{
+  size_t bytes = samples->samples.size() * sizeof(SamplesType);
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (bytes > threshold_ || bytes > budget_) {
+    return false;
+  }
+  std::map<std::string, Items::iterator>::iterator it = index_.find(path);
+  if (it != index_.end()) {
+    erase(it);
+  }
+  Item item;
+  item.path = path;
+  item.mtime_ns = mtime_ns;
+  item.file_size = file_size;
+  item.samples = samples;
+  item.bytes = bytes;
+  items_.push_front(item);
+  index_[item.path] = items_.begin();
+  size_ += bytes;
+  evict();
+  return true;
+}
+
+void SampleCache::erase(std::map<std::string, Items::iterator>::iterator it)
+{
+  size_ -= it->second->bytes;
+  items_.erase(it->second);
+  index_.erase(it);
+}
+
+void SampleCache::evict()
+{
+  while (size_ > budget_ && ! items_.empty()) {
+    erase(index_.find(items_.back().path));
+  }
+}
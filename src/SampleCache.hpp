@@ -0,0 +1,129 @@
+#ifndef SAMPLECACHE_HPP
+#define SAMPLECACHE_HPP
+
+#include "types.hpp"
+
+#include <stdint.h>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+/**
+ * @brief The default memory the decoded files can take, in bytes.
+ */
+#define SAMPLE_CACHE_BUDGET (64 * 1024 * 1024)
+/**
+ * @brief The default size above which a decoded file is not kept, in bytes.
+ */
+#define SAMPLE_CACHE_THRESHOLD (8 * 1024 * 1024)
+
+/**
+ * @brief A whole file, decoded to interleaved floats.
+ */
+struct CachedSamples {
+  std::vector<SamplesType> samples;
+  int channels;
+  int samplerate;
+  /* The libsndfile format of the file. */
+  int format;
+  uint64_t frames;
+  /* The largest absolute sample value. */
+  float peak;
+};
+
+/**
+ * @brief The decoded samples of the short files opened by the process, kept
+ * in memory so that opening them again does not touch the disk.
+ *
+ * Files are looked up by path, and an entry is only used if the file has
+ * the same size and modification time as when it was decoded. When the
+ * entries take more than the budget, the least recently used ones are
+ * dropped. An entry is immutable and reference counted : a file that is
+ * still playing keeps its samples after they are dropped from the cache.
+ *
+ * Any thread, but find() and insert() take a lock, and find() calls
+ * stat(), do not use them from the audio thread.
+ */
+class SampleCache
+{
+  public:
+    typedef std::shared_ptr<const CachedSamples> Entry;
+
+    /**
+     * @brief The cache of the process.
+     */
+    static SampleCache& instance();
+    /**
+     * @brief Change the memory the entries can take, and drop entries to fit.
+     */
+    void set_budget(size_t bytes);
+    /**
+     * @brief Files larger than this, once decoded, are not kept.
+     */
+    void set_threshold(size_t bytes);
+    /**
+     * @brief Whether a file of |frames| frames of |channels| channels would
+     * be kept.
+     */
+    bool fits(uint64_t frames, int channels);
+    /**
+     * @brief The decoded samples of |path|, or an empty Entry if they are not
+     * there, or if the file changed since.
+     */
+    Entry find(const char* path);
+    /**
+     * @brief Keep the decoded samples of |path|, that was just read.
+     *
+     * @param mtime_ns The modification time of the file, and |file_size| its
+     * size, from stat_file() before decoding : if the file changes while it
+     * is decoded, the entry is then already stale, rather than stale samples
+     * being kept as current.
+     *
+     * @return false if the samples are larger than the threshold, and were
+     * not kept.
+     */
+    bool insert(const char* path, Entry samples, int64_t mtime_ns, int64_t file_size);
+    /**
+     * @brief The memory taken by the entries, in bytes.
+     */
+    size_t size();
+    /**
+     * @brief The modification time and size of |path|, that entries are
+     * checked against.
+     *
+     * @return false if the file cannot be stat()ed.
+     */
+    static bool stat_file(const char* path, int64_t* mtime_ns, int64_t* file_size);
+  protected:
+    SampleCache();
+    SampleCache(const SampleCache&);
+    SampleCache& operator=(const SampleCache&);
+
+    struct Item {
+      std::string path;
+      int64_t mtime_ns;
+      int64_t file_size;
+      Entry samples;
+      size_t bytes;
+    };
+    typedef std::list<Item> Items;
+
+    /**
+     * @brief Drop the least recently used entries until they fit in the
+     * budget. The lock is held.
+     */
+    void evict();
+    void erase(std::map<std::string, Items::iterator>::iterator it);
+
+    std::mutex mutex_;
+    /* Most recently used first. */
+    Items items_;
+    std::map<std::string, Items::iterator> index_;
+    size_t budget_;
+    size_t threshold_;
+    size_t size_;
+};
+
+#endif
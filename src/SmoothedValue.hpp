@@ -0,0 +1,239 @@
+#ifndef SMOOTHEDVALUE_HPP
+#define SMOOTHEDVALUE_HPP
+
+#include "types.hpp"
+
+#include <math.h>
+#include <string.h>
+
+#ifdef __SSE__
+  #include <xmmintrin.h>
+#endif
+
+/**
+ * @brief How much of the distance to the target is left at the end of an
+ * exponential ramp.
+ */
+#define SMOOTHING_RESIDUAL 0.001
+
+/**
+ * @brief A parameter that moves smoothly to its new value instead of jumping,
+ * to avoid zipper noise.
+ *
+ * A new target is reached in a fixed number of samples, either along a
+ * straight line, or exponentially (the distance to the target is divided by
+ * 1000 along the ramp, then the value snaps to the target). This does not
+ * allocate, and is meant to be owned and used by the audio thread : effects
+ * can call next() once per frame, or apply() to use the value as a gain over
+ * a whole block.
+ */
+class SmoothedValue
+{
+  public:
+    enum Ramp {
+      Linear,
+      Exponential
+    };
+
+    SmoothedValue(float value = 0)
+      :current_(value),target_(value),ramp_(Linear),length_(0),remaining_(0)
+      ,step_(0),factor_(1)
+    { }
+
+    /**
+     * @brief Set the shape and the length of the ramps.
+     *
+     * @param samples The number of frames a ramp takes, 0 to jump to the new
+     * values at once.
+     */
+    void set_ramp(Ramp ramp, size_t samples)
+    {
+      ramp_ = ramp;
+      length_ = samples;
+      factor_ = samples ? pow(SMOOTHING_RESIDUAL, 1.0 / samples) : 1;
+      set_target(target_);
+    }
+
+    /**
+     * @brief Start moving towards |target|, from the current value.
+     */
+    void set_target(float target)
+    {
+      target_ = target;
+      if (length_ == 0 || current_ == target_) {
+        current_ = target_;
+        remaining_ = 0;
+        return;
+      }
+      remaining_ = length_;
+      step_ = (target_ - current_) / length_;
+    }
+
+    /**
+     * @brief Jump to |value| at once.
+     */
+    void reset(float value)
+    {
+      current_ = target_ = value;
+      remaining_ = 0;
+    }
+
+    float target() const
+    {
+      return target_;
+    }
+
+    float value() const
+    {
+      return current_;
+    }
+
+    bool smoothing() const
+    {
+      return remaining_ != 0;
+    }
+
+    /**
+     * @brief The value for this frame, then advance by one frame.
+     */
+    float next()
+    {
+      float value = current_;
+      if (remaining_) {
+        if (ramp_ == Linear) {
+          current_ += step_;
+        } else {
+          current_ = target_ + (current_ - target_) * factor_;
+        }
+        if (--remaining_ == 0) {
+          current_ = target_;
+        }
+      }
+      return value;
+    }
+
+    /**
+     * @brief Multiply |frames| interleaved frames by the value, and advance by
+     * as many frames.
+     *
+     * @param in The samples to read.
+     * @param out Where to write the result, which can be |in|.
+     */
+    void apply(const SamplesType* in, SamplesType* out, size_t frames, size_t channels)
+    {
+      if (remaining_) {
+        size_t ramp = frames < remaining_ ? frames : remaining_;
+        if (ramp_ == Linear) {
+          float offset = gain_ramp(in, out, ramp, channels, current_, 0, 1, step_);
+          current_ += offset;
+        } else {
+          float offset = gain_ramp(in, out, ramp, channels, target_, current_ - target_, factor_, 0);
+          current_ = target_ + offset;
+        }
+        remaining_ -= ramp;
+        if (remaining_ == 0) {
+          current_ = target_;
+        }
+        in += ramp * channels;
+        out += ramp * channels;
+        frames -= ramp;
+      }
+      if (frames) {
+        gain(in, out, frames * channels, current_);
+      }
+    }
+
+    /**
+     * @brief Multiply |count| samples by |value|.
+     */
+    static void gain(const SamplesType* in, SamplesType* out, size_t count, float value)
+    {
+      if (value == 1.0f) {
+        if (in != out) {
+          memcpy(out, in, count * sizeof(SamplesType));
+        }
+        return;
+      }
+      size_t i = 0;
+#ifdef __SSE__
+      __m128 g = _mm_set1_ps(value);
+      for (; i + 4 <= count; i += 4) {
+        _mm_storeu_ps(out + i, _mm_mul_ps(_mm_loadu_ps(in + i), g));
+      }
+#endif
+      for (; i < count; i++) {
+        out[i] = in[i] * value;
+      }
+    }
+
+    /**
+     * @brief Multiply interleaved frames by a gain that changes on each frame.
+     *
+     * The gain for frame i is |base| + a(i), where a(0) = |offset| and
+     * a(i + 1) = a(i) * |factor| + |increment|. This covers a linear ramp
+     * (factor = 1) and an exponential approach to |base| (increment = 0).
+     *
+     * @return a(frames), to carry on from there.
+     */
+    static float gain_ramp(const SamplesType* in, SamplesType* out,
+                           size_t frames, size_t channels,
+                           float base, float offset, float factor, float increment)
+    {
+      size_t i = 0;
+#ifdef __SSE__
+      // When a vector holds a whole number of frames, all the lanes of a frame
+      // get the same gain, and each step moves all the lanes by the same
+      // number of frames.
+      if (channels == 1 || channels == 2 || channels == 4) {
+        size_t per_vector = 4 / channels;
+        float lanes[4];
+        float a = offset;
+        for (size_t f = 0; f < per_vector; f++) {
+          for (size_t c = 0; c < channels; c++) {
+            lanes[f * channels + c] = a;
+          }
+          a = a * factor + increment;
+        }
+        // Moving by |per_vector| frames at once.
+        float vector_factor = 1;
+        float vector_increment = 0;
+        for (size_t f = 0; f < per_vector; f++) {
+          vector_increment = vector_increment * factor + increment;
+          vector_factor *= factor;
+        }
+        __m128 va = _mm_loadu_ps(lanes);
+        __m128 vbase = _mm_set1_ps(base);
+        __m128 vfactor = _mm_set1_ps(vector_factor);
+        __m128 vincrement = _mm_set1_ps(vector_increment);
+        size_t count = frames * channels;
+        for (; i + 4 <= count; i += 4) {
+          __m128 g = _mm_add_ps(vbase, va);
+          _mm_storeu_ps(out + i, _mm_mul_ps(_mm_loadu_ps(in + i), g));
+          va = _mm_add_ps(_mm_mul_ps(va, vfactor), vincrement);
+        }
+        _mm_storeu_ps(lanes, va);
+        offset = lanes[0];
+        i /= channels;
+      }
+#endif
+      for (; i < frames; i++) {
+        float g = base + offset;
+        for (size_t c = 0; c < channels; c++) {
+          out[i * channels + c] = in[i * channels + c] * g;
+        }
+        offset = offset * factor + increment;
+      }
+      return offset;
+    }
+
+  protected:
+    float current_;
+    float target_;
+    Ramp ramp_;
+    size_t length_;
+    size_t remaining_;
+    float step_;
+    float factor_;
+};
+
+#endif
@@ -0,0 +1,91 @@
+#include "SpectrumAnalyzer.hpp"
+#include "vagg/vagg_macros.h"
+
+#include <math.h>
+#include <string.h>
+
+SpectrumAnalyzer::SpectrumAnalyzer(size_t size, size_t hop)
+  :fft_(size <= SPECTRUM_MAX_SIZE ? size : SPECTRUM_MAX_SIZE)
+  ,size_(fft_.size()),hop_(hop ? hop : 1),input_index_(0),since_hop_(0)
+{
+  if (size > SPECTRUM_MAX_SIZE) {
+    VAGG_LOG(VAGG_LOG_WARNING, "Spectrum size %zu too large, using %d", size, SPECTRUM_MAX_SIZE);
+  }
+  input_ = new float[size_];
+  window_ = new float[size_];
+  frame_ = new float[size_];
+  spectrum_ = new float[size_ + 2];
+  memset(input_, 0, size_ * sizeof(float));
+
+  float sum = 0;
+  for (size_t i = 0; i < size_; i++) {
+    window_[i] = 0.5 - 0.5 * cos(2 * M_PI * i / size_);
+    sum += window_[i];
+  }
+  // A full scale sine has a peak of sum / 2 in its bin.
+  scale_ = 2 / sum;
+}
+
+SpectrumAnalyzer::~SpectrumAnalyzer()
+{
+  delete [] input_;
+  delete [] window_;
+  delete [] frame_;
+  delete [] spectrum_;
+}
+
+bool SpectrumAnalyzer::read(SpectrumValues* values)
+{
+  if (! values_.update()) {
+    return false;
+  }
+  const SpectrumValues& latest = values_.read_buffer();
+  values->bins = latest.bins;
+  memcpy(values->magnitude, latest.magnitude, latest.bins * sizeof(float));
+  return true;
+}
+
+void SpectrumAnalyzer::process(SamplesType* samples, size_t length, size_t channels)
+{
+  float gain = 1.0f / channels;
+  for (size_t i = 0; i < length; i++) {
+    float mix = 0;
+    for (size_t c = 0; c < channels; c++) {
+      mix += samples[c];
+    }
+    samples += channels;
+    input_[input_index_] = mix * gain;
+    input_index_ = (input_index_ + 1) & (size_ - 1);
+    if (++since_hop_ == hop_) {
+      since_hop_ = 0;
+      analyze();
+    }
+  }
+}
+
+void SpectrumAnalyzer::analyze()
+{
+  // The oldest frame is at |input_index_|.
+  size_t first = size_ - input_index_;
+  for (size_t i = 0; i < first; i++) {
+    frame_[i] = input_[input_index_ + i] * window_[i];
+  }
+  for (size_t i = first; i < size_; i++) {
+    frame_[i] = input_[i - first] * window_[i];
+  }
+  fft_.forward(frame_, spectrum_);
+
+  SpectrumValues& values = values_.write_buffer();
+  values.bins = size_ / 2 + 1;
+  for (size_t k = 0; k < values.bins; k++) {
+    float re = spectrum_[2 * k];
+    float im = spectrum_[2 * k + 1];
+    float power = (re * re + im * im) * scale_ * scale_;
+    // 10 log10 of the power, so that there is no square root.
+    values.magnitude[k] = power > 0 ? 10 * log10f(power) : SPECTRUM_FLOOR;
+    if (values.magnitude[k] < SPECTRUM_FLOOR) {
+      values.magnitude[k] = SPECTRUM_FLOOR;
+    }
+  }
+  values_.publish();
+}
@@ -0,0 +1,77 @@
+#ifndef SPECTRUMANALYZER_HPP
+#define SPECTRUMANALYZER_HPP
+
+#include "types.hpp"
+#include "Effect.hpp"
+#include "FFT.hpp"
+#include "TripleBuffer.hpp"
+
+/**
+ * @brief The largest FFT size a SpectrumAnalyzer can use.
+ */
+#define SPECTRUM_MAX_SIZE 4096
+#define SPECTRUM_MAX_BINS (SPECTRUM_MAX_SIZE / 2 + 1)
+/**
+ * @brief The level given to the bins that have no energy, in dB.
+ */
+#define SPECTRUM_FLOOR -120
+
+/**
+ * @brief The magnitude of each bin, from 0 Hz to half the samplerate, in dB
+ * relative to a full scale sine.
+ */
+struct SpectrumValues {
+  size_t bins;
+  float magnitude[SPECTRUM_MAX_BINS];
+};
+
+/**
+ * @brief Compute the spectrum of the signal, and publish it for another
+ * thread to display. The samples are left untouched.
+ *
+ * The channels are mixed down, and every |hop| frames, the last |size| frames
+ * are windowed (Hann) and transformed. Everything is allocated by the
+ * constructor, and the spectra are published through a TripleBuffer.
+ */
+class SpectrumAnalyzer : public Effect
+{
+  public:
+    /**
+     * @param size The FFT size, a power of two up to SPECTRUM_MAX_SIZE.
+     * @param hop The number of frames between two spectra.
+     */
+    SpectrumAnalyzer(size_t size = 2048, size_t hop = 512);
+    ~SpectrumAnalyzer();
+    virtual void process(SamplesType* samples, size_t length, size_t channels);
+    /**
+     * @brief Get the latest spectrum. Reader thread only.
+     *
+     * @return false if nothing was published since the last call, |values|
+     * is then left untouched.
+     */
+    bool read(SpectrumValues* values);
+  protected:
+    SpectrumAnalyzer(const SpectrumAnalyzer&);
+    SpectrumAnalyzer& operator=(const SpectrumAnalyzer&);
+
+    /**
+     * @brief Transform the last |size_| frames, and publish.
+     */
+    void analyze();
+
+    FFT fft_;
+    size_t size_;
+    size_t hop_;
+    /* The last |size_| mixed down frames, circular. */
+    float* input_;
+    size_t input_index_;
+    size_t since_hop_;
+    float* window_;
+    /* Turns the magnitudes in amplitudes of a sine. */
+    float scale_;
+    float* frame_;
+    float* spectrum_;
+    TripleBuffer<SpectrumValues> values_;
+};
+
+#endif
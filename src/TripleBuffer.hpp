@@ -0,0 +1,99 @@
+#ifndef TRIPLEBUFFER_HPP
+#define TRIPLEBUFFER_HPP
+
+#include "types.hpp"
+
+#include <atomic>
+
+/**
+ * @brief Hand the latest value of something over from one thread to another,
+ * without locks and without ever blocking either side.
+ *
+ * There are three copies of the value : one being written, one being read,
+ * and one in the middle, that holds the last published value. publish() swaps
+ * the written copy with the middle one, update() swaps the middle copy with
+ * the read one if it is newer. The writer can publish as often as it wants,
+ * the reader only ever sees the latest value, and values published in
+ * between are dropped.
+ *
+ * One thread writes, one thread reads. T has to be default constructible and
+ * assignable.
+ */
+template<typename T>
+class TripleBuffer {
+  public:
+    TripleBuffer()
+      :middle_(1),write_(0),read_(2)
+    {
+      for (size_t i = 0; i < 3; i++) {
+        buffers_[i] = T();
+      }
+    }
+
+    /**
+     * @brief The copy to fill before publish(). Writer side only. It holds
+     * whatever was there before, not necessarily the last published value.
+     */
+    T& write_buffer()
+    {
+      return buffers_[write_];
+    }
+
+    /**
+     * @brief Make the write buffer the latest value. Writer side only.
+     *
+     * @return false if the previous value was dropped without being read.
+     * The write buffer is then that value.
+     */
+    bool publish()
+    {
+      unsigned previous = middle_.exchange(write_ | DIRTY, std::memory_order_acq_rel);
+      write_ = previous & INDEX;
+      return ! (previous & DIRTY);
+    }
+
+    /**
+     * @brief Take the latest value, if there is a new one. Reader side only.
+     *
+     * @return true if read_buffer() changed.
+     */
+    bool update()
+    {
+      if (! (middle_.load(std::memory_order_relaxed) & DIRTY)) {
+        return false;
+      }
+      read_ = middle_.exchange(read_, std::memory_order_acq_rel) & INDEX;
+      return true;
+    }
+
+    /**
+     * @brief The value taken by the last update(). Reader side only.
+     */
+    const T& read_buffer() const
+    {
+      return buffers_[read_];
+    }
+
+  protected:
+    TripleBuffer(const TripleBuffer&);
+    TripleBuffer& operator=(const TripleBuffer&);
+
+    /* The low bits of |middle_| are the index of the middle copy, DIRTY is
+     * set when it has not been read yet. */
+    static const unsigned INDEX = 3;
+    static const unsigned DIRTY = 4;
+
+    char pad_front_[CACHE_LINE_SIZE];
+    std::atomic<unsigned> middle_;
+    char pad_middle_[CACHE_LINE_SIZE];
+    /* Writer side. */
+    unsigned write_;
+    char pad_writer_[CACHE_LINE_SIZE];
+    /* Reader side. */
+    unsigned read_;
+    char pad_reader_[CACHE_LINE_SIZE];
+
+    T buffers_[3];
+};
+
+#endif
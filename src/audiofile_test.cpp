@@ -0,0 +1,159 @@
+#include "AudioFile.hpp"
+
+#define VAGG_TEST
+
+#include "vagg/vagg.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+
+#define TEST_SAMPLERATE 1000
+/* More than two chunks of read_planar(), and odd. */
+#define TEST_FRAMES (2 * AUDIOFILE_PLANAR_CHUNK + 501)
+
+static void put16(FILE* f, uint16_t v)
+{
+  fputc(v & 0xff, f);
+  fputc(v >> 8, f);
+}
+
+static void put32(FILE* f, uint32_t v)
+{
+  put16(f, v & 0xffff);
+  put16(f, v >> 16);
+}
+
+/**
+ * @brief Write |samples| as a 32 bits float WAV file of |channels| channels,
+ * and return its path, or an empty string.
+ */
+static std::string write_wav(const std::vector<float>& samples, int channels)
+{
+  char path[] = "/tmp/audiofile_test_XXXXXX";
+  int fd = mkstemp(path);
+  if (fd == -1) {
+    return "";
+  }
+  FILE* f = fdopen(fd, "wb");
+  uint32_t bytes = samples.size() * sizeof(float);
+  fwrite("RIFF", 1, 4, f);
+  put32(f, 36 + bytes);
+  fwrite("WAVEfmt ", 1, 8, f);
+  put32(f, 16);
+  put16(f, 3);
+  put16(f, channels);
+  put32(f, TEST_SAMPLERATE);
+  put32(f, TEST_SAMPLERATE * channels * sizeof(float));
+  put16(f, channels * sizeof(float));
+  put16(f, 32);
+  fwrite("data", 1, 4, f);
+  put32(f, bytes);
+  fwrite(&samples[0], sizeof(float), samples.size(), f);
+  fclose(f);
+  return path;
+}
+
+/**
+ * @brief Read |planar| with read_planar() and |interleaved| with
+ * read_frames() to their ends, by blocks of odd sizes, one of them longer
+ * than a chunk, and split the frames of |interleaved| one sample at a time.
+ *
+ * @return Whether both give the same channels, and |left| frames.
+ */
+static bool same_reads(AudioFile& planar, AudioFile& interleaved, size_t left)
+{
+  const size_t lengths[] = {7, 1, AUDIOFILE_PLANAR_CHUNK + 300, 13, 5};
+  const size_t longest = AUDIOFILE_PLANAR_CHUNK + 300;
+  size_t channels = planar.channels();
+  if (channels == 0 || interleaved.channels() != static_cast<int>(channels)) {
+    return false;
+  }
+  std::vector<std::vector<float> > split(channels, std::vector<float>(longest));
+  std::vector<float*> pointers(channels);
+  for (size_t c = 0; c < channels; c++) {
+    pointers[c] = &split[c][0];
+  }
+  std::vector<float> frames(longest * channels);
+  bool same = true;
+  size_t done = 0;
+  for (size_t i = 0; ; i++) {
+    size_t length = lengths[i % 5];
+    size_t read = planar.read_planar(&pointers[0], length);
+    same = same && read == interleaved.read_frames(&frames[0], length);
+    if (! same) {
+      break;
+    }
+    for (size_t n = 0; n < read; n++) {
+      for (size_t c = 0; c < channels; c++) {
+        same = same && split[c][n] == frames[n * channels + c];
+      }
+    }
+    done += read;
+    if (read != length) {
+      break;
+    }
+  }
+  return same && done == left;
+}
+
+/**
+ * @brief read_planar() splits the frames read_frames() gives, from the
+ * SampleCache, from a mapping and from libsndfile, for 1 to 3 channels.
+ */
+void planar_test()
+{
+  srand(1);
+  bool opened = true;
+  bool mapped_same = true;
+  bool decoded_same = true;
+  bool cached_same = true;
+  for (int channels = 1; channels <= 3; channels++) {
+    std::vector<float> samples(TEST_FRAMES * channels);
+    for (size_t i = 0; i < samples.size(); i++) {
+      samples[i] = rand() / static_cast<float>(RAND_MAX) * 2 - 1;
+    }
+    std::string path = write_wav(samples, channels);
+    opened = opened && ! path.empty();
+
+    // The file is not decoded whole, until the last pair opens it.
+    SampleCache::instance().set_threshold(0);
+    const AudioFile::Mode modes[] = {AudioFile::ReadMapped, AudioFile::Read, AudioFile::Read};
+    bool* same[] = {&mapped_same, &decoded_same, &cached_same};
+    for (size_t m = 0; m < 3; m++) {
+      if (m == 2) {
+        SampleCache::instance().set_threshold(SAMPLE_CACHE_THRESHOLD);
+      }
+      AudioFile planar(path.c_str());
+      AudioFile interleaved(path.c_str());
+      if (planar.open(modes[m]) != 0 || interleaved.open(modes[m]) != 0) {
+        opened = false;
+        continue;
+      }
+      opened = opened && (m == 2) == (planar.peak() >= 0);
+      *same[m] = *same[m] && same_reads(planar, interleaved, TEST_FRAMES);
+      planar.seek(0.5);
+      interleaved.seek(0.5);
+      *same[m] = *same[m] && same_reads(planar, interleaved, TEST_FRAMES - TEST_SAMPLERATE / 2);
+    }
+    unlink(path.c_str());
+  }
+  SampleCache::instance().set_budget(0);
+  SampleCache::instance().set_budget(SAMPLE_CACHE_BUDGET);
+  vagg_ok(opened, "Open every file mapped, with libsndfile, and from the SampleCache.");
+  vagg_ok(mapped_same, "read_planar() splits the frames of a mapped file.");
+  vagg_ok(decoded_same, "read_planar() splits the frames libsndfile decodes.");
+  vagg_ok(cached_same, "read_planar() splits the frames of the SampleCache.");
+}
+
+int main()
+{
+  vagg_start(vagg_display_success);
+
+  planar_test();
+
+  vagg_end();
+  return 0;
+}
@@ -0,0 +1,154 @@
+#include "ConvolutionReverb.hpp"
+
+#define VAGG_TEST
+
+#include "vagg/vagg.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+
+#define TEST_BLOCK 64
+#define TEST_RESPONSE_FRAMES 1000
+#define TEST_INPUT_FRAMES 5000
+
+static float noise()
+{
+  return rand() / static_cast<float>(RAND_MAX) - 0.5f;
+}
+
+static void put16(FILE* f, uint16_t v)
+{
+  fputc(v & 0xff, f);
+  fputc(v >> 8, f);
+}
+
+static void put32(FILE* f, uint32_t v)
+{
+  put16(f, v & 0xffff);
+  put16(f, v >> 16);
+}
+
+/**
+ * @brief Write |samples| as a mono 32 bits float WAV file, and return its
+ * path, or an empty string.
+ */
+static std::string write_response(const std::vector<float>& samples)
+{
+  char path[] = "/tmp/convolution_test_XXXXXX";
+  int fd = mkstemp(path);
+  if (fd == -1) {
+    return "";
+  }
+  FILE* f = fdopen(fd, "wb");
+  uint32_t bytes = samples.size() * sizeof(float);
+  fwrite("RIFF", 1, 4, f);
+  put32(f, 36 + bytes);
+  fwrite("WAVEfmt ", 1, 8, f);
+  put32(f, 16);
+  put16(f, 3);
+  put16(f, 1);
+  put32(f, 44100);
+  put32(f, 44100 * sizeof(float));
+  put16(f, sizeof(float));
+  put16(f, 32);
+  fwrite("data", 1, 4, f);
+  put32(f, bytes);
+  fwrite(&samples[0], sizeof(float), samples.size(), f);
+  fclose(f);
+  return path;
+}
+
+/**
+ * @brief Compare with a direct convolution, processing by blocks of sizes
+ * that are not multiples of the partition size.
+ */
+void direct_convolution_test()
+{
+  srand(1);
+  std::vector<float> response(TEST_RESPONSE_FRAMES);
+  for (size_t i = 0; i < response.size(); i++) {
+    response[i] = noise();
+  }
+  std::string path = write_response(response);
+  vagg_ok(! path.empty(), "Write the impulse response.");
+
+  ConvolutionReverb reverb(TEST_BLOCK);
+  vagg_ok(reverb.load(path.c_str(), 2) == 0, "Load the impulse response.");
+  unlink(path.c_str());
+  reverb.set_wet(1);
+
+  // The right channel is the left one inverted.
+  std::vector<float> input(TEST_INPUT_FRAMES);
+  std::vector<float> samples(2 * TEST_INPUT_FRAMES);
+  for (size_t i = 0; i < input.size(); i++) {
+    input[i] = noise();
+    samples[2 * i] = input[i];
+    samples[2 * i + 1] = -input[i];
+  }
+  const size_t lengths[] = {1, 37, 100, 3, 512};
+  size_t done = 0;
+  for (size_t i = 0; done < input.size(); i++) {
+    size_t length = lengths[i % 5];
+    if (length > input.size() - done) {
+      length = input.size() - done;
+    }
+    reverb.process(&samples[2 * done], length, 2);
+    done += length;
+  }
+
+  // The output is late by one block.
+  double error = 0;
+  double silence = 0;
+  for (size_t n = 0; n < input.size(); n++) {
+    if (n < TEST_BLOCK) {
+      silence = fmax(silence, fabs(samples[2 * n]));
+      continue;
+    }
+    double expected = 0;
+    for (size_t k = 0; k < response.size() && k <= n - TEST_BLOCK; k++) {
+      expected += response[k] * input[n - TEST_BLOCK - k];
+    }
+    error = fmax(error, fabs(expected - samples[2 * n]));
+    error = fmax(error, fabs(-expected - samples[2 * n + 1]));
+  }
+  vagg_ok(silence == 0, "Nothing comes out during the first block.");
+  vagg_ok(error < 1e-4, "Same output as a direct convolution.");
+}
+
+void dry_test()
+{
+  std::vector<float> response(10, 0.5f);
+  std::string path = write_response(response);
+  ConvolutionReverb reverb(TEST_BLOCK);
+  vagg_ok(reverb.load(path.c_str(), 1) == 0, "Load the impulse response.");
+  unlink(path.c_str());
+
+  std::vector<float> samples(300);
+  for (size_t i = 0; i < samples.size(); i++) {
+    samples[i] = noise();
+  }
+  std::vector<float> original(samples);
+  reverb.process(&samples[0], samples.size() / 2, 2);
+  vagg_ok(samples == original, "Another number of channels is left untouched.");
+
+  reverb.set_wet(0);
+  reverb.process(&samples[0], samples.size(), 1);
+  vagg_ok(samples == original, "Without wet signal, the input comes out.");
+
+  vagg_ok(reverb.load("/nonexistent.wav", 1) == -1, "Loading a missing file fails.");
+}
+
+int main()
+{
+  vagg_start(vagg_display_success);
+
+  direct_convolution_test();
+  dry_test();
+
+  vagg_end();
+  return 0;
+}
@@ -0,0 +1,157 @@
+#include "Delay.hpp"
+
+#define VAGG_TEST
+
+#include "vagg/vagg.h"
+
+#include <math.h>
+#include <vector>
+
+#define TEST_SAMPLERATE 1000
+#define TEST_FRAMES 100
+
+/**
+ * @brief Let the delay time reach its target, on silence.
+ */
+static void settle(Delay& delay)
+{
+  std::vector<float> silence(2 * TEST_SAMPLERATE * DELAY_RAMP_MS / 1000 + 2);
+  delay.process(&silence[0], silence.size() / 2, 2);
+}
+
+/**
+ * @brief Send an impulse, +1 on the left and -1 on the right, through
+ * |delay| in blocks of odd sizes, and return the left channel.
+ */
+static std::vector<float> impulse_response(Delay& delay)
+{
+  std::vector<float> samples(2 * TEST_FRAMES);
+  samples[0] = 1;
+  samples[1] = -1;
+  const size_t lengths[] = {7, 1, 33, 13, 5};
+  size_t done = 0;
+  for (size_t i = 0; done < TEST_FRAMES; i++) {
+    size_t length = lengths[i % 5];
+    if (length > TEST_FRAMES - done) {
+      length = TEST_FRAMES - done;
+    }
+    delay.process(&samples[2 * done], length, 2);
+    done += length;
+  }
+  std::vector<float> left(TEST_FRAMES);
+  bool mirrored = true;
+  for (size_t i = 0; i < TEST_FRAMES; i++) {
+    left[i] = samples[2 * i];
+    mirrored = mirrored && samples[2 * i + 1] == -samples[2 * i];
+  }
+  vagg_ok(mirrored, "The channels are delayed independently.");
+  return left;
+}
+
+/**
+ * @brief Whether |response| is |value| at |frame| and zero elsewhere, but
+ * at |other| where it is |other_value|.
+ */
+static bool only(const std::vector<float>& response, size_t frame, float value,
+                 size_t other = TEST_FRAMES, float other_value = 0)
+{
+  for (size_t i = 0; i < response.size(); i++) {
+    float expected = i == frame ? value : (i == other ? other_value : 0);
+    if (fabsf(response[i] - expected) > 1e-5) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void whole_delay_test()
+{
+  Delay delay(TEST_SAMPLERATE, 2, 0.1);
+  delay.set_wet(1);
+  delay.set_delay(0.010);
+  settle(delay);
+  vagg_ok(only(impulse_response(delay), 10, 1),
+          "The impulse comes out 10 frames later, across blocks.");
+
+  delay.set_delay(0.037);
+  settle(delay);
+  vagg_ok(only(impulse_response(delay), 37, 1),
+          "The impulse comes out 37 frames later after a change.");
+}
+
+void fractional_delay_test()
+{
+  Delay delay(TEST_SAMPLERATE, 2, 0.1);
+  delay.set_wet(1);
+  delay.set_delay(0.01025);
+  settle(delay);
+  vagg_ok(only(impulse_response(delay), 10, 0.75f, 11, 0.25f),
+          "A delay of 10.25 frames is split between frames 10 and 11.");
+
+  delay.set_delay(0.0215);
+  settle(delay);
+  vagg_ok(only(impulse_response(delay), 21, 0.5f, 22, 0.5f),
+          "A delay of 21.5 frames is split evenly between frames 21 and 22.");
+}
+
+void feedback_test()
+{
+  Delay delay(TEST_SAMPLERATE, 2, 0.1);
+  delay.set_wet(1);
+  delay.set_feedback(0.5f);
+  delay.set_delay(0.030);
+  settle(delay);
+  std::vector<float> response = impulse_response(delay);
+  bool repeats = fabsf(response[30] - 1) < 1e-6 && fabsf(response[60] - 0.5f) < 1e-6 &&
+                 fabsf(response[90] - 0.25f) < 1e-6;
+  response[30] = response[60] = response[90] = 0;
+  vagg_ok(repeats && only(response, TEST_FRAMES, 0),
+          "The feedback repeats the impulse, halved each time.");
+
+  Delay endless(TEST_SAMPLERATE, 2, 0.1);
+  endless.set_wet(1);
+  endless.set_feedback(2);
+  endless.set_delay(0.030);
+  settle(endless);
+  response = impulse_response(endless);
+  vagg_ok(fabsf(response[60] - DELAY_MAX_FEEDBACK) < 1e-6 &&
+          fabsf(response[90] - DELAY_MAX_FEEDBACK * DELAY_MAX_FEEDBACK) < 1e-6,
+          "The feedback is clamped below 1.");
+
+  Delay negative(TEST_SAMPLERATE, 2, 0.1);
+  negative.set_wet(1);
+  negative.set_feedback(-0.5f);
+  negative.set_delay(0.030);
+  settle(negative);
+  vagg_ok(only(impulse_response(negative), 30, 1), "A negative feedback is clamped to 0.");
+}
+
+void dry_test()
+{
+  Delay delay(TEST_SAMPLERATE, 2, 0.1);
+  delay.set_wet(0);
+  delay.set_delay(0.005);
+  std::vector<float> samples(2 * TEST_FRAMES);
+  for (size_t i = 0; i < samples.size(); i++) {
+    samples[i] = sinf(i);
+  }
+  std::vector<float> original(samples);
+  delay.process(&samples[0], TEST_FRAMES, 2);
+  vagg_ok(samples == original, "Without wet signal, the input comes out.");
+  delay.set_wet(1);
+  delay.process(&samples[0], TEST_FRAMES / 2, 4);
+  vagg_ok(samples == original, "Another number of channels is left untouched.");
+}
+
+int main()
+{
+  vagg_start(vagg_display_success);
+
+  whole_delay_test();
+  fractional_delay_test();
+  feedback_test();
+  dry_test();
+
+  vagg_end();
+  return 0;
+}
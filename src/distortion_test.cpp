@@ -0,0 +1,181 @@
+#include "Distortion.hpp"
+#include "FastMath.hpp"
+#include "Oversampler.hpp"
+
+#define VAGG_TEST
+
+#include "vagg/vagg.h"
+
+#include <math.h>
+#include <vector>
+
+#define TEST_FRAMES 8192
+
+/**
+ * @brief The errors given in the comments of FastMath.hpp.
+ */
+void fast_math_test()
+{
+  double tanh_error = 0;
+  double tanh_error_below_3 = 0;
+  for (float x = -8; x <= 8; x += 1.0f / 4096) {
+    double error = fabs(fast_tanh(x) - tanh(x));
+    tanh_error = fmax(tanh_error, error);
+    if (fabsf(x) < 3) {
+      tanh_error_below_3 = fmax(tanh_error_below_3, error);
+    }
+  }
+  vagg_ok(tanh_error <= 1e-4, "fast_tanh() is within 1e-4 of tanh().");
+  vagg_ok(tanh_error_below_3 <= 1.1e-6, "fast_tanh() is within 1.1e-6 of tanh() below 3.");
+
+  double atan_error = 0;
+  for (float x = -64; x <= 64; x += 1.0f / 1024) {
+    atan_error = fmax(atan_error, fabs(fast_atan(x) - atan(x)));
+  }
+  vagg_ok(atan_error <= 1.2e-5, "fast_atan() is within 1.2e-5 of atan().");
+
+#ifdef __SSE2__
+  bool same = true;
+  for (float x = -64; x <= 64; x += 1.0f / 256) {
+    float vector[4];
+    _mm_storeu_ps(vector, fast_tanh_ps(_mm_set1_ps(x)));
+    same = same && vector[0] == fast_tanh(x);
+    _mm_storeu_ps(vector, fast_atan_ps(_mm_set1_ps(x)));
+    same = same && vector[0] == fast_atan(x);
+    _mm_storeu_ps(vector, floor_ps(_mm_set1_ps(x)));
+    same = same && vector[0] == floorf(x);
+  }
+  vagg_ok(same, "The SSE versions give the same results as the scalar ones.");
+#endif
+}
+
+/**
+ * @brief Send |frames| of |in| up and down through |oversampler|, in blocks
+ * of odd sizes, to |out|.
+ */
+static void round_trip(Oversampler& oversampler, const std::vector<float>& in,
+                       std::vector<float>& out)
+{
+  const size_t lengths[] = {1, 255, 37, 256, 100};
+  size_t done = 0;
+  for (size_t i = 0; done < in.size(); i++) {
+    size_t length = lengths[i % 5];
+    if (length > in.size() - done) {
+      length = in.size() - done;
+    }
+    oversampler.up(&in[done], length, 0);
+    oversampler.down(&out[done], length, 0);
+    done += length;
+  }
+}
+
+/**
+ * @brief The gain of the round trip at |frequency|, a fraction of the
+ * samplerate, in dB.
+ */
+static double gain_at(size_t factor, double frequency)
+{
+  Oversampler oversampler(1, factor, 256);
+  std::vector<float> in(TEST_FRAMES);
+  std::vector<float> out(TEST_FRAMES);
+  for (size_t i = 0; i < in.size(); i++) {
+    in[i] = sin(2 * M_PI * frequency * i);
+  }
+  round_trip(oversampler, in, out);
+  double in_squares = 0;
+  double out_squares = 0;
+  for (size_t i = TEST_FRAMES / 2; i < TEST_FRAMES; i++) {
+    in_squares += in[i] * in[i];
+    out_squares += out[i] * out[i];
+  }
+  return 10 * log10(out_squares / in_squares);
+}
+
+void oversampler_test()
+{
+  for (size_t factor = 2; factor <= 8; factor *= 2) {
+    double ripple = 0;
+    for (double frequency = 0.01; frequency <= 0.4; frequency += 0.01) {
+      ripple = fmax(ripple, fabs(gain_at(factor, frequency)));
+    }
+    vagg_ok(ripple < 0.03, "The round trip is flat within 0.03 dB up to 0.4 times the samplerate.");
+
+    // A few tones well inside the band, so that the delayed input can be
+    // computed at fractional latencies.
+    Oversampler oversampler(1, factor, 256);
+    const double frequencies[] = {0.013, 0.057, 0.11, 0.2};
+    std::vector<float> in(TEST_FRAMES);
+    std::vector<float> out(TEST_FRAMES);
+    for (size_t i = 0; i < in.size(); i++) {
+      for (size_t f = 0; f < 4; f++) {
+        in[i] += 0.25 * sin(2 * M_PI * frequencies[f] * i);
+      }
+    }
+    round_trip(oversampler, in, out);
+    double latency = oversampler.latency();
+    double error = 0;
+    for (size_t i = TEST_FRAMES / 2; i < TEST_FRAMES; i++) {
+      double expected = 0;
+      for (size_t f = 0; f < 4; f++) {
+        expected += 0.25 * sin(2 * M_PI * frequencies[f] * (i - latency));
+      }
+      error = fmax(error, fabs(out[i] - expected));
+    }
+    vagg_ok(error < 1e-4, "The round trip is the input, late by latency() frames.");
+  }
+
+  Oversampler none(1, 1, 256);
+  vagg_ok(none.latency() == 0, "Without oversampling, there is no latency.");
+}
+
+void shape_test()
+{
+  const Distortion::Shape shapes[] = {Distortion::SoftClip, Distortion::Foldback,
+                                      Distortion::Atan, Distortion::Tanh,
+                                      Distortion::BitCrush};
+  const float amounts[] = {0.5f, 0.3f, 16, 4, 8};
+  for (size_t s = 0; s < 5; s++) {
+    // A length not a multiple of four, for the scalar tail.
+    std::vector<float> samples(4003);
+    for (size_t i = 0; i < samples.size(); i++) {
+      samples[i] = -1 + 2.0f * i / (samples.size() - 1);
+    }
+    Distortion::shape(shapes[s], amounts[s], &samples[0], samples.size());
+    bool bounded = true;
+    for (size_t i = 0; i < samples.size(); i++) {
+      bounded = bounded && fabsf(samples[i]) <= 1;
+    }
+    vagg_ok(bounded, "Within full scale, the curve stays within full scale.");
+  }
+
+  float full_scale[2] = {1, -1};
+  Distortion::shape(Distortion::Tanh, 4, full_scale, 2);
+  vagg_ok(fabsf(full_scale[0] - 1) < 1e-4 && fabsf(full_scale[1] + 1) < 1e-4,
+          "Full scale stays full scale through tanh.");
+  full_scale[0] = 1;
+  full_scale[1] = -1;
+  Distortion::shape(Distortion::Atan, 16, full_scale, 2);
+  vagg_ok(fabsf(full_scale[0] - 1) < 1e-4 && fabsf(full_scale[1] + 1) < 1e-4,
+          "Full scale stays full scale through atan.");
+
+  Distortion distortion(Distortion::Tanh, 2, 4);
+  std::vector<float> samples(300);
+  for (size_t i = 0; i < samples.size(); i++) {
+    samples[i] = sinf(i);
+  }
+  std::vector<float> original(samples);
+  distortion.process(&samples[0], samples.size() / 3, 3);
+  vagg_ok(samples == original, "When oversampling, another number of channels is left untouched.");
+}
+
+int main()
+{
+  vagg_start(vagg_display_success);
+
+  fast_math_test();
+  oversampler_test();
+  shape_test();
+
+  vagg_end();
+  return 0;
+}
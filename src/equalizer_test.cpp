@@ -0,0 +1,152 @@
+#include "Equalizer.hpp"
+
+#define VAGG_TEST
+
+#include "vagg/vagg.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <vector>
+
+#define TEST_SAMPLERATE 48000
+#define TEST_FRAMES 48000
+
+/**
+ * @brief An Equalizer that always runs the scalar filters, to compare with.
+ */
+class ScalarEqualizer : public Equalizer
+{
+  public:
+    ScalarEqualizer(int samplerate, size_t channels)
+      :Equalizer(samplerate, channels)
+    { }
+    virtual void process(SamplesType* samples, size_t length, size_t channels)
+    {
+      if (channels != channels_) {
+        return;
+      }
+      coefficients_.update();
+      process_scalar(coefficients_.read_buffer(), samples, length, channels);
+    }
+};
+
+/**
+ * @brief The gain of |equalizer| at |frequency|, in dB, measured on the
+ * second half of a mono sine, once the filters have settled.
+ */
+static double gain_at(Equalizer& equalizer, double frequency)
+{
+  std::vector<float> samples(TEST_FRAMES);
+  for (size_t i = 0; i < samples.size(); i++) {
+    samples[i] = 0.5 * sin(2 * M_PI * frequency * i / TEST_SAMPLERATE);
+  }
+  equalizer.process(&samples[0], samples.size(), 1);
+  double sum_squares = 0;
+  for (size_t i = samples.size() / 2; i < samples.size(); i++) {
+    sum_squares += samples[i] * samples[i];
+  }
+  double rms = sqrt(sum_squares / (samples.size() / 2));
+  return 20 * log10(rms / (0.5 / sqrt(2)));
+}
+
+void band_gain_test()
+{
+  Equalizer peak(TEST_SAMPLERATE, 1);
+  peak.add_band(Equalizer::Peak, 1000, 6, 1);
+  vagg_ok(fabs(gain_at(peak, 1000) - 6) < 0.05, "A peak band has its gain at its frequency.");
+  Equalizer far_away(TEST_SAMPLERATE, 1);
+  far_away.add_band(Equalizer::Peak, 1000, 6, 1);
+  vagg_ok(fabs(gain_at(far_away, 50)) < 0.1, "A peak band leaves the frequencies far from it.");
+
+  Equalizer shelf(TEST_SAMPLERATE, 1);
+  shelf.add_band(Equalizer::LowShelf, 200, -9, 0.707);
+  vagg_ok(fabs(gain_at(shelf, 30) + 9) < 0.2, "A low shelf has its gain below its frequency.");
+
+  Equalizer low_pass(TEST_SAMPLERATE, 1);
+  low_pass.add_band(Equalizer::LowPass, 1000, 0, 0.707);
+  vagg_ok(fabs(gain_at(low_pass, 1000) + 3.01) < 0.05, "A Butterworth low pass is 3 dB down at its cutoff.");
+
+  Equalizer cascade(TEST_SAMPLERATE, 1);
+  cascade.add_band(Equalizer::Peak, 1000, 3, 1);
+  cascade.add_band(Equalizer::Peak, 1000, 3, 1);
+  vagg_ok(fabs(gain_at(cascade, 1000) - 6) < 0.05, "The gains of the bands add up.");
+  cascade.set_band(1, Equalizer::Peak, 1000, -3, 1);
+  vagg_ok(fabs(gain_at(cascade, 1000)) < 0.05, "A band can be changed.");
+}
+
+/**
+ * @brief The vector path, with channels that fill vectors partially,
+ * matches the scalar path.
+ */
+void vector_test()
+{
+  const size_t channel_counts[] = {1, 2, 3, 4, 5, 7, 8};
+  bool same = true;
+  for (size_t n = 0; n < sizeof(channel_counts) / sizeof(channel_counts[0]); n++) {
+    size_t channels = channel_counts[n];
+    Equalizer vector(TEST_SAMPLERATE, channels);
+    ScalarEqualizer scalar(TEST_SAMPLERATE, channels);
+    Equalizer* both[2] = {&vector, &scalar};
+    for (size_t e = 0; e < 2; e++) {
+      both[e]->add_band(Equalizer::LowShelf, 100, 4, 0.7);
+      both[e]->add_band(Equalizer::Peak, 2500, -6, 2);
+      both[e]->add_band(Equalizer::HighPass, 30, 0, 0.7);
+    }
+    srand(channels);
+    std::vector<float> a(channels * 1000);
+    for (size_t i = 0; i < a.size(); i++) {
+      a[i] = rand() / static_cast<float>(RAND_MAX) - 0.5f;
+    }
+    std::vector<float> b(a);
+    // Blocks of odd sizes, so that the state is carried over.
+    for (size_t done = 0, length = 1; done < 1000; done += length, length += 37) {
+      if (length > 1000 - done) {
+        length = 1000 - done;
+      }
+      vector.process(&a[done * channels], length, channels);
+      scalar.process(&b[done * channels], length, channels);
+    }
+    for (size_t i = 0; i < a.size(); i++) {
+      same = same && fabsf(a[i] - b[i]) <= 1e-6f;
+    }
+  }
+  vagg_ok(same, "The vector and scalar paths give the same output.");
+}
+
+void parameters_test()
+{
+  Equalizer equalizer(TEST_SAMPLERATE, 2);
+  vagg_ok(equalizer.add_band(Equalizer::Peak, 1000, 6, 0) == -1, "A q of 0 is refused.");
+  vagg_ok(equalizer.add_band(Equalizer::Peak, 1000, 6, -1) == -1, "A negative q is refused.");
+  vagg_ok(equalizer.add_band(Equalizer::LowPass, 0, 0, 0.7) == -1, "A frequency of 0 is refused.");
+  vagg_ok(equalizer.add_band(Equalizer::LowPass, TEST_SAMPLERATE / 2, 0, 0.7) == -1,
+          "The Nyquist frequency is refused.");
+  vagg_ok(equalizer.add_band(Equalizer::HighShelf, NAN, 3, 0.7) == -1, "NaN is refused.");
+  vagg_ok(equalizer.add_band(Equalizer::Peak, 1000, 6, 1) == 0,
+          "The refused bands are not added.");
+  vagg_ok(equalizer.set_band(0, Equalizer::Peak, 30000, 6, 1) == -1,
+          "A band cannot be changed to an unstable one.");
+
+  std::vector<float> samples(2 * TEST_FRAMES);
+  for (size_t i = 0; i < samples.size(); i++) {
+    samples[i] = sinf(i);
+  }
+  equalizer.process(&samples[0], TEST_FRAMES, 2);
+  bool finite = true;
+  for (size_t i = 0; i < samples.size(); i++) {
+    finite = finite && isfinite(samples[i]);
+  }
+  vagg_ok(finite, "The output stays finite.");
+}
+
+int main()
+{
+  vagg_start(vagg_display_success);
+
+  band_gain_test();
+  vector_test();
+  parameters_test();
+
+  vagg_end();
+  return 0;
+}
@@ -0,0 +1,143 @@
+#include "Limiter.hpp"
+
+#define VAGG_TEST
+
+#include "vagg/vagg.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <vector>
+
+#define TEST_SAMPLERATE 44100
+#define TEST_FRAMES 44100
+
+/**
+ * @brief Process |samples| through |limiter| in blocks of sizes taken in
+ * turn from |lengths|.
+ */
+static void process_by_blocks(Limiter& limiter, std::vector<float>& samples, size_t channels,
+                              const size_t* lengths, size_t count)
+{
+  size_t frames = samples.size() / channels;
+  size_t done = 0;
+  for (size_t i = 0; done < frames; i++) {
+    size_t length = lengths[i % count];
+    if (length > frames - done) {
+      length = frames - done;
+    }
+    limiter.process(&samples[done * channels], length, channels);
+    done += length;
+  }
+}
+
+/**
+ * @brief Noise with bursts up to 12 dB above full scale.
+ */
+static std::vector<float> loud_noise(size_t channels)
+{
+  std::vector<float> samples(TEST_FRAMES * channels);
+  srand(channels);
+  for (size_t i = 0; i < samples.size(); i++) {
+    float level = (i / channels) % 3000 < 500 ? 4 : 0.5f;
+    samples[i] = level * (rand() / static_cast<float>(RAND_MAX) * 2 - 1);
+  }
+  return samples;
+}
+
+/**
+ * @brief Whatever the size of the blocks, the output never goes above the
+ * threshold.
+ */
+void ceiling_test()
+{
+  const size_t splits[][5] = {{1, 1, 1, 1, 1}, {7, 1, 33, 13, 5}, {64, 64, 64, 64, 64},
+                              {220, 221, 219, 1, 440}, {4096, 4096, 4096, 4096, 4096}};
+  const size_t channel_counts[] = {1, 2, 3};
+  const float thresholds[] = {-1, -6, -20};
+  bool below = true;
+  for (size_t c = 0; c < 3; c++) {
+    for (size_t t = 0; t < 3; t++) {
+      for (size_t s = 0; s < 5; s++) {
+        size_t channels = channel_counts[c];
+        Limiter limiter(TEST_SAMPLERATE, channels);
+        limiter.set_threshold(thresholds[t]);
+        std::vector<float> samples = loud_noise(channels);
+        process_by_blocks(limiter, samples, channels, splits[s], 5);
+        float ceiling = pow(10, thresholds[t] / 20) * (1 + 1e-5);
+        for (size_t i = 0; i < samples.size(); i++) {
+          below = below && fabsf(samples[i]) <= ceiling;
+        }
+      }
+    }
+  }
+  vagg_ok(below, "The output never goes above the threshold, for any block sizes.");
+}
+
+/**
+ * @brief Below the threshold, the signal comes out untouched, late by
+ * exactly the look-ahead.
+ */
+void latency_test()
+{
+  Limiter limiter(TEST_SAMPLERATE, 2, 5);
+  vagg_ok(limiter.latency() == TEST_SAMPLERATE * 5 / 1000, "The latency is the look-ahead.");
+  std::vector<float> samples(2 * 1000);
+  samples[2 * 10] = 0.5f;
+  samples[2 * 10 + 1] = -0.25f;
+  const size_t lengths[] = {7, 1, 33, 13, 5};
+  process_by_blocks(limiter, samples, 2, lengths, 5);
+  size_t delayed = 10 + limiter.latency();
+  bool late = true;
+  for (size_t i = 0; i < samples.size() / 2; i++) {
+    late = late && samples[2 * i] == (i == delayed ? 0.5f : 0);
+    late = late && samples[2 * i + 1] == (i == delayed ? -0.25f : 0);
+  }
+  vagg_ok(late, "A frame below the threshold comes out latency() frames later, untouched.");
+}
+
+/**
+ * @brief Nothing of the signal before a reset comes out after it.
+ */
+void reset_test()
+{
+  Limiter limiter(TEST_SAMPLERATE, 1);
+  limiter.set_threshold(-1);
+  std::vector<float> samples = loud_noise(1);
+  limiter.process(&samples[0], samples.size(), 1);
+  limiter.reset();
+  std::vector<float> silence(1000);
+  limiter.process(&silence[0], silence.size(), 1);
+  bool silent = true;
+  for (size_t i = 0; i < silence.size(); i++) {
+    silent = silent && silence[i] == 0;
+  }
+  vagg_ok(silent, "After a reset, the look-ahead is empty.");
+
+  std::vector<float> quiet(2000, 0.5f);
+  limiter.process(&quiet[0], quiet.size(), 1);
+  vagg_ok(quiet[limiter.latency()] == 0.5f && quiet.back() == 0.5f,
+          "After a reset, the gain is back to 1.");
+}
+
+void channels_test()
+{
+  Limiter limiter(TEST_SAMPLERATE, 2);
+  limiter.set_threshold(-6);
+  std::vector<float> samples = loud_noise(3);
+  std::vector<float> original(samples);
+  limiter.process(&samples[0], samples.size() / 3, 3);
+  vagg_ok(samples == original, "Another number of channels is left untouched.");
+}
+
+int main()
+{
+  vagg_start(vagg_display_success);
+
+  ceiling_test();
+  latency_test();
+  reset_test();
+  channels_test();
+
+  vagg_end();
+  return 0;
+}
@@ -0,0 +1,110 @@
+#include "LoudnessMeter.hpp"
+
+#define VAGG_TEST
+
+#include "vagg/vagg.h"
+
+#include <math.h>
+#include <vector>
+
+#define TEST_SAMPLERATE 48000
+
+/**
+ * @brief Feed |seconds| of a stereo 1 kHz sine at |level| dBFS to |meter|, in
+ * blocks of odd sizes, carrying the phase over from |frame| on.
+ */
+static void feed_sine(LoudnessMeter& meter, double level, double seconds, size_t& frame)
+{
+  const size_t lengths[] = {7, 1, 333, 1024, 97};
+  size_t frames = seconds * TEST_SAMPLERATE;
+  float amplitude = pow(10, level / 20);
+  std::vector<float> samples(2 * 1024);
+  size_t done = 0;
+  for (size_t i = 0; done < frames; i++) {
+    size_t length = lengths[i % 5];
+    if (length > frames - done) {
+      length = frames - done;
+    }
+    for (size_t j = 0; j < length; j++) {
+      float value = amplitude * sin(2 * M_PI * 1000 * (frame + j) / TEST_SAMPLERATE);
+      samples[2 * j] = value;
+      samples[2 * j + 1] = value;
+    }
+    meter.process(&samples[0], length, 2);
+    frame += length;
+    done += length;
+  }
+}
+
+/**
+ * @brief A sine at -23 dBFS on both channels is the reference level of EBU
+ * R128, -23 LUFS.
+ */
+void reference_test()
+{
+  LoudnessMeter meter(TEST_SAMPLERATE);
+  LoudnessValues values;
+  vagg_ok(! meter.read(&values), "Nothing is published before the first block.");
+  size_t frame = 0;
+  feed_sine(meter, -23, 10, frame);
+  vagg_ok(meter.read(&values), "The values are published.");
+  vagg_ok(fabs(values.momentary + 23) < 0.05, "The momentary loudness is -23 LUFS.");
+  vagg_ok(fabs(values.short_term + 23) < 0.05, "The short-term loudness is -23 LUFS.");
+  vagg_ok(fabs(values.integrated + 23) < 0.05, "The integrated loudness is -23 LUFS.");
+  vagg_ok(fabs(values.true_peak + 23) < 0.1, "The true peak is -23 dBTP.");
+  vagg_ok(! meter.read(&values), "Nothing new is published until the next block.");
+}
+
+/**
+ * @brief The quiet part is within 10 LU of the loud ones, and counts in the
+ * integrated loudness : the mean energy of -26, -36 and -26 LUFS blocks.
+ */
+void gating_test()
+{
+  LoudnessMeter meter(TEST_SAMPLERATE);
+  size_t frame = 0;
+  feed_sine(meter, -26, 20, frame);
+  feed_sine(meter, -36, 20, frame);
+  feed_sine(meter, -26, 20, frame);
+  LoudnessValues values;
+  meter.read(&values);
+  double expected = 10 * log10((2 * pow(10, -2.6) + pow(10, -3.6)) / 3);
+  vagg_ok(fabs(values.integrated - expected) < 0.1, "The integrated loudness is -27.5 LUFS.");
+
+  // Silence is below the absolute gate, and does not count.
+  feed_sine(meter, -120, 20, frame);
+  meter.read(&values);
+  vagg_ok(fabs(values.integrated - expected) < 0.1, "Silence does not lower the integrated loudness.");
+  vagg_ok(values.momentary < LOUDNESS_ABSOLUTE_GATE, "The momentary loudness of silence is very low.");
+
+  meter.reset(TEST_SAMPLERATE);
+  feed_sine(meter, -23, 5, frame);
+  meter.read(&values);
+  vagg_ok(fabs(values.integrated + 23) < 0.05, "After a reset, the measure starts over.");
+}
+
+/**
+ * @brief Loud blocks gate out a part more than 10 LU quieter.
+ */
+void relative_gate_test()
+{
+  LoudnessMeter meter(TEST_SAMPLERATE);
+  size_t frame = 0;
+  feed_sine(meter, -20, 20, frame);
+  feed_sine(meter, -40, 20, frame);
+  LoudnessValues values;
+  meter.read(&values);
+  vagg_ok(fabs(values.integrated + 20) < 0.1, "A part 20 LU quieter is gated out.");
+}
+
+int main()
+{
+  vagg_start(vagg_display_success);
+
+  reference_test();
+  gating_test();
+  relative_gate_test();
+
+  vagg_end();
+  return 0;
+}
@@ -0,0 +1,227 @@
+#include "AudioFile.hpp"
+
+#define VAGG_TEST
+
+#include "vagg/vagg.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+
+#define TEST_SAMPLERATE 1000
+/* Odd, so that the mono and 3 channels files have an odd number of samples,
+ * and the 24 bits ones an odd number of bytes. */
+#define TEST_FRAMES 1001
+
+#define WAVE_FORMAT_PCM 1
+#define WAVE_FORMAT_IEEE_FLOAT 3
+#define WAVE_FORMAT_EXTENSIBLE 0xFFFE
+
+struct TestFormat {
+  uint16_t tag;
+  uint16_t bits;
+  bool extensible;
+  MappedWav::Encoding encoding;
+};
+
+static void put16(FILE* f, uint16_t v)
+{
+  fputc(v & 0xff, f);
+  fputc(v >> 8, f);
+}
+
+static void put32(FILE* f, uint32_t v)
+{
+  put16(f, v & 0xffff);
+  put16(f, v >> 16);
+}
+
+/**
+ * @brief Random samples in |format|, little endian, the extreme values first,
+ * in |data|, and what libsndfile reads from them in |expected|.
+ */
+static void make_samples(const TestFormat& format, size_t count,
+                         std::vector<unsigned char>* data, std::vector<float>* expected)
+{
+  size_t width = format.bits / 8;
+  data->resize(count * width);
+  expected->resize(count);
+  for (size_t i = 0; i < count; i++) {
+    uint32_t word;
+    if (format.tag == WAVE_FORMAT_IEEE_FLOAT) {
+      float value = rand() / static_cast<float>(RAND_MAX) * 2 - 1;
+      memcpy(&word, &value, sizeof(word));
+      (*expected)[i] = value;
+    } else {
+      int64_t full = static_cast<int64_t>(1) << (format.bits - 1);
+      int64_t value = ((static_cast<int64_t>(rand()) << 16) ^ rand()) % full;
+      value = rand() % 2 ? value : -value;
+      if (i == 0) {
+        value = -full;
+      } else if (i == 1) {
+        value = full - 1;
+      }
+      word = static_cast<uint32_t>(value);
+      (*expected)[i] = static_cast<double>(value) / full;
+    }
+    for (size_t b = 0; b < width; b++) {
+      (*data)[i * width + b] = word >> (8 * b);
+    }
+  }
+}
+
+/**
+ * @brief Write |data| as a WAV file in |format|, with an odd sized chunk
+ * before the data, and return its path, or an empty string.
+ */
+static std::string write_wav(const TestFormat& format, int channels,
+                             const std::vector<unsigned char>& data)
+{
+  char path[] = "/tmp/mappedwav_test_XXXXXX";
+  int fd = mkstemp(path);
+  if (fd == -1) {
+    return "";
+  }
+  FILE* f = fdopen(fd, "wb");
+  uint32_t format_bytes = format.extensible ? 40 : 16;
+  uint32_t padded = data.size() + (data.size() & 1);
+  uint16_t block_align = channels * format.bits / 8;
+  fwrite("RIFF", 1, 4, f);
+  put32(f, 4 + 8 + format_bytes + 8 + 4 + 8 + padded);
+  fwrite("WAVEfmt ", 1, 8, f);
+  put32(f, format_bytes);
+  put16(f, format.extensible ? WAVE_FORMAT_EXTENSIBLE : format.tag);
+  put16(f, channels);
+  put32(f, TEST_SAMPLERATE);
+  put32(f, TEST_SAMPLERATE * block_align);
+  put16(f, block_align);
+  put16(f, format.bits);
+  if (format.extensible) {
+    static const unsigned char guid_tail[] = {0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x80,
+                                              0x00, 0x00, 0xAA, 0x00, 0x38, 0x9B, 0x71};
+    put16(f, 22);
+    put16(f, format.bits);
+    put32(f, 0);
+    put16(f, format.tag);
+    fwrite(guid_tail, 1, sizeof(guid_tail), f);
+  }
+  // Three bytes and a pad byte.
+  fwrite("junk", 1, 4, f);
+  put32(f, 3);
+  fwrite("abc", 1, 4, f);
+  fwrite("data", 1, 4, f);
+  put32(f, data.size());
+  fwrite(&data[0], 1, data.size(), f);
+  if (data.size() & 1) {
+    fputc(0, f);
+  }
+  fclose(f);
+  return path;
+}
+
+/**
+ * @brief Read |file| to its end with read_frames(), by blocks of odd sizes.
+ */
+static std::vector<float> read_all(AudioFile& file)
+{
+  const size_t lengths[] = {7, 1, 33, 13, 5};
+  size_t channels = file.channels();
+  std::vector<float> samples;
+  std::vector<float> block(33 * channels);
+  for (size_t i = 0; ; i++) {
+    size_t length = lengths[i % 5];
+    size_t read = file.read_frames(&block[0], length);
+    if (read == static_cast<size_t>(-1)) {
+      break;
+    }
+    samples.insert(samples.end(), block.begin(), block.begin() + read * channels);
+    if (read != length) {
+      break;
+    }
+  }
+  return samples;
+}
+
+/**
+ * @brief ReadMapped reads what libsndfile reads, for all the formats it
+ * maps, with 1 to 3 channels, from the start and after seek().
+ */
+void formats_test()
+{
+  const TestFormat formats[] = {
+    {WAVE_FORMAT_PCM, 16, false, MappedWav::Pcm16},
+    {WAVE_FORMAT_PCM, 24, false, MappedWav::Pcm24},
+    {WAVE_FORMAT_PCM, 32, false, MappedWav::Pcm32},
+    {WAVE_FORMAT_IEEE_FLOAT, 32, false, MappedWav::Float32},
+    {WAVE_FORMAT_PCM, 16, true, MappedWav::Pcm16},
+    {WAVE_FORMAT_PCM, 24, true, MappedWav::Pcm24},
+    {WAVE_FORMAT_IEEE_FLOAT, 32, true, MappedWav::Float32}
+  };
+  // Nothing is decoded whole into the SampleCache : the reads go to the
+  // mapping and to libsndfile.
+  SampleCache::instance().set_threshold(0);
+  srand(1);
+  bool mappable = true;
+  bool opened = true;
+  bool mapped_same = true;
+  bool decoded_same = true;
+  bool seek_same = true;
+  for (size_t n = 0; n < sizeof(formats) / sizeof(formats[0]); n++) {
+    for (int channels = 1; channels <= 3; channels++) {
+      std::vector<unsigned char> data;
+      std::vector<float> expected;
+      make_samples(formats[n], TEST_FRAMES * channels, &data, &expected);
+      std::string path = write_wav(formats[n], channels, data);
+      // ReadMapped falls back to libsndfile for what it cannot map.
+      MappedWav wav;
+      mappable = mappable && wav.open(path.c_str()) == 0 &&
+                 wav.encoding() == formats[n].encoding && wav.channels() == channels &&
+                 wav.samplerate() == TEST_SAMPLERATE && wav.frames() == TEST_FRAMES;
+      wav.close();
+      AudioFile mapped(path.c_str());
+      AudioFile decoded(path.c_str());
+      if (path.empty() || mapped.open(AudioFile::ReadMapped) != 0 ||
+          decoded.open(AudioFile::Read) != 0) {
+        opened = false;
+        unlink(path.c_str());
+        continue;
+      }
+      unlink(path.c_str());
+      opened = opened && mapped.channels() == channels && decoded.channels() == channels;
+      opened = opened && mapped.peak() < 0;
+
+      mapped_same = mapped_same && read_all(mapped) == expected;
+      decoded_same = decoded_same && read_all(decoded) == expected;
+
+      // From the end of the file.
+      const double positions[] = {0.25, 0.5};
+      for (size_t p = 0; p < 2; p++) {
+        mapped.seek(positions[p]);
+        decoded.seek(positions[p]);
+        std::vector<float> rest(expected.begin() + positions[p] * TEST_SAMPLERATE * channels,
+                                expected.end());
+        std::vector<float> from_mapped = read_all(mapped);
+        seek_same = seek_same && from_mapped == rest && read_all(decoded) == from_mapped;
+      }
+    }
+  }
+  SampleCache::instance().set_threshold(SAMPLE_CACHE_THRESHOLD);
+  vagg_ok(mappable, "MappedWav maps every file, with its format.");
+  vagg_ok(opened, "Open every file with ReadMapped and Read, without decoding it whole.");
+  vagg_ok(mapped_same, "ReadMapped reads the samples scaled like libsndfile.");
+  vagg_ok(decoded_same, "Read reads the same samples.");
+  vagg_ok(seek_same, "ReadMapped and Read read the same after seek().");
+}
+
+int main()
+{
+  vagg_start(vagg_display_success);
+
+  formats_test();
+
+  vagg_end();
+  return 0;
+}
@@ -0,0 +1,157 @@
+#include "MetadataCache.hpp"
+
+#define VAGG_TEST
+
+#include "vagg/vagg.h"
+
+#include <fcntl.h>
+#include <glob.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief The number of files whose path starts with |prefix|.
+ */
+static size_t count_files(const std::string& prefix)
+{
+  glob_t found;
+  size_t count = 0;
+  if (glob((prefix + "*").c_str(), 0, 0, &found) == 0) {
+    count = found.gl_pathc;
+  }
+  globfree(&found);
+  return count;
+}
+
+static bool same(const AudioMetadata& a, const AudioMetadata& b)
+{
+  return a.channels == b.channels && a.samplerate == b.samplerate &&
+         a.format == b.format && a.frames == b.frames && a.peak == b.peak;
+}
+
+void round_trip_test()
+{
+  char path[] = "/tmp/metadatacache_test_XXXXXX";
+  int fd = mkstemp(path);
+  vagg_ok(fd != -1 && write(fd, "samples", 7) == 7, "Write a file.");
+  close(fd);
+  std::string sidecar = MetadataCache::sidecar_path(path);
+
+  AudioMetadata stored;
+  stored.channels = 3;
+  stored.samplerate = 48000;
+  stored.format = 0x010006;
+  stored.frames = 1234567890123ULL;
+  stored.peak = 0.123456789f;
+  AudioMetadata loaded;
+
+  vagg_ok(MetadataCache::store(path, stored) == -1 && MetadataCache::load(path, &loaded) == -1,
+          "Nothing is stored nor loaded while disabled.");
+  MetadataCache::set_enabled(true);
+  vagg_ok(MetadataCache::load(path, &loaded) == -1, "There is no sidecar yet.");
+  vagg_ok(MetadataCache::store(path, stored) == 0, "Store the metadata.");
+  vagg_ok(MetadataCache::load(path, &loaded) == 0 && same(loaded, stored),
+          "Load the same metadata back.");
+  // The file, its sidecar, and nothing else.
+  vagg_ok(count_files(path) == 2, "No temporary file is left behind.");
+  struct stat st;
+  vagg_ok(stat(sidecar.c_str(), &st) == 0 && (st.st_mode & 0777) == 0644,
+          "The sidecar is readable by all.");
+
+  stored.peak = -1;
+  vagg_ok(MetadataCache::store(path, stored) == 0 &&
+          MetadataCache::load(path, &loaded) == 0 && same(loaded, stored),
+          "Storing again replaces the sidecar.");
+
+  fd = open(path, O_WRONLY | O_APPEND);
+  vagg_ok(write(fd, "more", 4) == 4, "Make the file longer.");
+  close(fd);
+  vagg_ok(MetadataCache::load(path, &loaded) == -1, "The sidecar of a file of another size is ignored.");
+  vagg_ok(MetadataCache::store(path, stored) == 0 && MetadataCache::load(path, &loaded) == 0,
+          "It is stored again.");
+
+  struct timespec times[2];
+  times[0].tv_sec = 0;
+  times[0].tv_nsec = UTIME_OMIT;
+  times[1].tv_sec = 1000000000;
+  times[1].tv_nsec = 0;
+  vagg_ok(utimensat(AT_FDCWD, path, times, 0) == 0 && MetadataCache::load(path, &loaded) == -1,
+          "The sidecar of a file with another mtime is ignored.");
+
+  FILE* garbage = fopen(sidecar.c_str(), "w");
+  fputs("vaggmeta 1 garbage\n", garbage);
+  fclose(garbage);
+  vagg_ok(MetadataCache::load(path, &loaded) == -1, "A malformed sidecar is ignored.");
+
+  MetadataCache::set_enabled(false);
+  unlink(sidecar.c_str());
+  unlink(path);
+}
+
+/**
+ * @brief Threads store the same sidecar at once, each its own metadata,
+ * while it is loaded : the sidecar is always whole, and one of them.
+ */
+void concurrent_test()
+{
+  char path[] = "/tmp/metadatacache_test_XXXXXX";
+  int fd = mkstemp(path);
+  vagg_ok(fd != -1 && write(fd, "samples", 7) == 7, "Write a file.");
+  close(fd);
+  MetadataCache::set_enabled(true);
+
+  const size_t writers = 4;
+  std::vector<int> failures(writers, 0);
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < writers; i++) {
+    int* failed = &failures[i];
+    threads.push_back(std::thread([path, i, failed]() {
+      AudioMetadata metadata;
+      metadata.channels = i + 1;
+      metadata.samplerate = 1000 * (i + 1);
+      metadata.format = 0;
+      metadata.frames = i + 1;
+      metadata.peak = 0.5f;
+      for (size_t n = 0; n < 500; n++) {
+        *failed += MetadataCache::store(path, metadata) != 0;
+      }
+    }));
+  }
+  bool whole = true;
+  for (size_t n = 0; n < 2000; n++) {
+    AudioMetadata loaded;
+    if (MetadataCache::load(path, &loaded) == 0) {
+      whole = whole && loaded.channels >= 1 && loaded.channels <= static_cast<int>(writers) &&
+              loaded.samplerate == 1000 * loaded.channels &&
+              loaded.frames == static_cast<uint64_t>(loaded.channels);
+    }
+  }
+  int failed = 0;
+  for (size_t i = 0; i < writers; i++) {
+    threads[i].join();
+    failed += failures[i];
+  }
+  vagg_ok(failed == 0, "Every store succeeds.");
+  vagg_ok(whole, "Every load reads the metadata of one of the writers.");
+  vagg_ok(count_files(path) == 2, "No temporary file is left behind.");
+
+  MetadataCache::set_enabled(false);
+  unlink(MetadataCache::sidecar_path(path).c_str());
+  unlink(path);
+}
+
+int main()
+{
+  vagg_start(vagg_display_success);
+
+  round_trip_test();
+  concurrent_test();
+
+  vagg_end();
+  return 0;
+}
@@ -0,0 +1,102 @@
+#include "Meter.hpp"
+
+#define VAGG_TEST
+
+#include "vagg/vagg.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <vector>
+
+/**
+ * @brief Whether |kernel| gives the same peaks as the scalar loop, and the
+ * same sums up to the order of the additions, for all the channel counts and
+ * lengths, including some that do not fill the vectors.
+ *
+ * @param ran Set to whether the kernel could run at all.
+ */
+static bool same_as_scalar(Meter::Kernel kernel, bool* ran)
+{
+  const size_t channel_counts[] = {1, 2, 4, 6, 8};
+  const size_t lengths[] = {0, 1, 3, 7, 8, 15, 16, 17, 33, 100, 1001};
+  bool same = true;
+  *ran = false;
+  for (size_t n = 0; n < sizeof(channel_counts) / sizeof(channel_counts[0]); n++) {
+    size_t channels = channel_counts[n];
+    for (size_t l = 0; l < sizeof(lengths) / sizeof(lengths[0]); l++) {
+      size_t frames = lengths[l];
+      std::vector<float> samples(frames * channels + 1);
+      for (size_t i = 0; i < samples.size(); i++) {
+        samples[i] = rand() / static_cast<float>(RAND_MAX) * 2 - 1;
+      }
+      float scalar_squares[METER_MAX_CHANNELS];
+      float scalar_peak[METER_MAX_CHANNELS];
+      float squares[METER_MAX_CHANNELS];
+      float peak[METER_MAX_CHANNELS];
+      Meter::measure_with(Meter::Scalar, &samples[0], frames, channels,
+                          scalar_squares, scalar_peak);
+      if (Meter::measure_with(kernel, &samples[0], frames, channels, squares, peak) == -1) {
+        // Only the channels that do not divide a vector are refused.
+        same = same && channels == 6;
+        Meter::measure(&samples[0], frames, channels, squares, peak);
+      } else {
+        *ran = true;
+      }
+      for (size_t c = 0; c < channels; c++) {
+        same = same && peak[c] == scalar_peak[c];
+        same = same && fabsf(squares[c] - scalar_squares[c]) <= 1e-5f * (1 + scalar_squares[c]);
+      }
+    }
+  }
+  return same;
+}
+
+void kernels_test()
+{
+  srand(1);
+  bool ran;
+  vagg_ok(same_as_scalar(Meter::Scalar, &ran), "The scalar kernel is the reference.");
+#ifdef __SSE2__
+  vagg_ok(same_as_scalar(Meter::SSE2, &ran) && ran, "The SSE2 kernel matches the scalar one.");
+#endif
+  bool same = same_as_scalar(Meter::AVX2, &ran);
+  if (ran) {
+    vagg_ok(same, "The AVX2 kernel matches the scalar one.");
+  } else {
+    printf("No AVX2 here, its kernel is not tested.\n");
+  }
+}
+
+void window_test()
+{
+  Meter meter(100);
+  MeterValues values;
+  std::vector<float> samples(2 * 60);
+  for (size_t i = 0; i < samples.size(); i += 2) {
+    samples[i] = i % 4 ? 0.5f : -0.5f;
+    samples[i + 1] = 0.25f;
+  }
+  samples[2 * 30 + 1] = -0.75f;
+  meter.process(&samples[0], 60, 2);
+  vagg_ok(! meter.read(&values), "Nothing is published before the end of the window.");
+  samples[2 * 30 + 1] = 0.25f;
+  meter.process(&samples[0], 60, 2);
+  vagg_ok(meter.read(&values), "The window is published.");
+  vagg_ok(values.channels == 2, "Both channels are measured.");
+  vagg_ok(fabsf(values.rms[0] - 0.5f) < 1e-6, "The RMS of a square wave is its amplitude.");
+  vagg_ok(values.peak[1] == 0.75f, "The peak is the largest absolute value.");
+
+  meter.process(&samples[0], 60, 0);
+  vagg_ok(! meter.read(&values), "A block without channels is ignored.");
+}
+
+int main()
+{
+  vagg_start(vagg_display_success);
+
+  kernels_test();
+  window_test();
+
+  vagg_end();
+  return 0;
+}
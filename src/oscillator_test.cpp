@@ -0,0 +1,176 @@
+#include "OscillatorBank.hpp"
+
+#define VAGG_TEST
+
+#include "vagg/vagg.h"
+
+#include <math.h>
+#include <vector>
+
+#define TEST_SAMPLERATE 48000
+#define TEST_FRAMES 48000
+
+/**
+ * @brief An OscillatorBank that always runs the scalar voices, to compare
+ * with.
+ */
+class ScalarOscillatorBank : public OscillatorBank
+{
+  public:
+    ScalarOscillatorBank(int samplerate)
+      :OscillatorBank(samplerate)
+    { }
+    void render_scalar(SamplesType* out, size_t frames)
+    {
+      for (size_t offset = 0; offset < frames; offset += OSCILLATOR_CHUNK) {
+        size_t length = frames - offset < OSCILLATOR_CHUNK ? frames - offset : OSCILLATOR_CHUNK;
+        published_.update();
+        render_chunk_scalar(published_.read_buffer(), out + offset, length);
+      }
+    }
+};
+
+/**
+ * @brief Render |out.size() - from| frames of |bank| to |out| from |from| on,
+ * in blocks of odd sizes.
+ */
+static void render_by_blocks(OscillatorBank& bank, std::vector<float>& out, size_t from)
+{
+  const size_t lengths[] = {1, 37, 100, 3, 255, 256, 300};
+  for (size_t i = 0; from < out.size(); i++) {
+    size_t length = lengths[i % 7];
+    if (length > out.size() - from) {
+      length = out.size() - from;
+    }
+    bank.render(&out[from], length);
+    from += length;
+  }
+}
+
+static void add_voices(OscillatorBank& bank)
+{
+  bank.add(Sine, 440, 0.1f);
+  bank.add(Sine, 1234.5f, 0.1f);
+  bank.add(Saw, 1000.5f, 0.1f);
+  bank.add(Square, 3001, 0.1f);
+  bank.add(Square, 55, 0.1f);
+  bank.add(Triangle, 97.3f, 0.1f);
+  for (size_t i = 0; i < 5; i++) {
+    bank.add(Sine, 200 + 300 * i, 0.05f);
+  }
+  bank.commit();
+}
+
+/**
+ * @brief A sine whose increment is exact in a float runs without drifting,
+ * whatever the blocks are.
+ */
+void sine_test()
+{
+  OscillatorBank bank(TEST_SAMPLERATE);
+  bank.add(Sine, TEST_SAMPLERATE / 64, 1);
+  bank.commit();
+  std::vector<float> out(TEST_FRAMES);
+  // The gain goes from 0 to 1 over the first chunk.
+  bank.render(&out[0], OSCILLATOR_CHUNK);
+  render_by_blocks(bank, out, OSCILLATOR_CHUNK);
+  double error = 0;
+  for (size_t i = OSCILLATOR_CHUNK; i < out.size(); i++) {
+    error = fmax(error, fabs(out[i] - sin(2 * M_PI * i / 64)));
+  }
+  vagg_ok(error < 2e-6, "A sine voice is a sine, across blocks.");
+}
+
+/**
+ * @brief The phases carry over from one chunk to the next : rendering by
+ * blocks of any size gives the same output as by whole chunks.
+ */
+void continuity_test()
+{
+  OscillatorBank chunks(TEST_SAMPLERATE);
+  OscillatorBank blocks(TEST_SAMPLERATE);
+  add_voices(chunks);
+  add_voices(blocks);
+  std::vector<float> a(TEST_FRAMES / 4);
+  std::vector<float> b(TEST_FRAMES / 4);
+  chunks.render(&a[0], a.size());
+  blocks.render(&b[0], OSCILLATOR_CHUNK);
+  render_by_blocks(blocks, b, OSCILLATOR_CHUNK);
+  vagg_ok(a == b, "The output does not depend on the size of the blocks.");
+
+  // A change of frequency keeps the phase : no jump bigger than the slope
+  // of the sine allows.
+  OscillatorBank bank(TEST_SAMPLERATE);
+  int voice = bank.add(Sine, 440, 1);
+  bank.commit();
+  std::vector<float> out(2 * OSCILLATOR_CHUNK + 100);
+  bank.render(&out[0], OSCILLATOR_CHUNK + 100);
+  vagg_ok(bank.set(voice, 880, 1) == 0, "Change the frequency of a voice.");
+  bank.commit();
+  bank.render(&out[OSCILLATOR_CHUNK + 100], OSCILLATOR_CHUNK);
+  double jump = 0;
+  for (size_t i = OSCILLATOR_CHUNK; i + 1 < out.size(); i++) {
+    jump = fmax(jump, fabs(out[i + 1] - out[i]));
+  }
+  vagg_ok(jump <= 2 * M_PI * 880 / TEST_SAMPLERATE + 1e-5,
+          "Changing the frequency of a voice keeps its phase.");
+}
+
+/**
+ * @brief The vector path, with voices that fill vectors partially,
+ * matches the scalar path, through changes of frequency and gain.
+ */
+void vector_test()
+{
+  OscillatorBank vector(TEST_SAMPLERATE);
+  ScalarOscillatorBank scalar(TEST_SAMPLERATE);
+  add_voices(vector);
+  add_voices(scalar);
+  std::vector<float> a(TEST_FRAMES / 4);
+  std::vector<float> b(TEST_FRAMES / 4);
+  size_t half = a.size() / 2;
+  vector.render(&a[0], half);
+  scalar.render_scalar(&b[0], half);
+  OscillatorBank* both[2] = {&vector, &scalar};
+  for (size_t o = 0; o < 2; o++) {
+    both[o]->set(Saw * OSCILLATOR_MAX_VOICES, 5000, 0.2f);
+    both[o]->set(Triangle * OSCILLATOR_MAX_VOICES, 12345, 0.3f);
+    both[o]->commit();
+  }
+  vector.render(&a[half], a.size() - half);
+  scalar.render_scalar(&b[half], b.size() - half);
+  double error = 0;
+  for (size_t i = 0; i < a.size(); i++) {
+    error = fmax(error, fabs(a[i] - b[i]));
+  }
+  vagg_ok(error < 1e-5, "The vector and scalar paths give the same output.");
+}
+
+void voices_test()
+{
+  OscillatorBank bank(TEST_SAMPLERATE);
+  vagg_ok(bank.set(0, 440, 1) == -1, "A voice that was not added cannot be set.");
+  vagg_ok(bank.set(-1, 440, 1) == -1, "A negative voice cannot be set.");
+  int voice = -1;
+  for (size_t i = 0; i < OSCILLATOR_MAX_VOICES; i++) {
+    voice = bank.add(Square, 100, 0);
+  }
+  vagg_ok(voice == Square * OSCILLATOR_MAX_VOICES + OSCILLATOR_MAX_VOICES - 1,
+          "The voices of a waveform are numbered from its first slot.");
+  vagg_ok(bank.add(Square, 100, 0) == -1, "No more than OSCILLATOR_MAX_VOICES voices.");
+  vagg_ok(bank.add(Sine, 100, 0) == Sine * OSCILLATOR_MAX_VOICES,
+          "The other waveforms still have room.");
+}
+
+int main()
+{
+  vagg_start(vagg_display_success);
+
+  sine_test();
+  continuity_test();
+  vector_test();
+  voices_test();
+
+  vagg_end();
+  return 0;
+}
@@ -27,14 +27,15 @@ int main()
   // Create an RMS effect. It takes a callback which is called when results are
   // available.
   RMS rms(&rmscallback, 0);
-  // Insert the effect in the player a player can have only a single effect for
-  // now.
+  // Insert the effect in the player. Effects run in the order they are
+  // inserted.
   p.insert(&rms);
 
   // start the playback
   p.play();
 
-  // Call the state machine while there is still things to play.
+  // Wait while there is still things to play, the player refills its buffers
+  // on its own.
   while(p.state_machine()) {
     Pa_Sleep(50);
   }
@@ -0,0 +1,132 @@
+#include "ReadAhead.hpp"
+
+#define VAGG_TEST
+
+#include "vagg/vagg.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+/* Not a multiple of the block size nor of the alignment. */
+#define TEST_FILE_SIZE (20 * READ_AHEAD_BLOCK_SIZE + 17)
+#define TEST_SEEKS 2000
+#define TEST_MAX_READ 300000
+
+/**
+ * @brief Write TEST_FILE_SIZE random bytes to a new file, and return its
+ * path, or an empty string.
+ */
+static std::string write_file()
+{
+  char path[] = "/tmp/readahead_test_XXXXXX";
+  int fd = mkstemp(path);
+  if (fd == -1) {
+    return "";
+  }
+  std::vector<unsigned char> bytes(TEST_FILE_SIZE);
+  for (size_t i = 0; i < bytes.size(); i++) {
+    bytes[i] = rand();
+  }
+  bool written = write(fd, &bytes[0], bytes.size()) == static_cast<ssize_t>(bytes.size());
+  close(fd);
+  if (! written) {
+    unlink(path);
+    return "";
+  }
+  return path;
+}
+
+/**
+ * @brief Whether reading |count| bytes at |offset| with |reader| gives the
+ * same bytes as pread() on |fd|.
+ */
+static bool same_as_pread(ReadAhead& reader, int fd, int64_t offset, int64_t count)
+{
+  std::vector<unsigned char> expected(TEST_MAX_READ);
+  std::vector<unsigned char> actual(TEST_MAX_READ);
+  ssize_t length = pread(fd, &expected[0], count, offset);
+  if (length < 0) {
+    length = 0;
+  }
+  int64_t read = reader.read(&actual[0], count);
+  return read == length && reader.tell() == offset + length &&
+         std::equal(expected.begin(), expected.begin() + length, actual.begin());
+}
+
+/**
+ * @brief Read the whole file in small reads, then read and seek at random,
+ * with and without io_uring. When the kernel has no io_uring, both use the
+ * threads.
+ */
+void read_test(const char* path, int fd)
+{
+  for (size_t e = 0; e < 2; e++) {
+    ReadAhead reader(e == 0);
+    vagg_ok(reader.open(path) == 0, "Open the file.");
+    vagg_ok(reader.size() == TEST_FILE_SIZE, "The size is the one of the file.");
+    if (e == 1) {
+      vagg_ok(reader.engine() == ReadAhead::ThreadPool, "Without io_uring, threads read.");
+    }
+
+    bool sequential = true;
+    for (int64_t offset = 0; offset <= TEST_FILE_SIZE; offset += 12345) {
+      sequential = sequential && same_as_pread(reader, fd, offset, 12345);
+    }
+    vagg_ok(sequential, "Sequential reads give the bytes of the file.");
+
+    bool random = true;
+    srand(e);
+    for (size_t i = 0; i < TEST_SEEKS; i++) {
+      int64_t offset = reader.tell();
+      int64_t count = rand() % TEST_MAX_READ;
+      switch (i % 4) {
+        case 0:
+          // Sometimes past the end.
+          offset = rand() % (TEST_FILE_SIZE + 1000);
+          random = random && reader.seek(offset, SEEK_SET) == offset;
+          break;
+        case 1:
+          // Backwards, mostly within the blocks already read.
+          offset = offset > 5000 ? offset - rand() % 5000 : 0;
+          random = random && reader.seek(offset - reader.tell(), SEEK_CUR) == offset;
+          break;
+        case 2:
+          offset = TEST_FILE_SIZE - rand() % TEST_MAX_READ;
+          random = random && reader.seek(offset - TEST_FILE_SIZE, SEEK_END) == offset;
+          break;
+        default:
+          // Carry on from where the last read stopped.
+          break;
+      }
+      random = random && same_as_pread(reader, fd, offset, count);
+    }
+    vagg_ok(random, "Reads after seeks give the bytes of the file.");
+    vagg_ok(reader.seek(-1, SEEK_SET) == -1, "A negative position cannot be seeked to.");
+  }
+
+  ReadAhead missing;
+  vagg_ok(missing.open("/nonexistent") == -1, "Opening a missing file fails.");
+  ReadAhead directory;
+  vagg_ok(directory.open("/tmp") == -1, "Opening a directory fails.");
+}
+
+int main()
+{
+  vagg_start(vagg_display_success);
+
+  srand(1);
+  std::string path = write_file();
+  vagg_ok(! path.empty(), "Write the file.");
+  int fd = open(path.c_str(), O_RDONLY);
+  read_test(path.c_str(), fd);
+  close(fd);
+  unlink(path.c_str());
+
+  vagg_end();
+  return 0;
+}
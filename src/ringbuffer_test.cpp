@@ -1,48 +1,349 @@
 #include "RingBuffer.hpp"
+#include "FrameRingBuffer.hpp"
+#include "TripleBuffer.hpp"
 
 #define VAGG_TEST
 
 #include "vagg/vagg.h"
 
+#include <thread>
+#include <chrono>
 
-int main()
-{
-  vagg_start(vagg_display_success);
-  RingBuffer<AudioBuffer, 2> buffer;
+#define STRESS_SLOT_SIZE 4
+#define STRESS_ITERATIONS 1000000
 
+typedef RingBuffer<SamplesType, 2> TestRing;
+typedef RingBuffer<size_t, 16> StressRing;
+typedef FrameRingBuffer<size_t> FrameRing;
+
+void basic_test()
+{
+  TestRing buffer(4);
 
-  AudioBuffer a = {0.1, 0.2, 0.3, 0.4};
-  AudioBuffer b = {0.2, 1.2, 1.3, 2.4};
-  AudioBuffer c = {3.1, 8.2, 3.3, 3.4};
-  AudioBuffer d;
+  SamplesType a[4] = {0.1, 0.2, 0.3, 0.4};
+  SamplesType b[4] = {0.2, 1.2, 1.3, 2.4};
+  SamplesType c[4] = {3.1, 8.2, 3.3, 3.4};
+  SamplesType d[4];
 
   for(int i = 0; i < 10; i++) {
     vagg_ok(! buffer.full(), "Not full.");
     vagg_ok(buffer.empty(), "Empty.");
-    float raw[4] = {0.1, 0.3, 1.8, 4.2};
-    vagg_ok(buffer.push_raw(raw, 4), "Add a buffer on a not full RingBuffer.");
-    vagg_ok(! buffer.empty(), "Not full.");
-    vagg_ok(! buffer.full(), "Not empty.");
-    vagg_ok(buffer.push(b), "Add a buffer on a not full RingBuffer.");
-    vagg_ok(buffer.full(), "Should be full");
-    vagg_ok(! buffer.empty(), "Should not be empty");
-    vagg_ok(! buffer.push(c), "Add a buffer on a full RingBuffer.");
-    vagg_ok(buffer.full(), "Should be full");
-    vagg_ok(! buffer.empty(), "Should not be empty");
-
-    vagg_ok(buffer.pop(d), "Get a buffer back.");
-    vagg_bufeq((void*)&a.front(), a.size(),(void*)&d.front(), d.size(), "First buffer out should be equal to first buffer in.");
-    vagg_ok(! buffer.empty(), "Should not be empty");
-    vagg_ok(! buffer.full(), "Should not be full");
-    vagg_ok(buffer.pop(d), "Get another buffer back.");
+    vagg_ok(! buffer.push(a, 3), "Pushing a buffer of the wrong size should fail.");
+    vagg_ok(buffer.push(a, 4), "Add a buffer on a not full RingBuffer.");
+    vagg_ok(! buffer.empty(), "Not empty.");
+    vagg_ok(buffer.full(), "Should be full, one slot is always kept free.");
+    vagg_ok(buffer.available_read() == 1, "One slot should be readable.");
+    vagg_ok(! buffer.push(b, 4), "Add a buffer on a full RingBuffer.");
+
+    vagg_ok(buffer.pop(d, 4), "Get a buffer back.");
+    vagg_bufeq((void*)a, sizeof(a), (void*)d, sizeof(d), "First buffer out should be equal to first buffer in.");
     vagg_ok(buffer.empty(), "Should be empty.");
     vagg_ok(! buffer.full(), "Should not be full.");
-    vagg_bufeq((void*)&b.front(), b.size(),(void*)&d.front(), d.size(), "Second buffer out should be equal to second buffer in.");
-    vagg_ok(! buffer.pop(d), "Get a buffer back on an empty RingBuffer should not be possible.");
+    vagg_ok(! buffer.pop(d, 4), "Get a buffer back on an empty RingBuffer should not be possible.");
+
+    vagg_ok(buffer.push(c, 4), "Add a buffer after wrapping around.");
+    vagg_ok(buffer.pop(d, 4), "Get a buffer back after wrapping around.");
+    vagg_bufeq((void*)c, sizeof(c), (void*)d, sizeof(d), "Buffer out should be equal to buffer in after wrapping around.");
+  }
+}
+
+void in_place_test()
+{
+  TestRing buffer(4);
+
+  SamplesType a[4] = {0.1, 0.2, 0.3, 0.4};
+  SamplesType d[4];
+
+  for(int i = 0; i < 10; i++) {
+    vagg_ok(buffer.peek_read() == 0, "Nothing to peek on an empty RingBuffer.");
+    SamplesType* slot = buffer.reserve_write();
+    vagg_ok(slot != 0, "Reserve a slot on a not full RingBuffer.");
+    for (size_t j = 0; j < buffer.slot_size(); j++) {
+      slot[j] = a[j];
+    }
+    vagg_ok(buffer.empty(), "A reserved slot is not visible before commit.");
+    buffer.commit_write();
+    vagg_ok(buffer.reserve_write() == 0, "Cannot reserve a slot on a full RingBuffer.");
+
+    SamplesType* read = buffer.peek_read();
+    vagg_ok(read == slot, "The slot read is the slot written.");
+    vagg_ok(! buffer.empty(), "A peeked slot is still in the RingBuffer.");
+    buffer.release_read();
+    vagg_ok(buffer.empty(), "Should be empty after release.");
+
+    vagg_ok(buffer.push(a, 4), "push still works after in place access.");
+    vagg_ok(buffer.pop(d, 4), "pop still works after in place access.");
+    vagg_bufeq((void*)a, sizeof(a), (void*)d, sizeof(d), "Buffer out should be equal to buffer in.");
+  }
+}
+
+void frame_test()
+{
+  FrameRing buffer(6, 2, HeapStorage);
+  size_t in[16];
+  size_t out[16];
+  size_t next_in = 0;
+  size_t next_out = 0;
+
+  vagg_ok(buffer.capacity() == 8, "The capacity is rounded up to a power of two.");
+  vagg_ok(buffer.empty(), "Empty.");
+
+  // Odd lengths, so that writes and reads wrap around at various offsets.
+  for(int i = 0; i < 50; i++) {
+    size_t frames = (i % 3) + 1;
+    for (size_t j = 0; j < frames * 2; j++) {
+      in[j] = next_in++;
+    }
+    vagg_ok(buffer.write(in, frames) == frames, "Write a few frames on a not full FrameRingBuffer.");
+    vagg_ok(buffer.available_read() == frames, "Everything written is readable.");
+    vagg_ok(buffer.read(out, 16) == frames, "Read back as much as was written.");
+    bool ordered = true;
+    for (size_t j = 0; j < frames * 2; j++) {
+      if (out[j] != next_out++) {
+        ordered = false;
+      }
+    }
+    vagg_ok(ordered, "Frames out should be equal to frames in.");
     vagg_ok(buffer.empty(), "Should be empty.");
-    vagg_ok(! buffer.full(), "Should not be full.");
   }
 
+  for (size_t j = 0; j < 16; j++) {
+    in[j] = j;
+  }
+  vagg_ok(buffer.write(in, 10) == 8, "A write is cut at the capacity.");
+  vagg_ok(buffer.full(), "Should be full.");
+  vagg_ok(buffer.write(in, 1) == 0, "Cannot write on a full FrameRingBuffer.");
+  buffer.clear();
+  vagg_ok(buffer.empty(), "Should be empty after clear.");
+
+  vagg_ok(buffer.write(in, 3) == 3, "Write a few frames.");
+  size_t contiguous;
+  buffer.peek_read(&contiguous);
+  vagg_ok(buffer.write(in, 1) == 1, "Write a frame after a peek.");
+  size_t position = buffer.write_position();
+  vagg_ok(buffer.write(in + 4, 2) == 2, "Write a few more frames.");
+  buffer.skip_to(position);
+  vagg_ok(buffer.available_read() == 2, "Skip exactly up to a write position.");
+  size_t* span = buffer.peek_read(&contiguous);
+  // The two frames can wrap around the end of the storage.
+  vagg_ok(contiguous >= 1 && contiguous <= 2 && span[0] == 4 && span[1] == 5,
+          "Peek the frames after a skip past the ones seen by the last peek.");
+  buffer.skip_to(position - 1);
+  vagg_ok(buffer.available_read() == 2, "Skipping to a position already read does nothing.");
+  buffer.skip_to(buffer.write_position() + 1);
+  vagg_ok(buffer.available_read() == 2, "Skipping to a position not written yet does nothing.");
+  buffer.clear();
+  vagg_ok(buffer.read(out, 1) == 0, "Cannot read on an empty FrameRingBuffer.");
+}
+
+void mirrored_test()
+{
+  FrameRing buffer(6, 3, MirroredStorage);
+  size_t in[3 * 100];
+  size_t out[3 * 100];
+
+  vagg_ok(buffer.mirrored(), "The storage should be mirrored on this system.");
+  vagg_ok(buffer.capacity() * 3 * sizeof(size_t) % MirroredMemory::page_size() == 0,
+          "The capacity is rounded up to whole pages.");
+
+  for (size_t i = 0; i < 3 * 100; i++) {
+    in[i] = i;
+  }
+  // Move the indices close to the end of the storage.
+  for (size_t i = 0; i < buffer.capacity() - 50; i += 100) {
+    size_t frames = buffer.capacity() - 50 - i < 100 ? buffer.capacity() - 50 - i : 100;
+    buffer.write(in, frames);
+    buffer.read(out, frames);
+  }
+
+  vagg_ok(buffer.write(in, 100) == 100, "Write across the end of the storage.");
+  size_t contiguous;
+  size_t* span = buffer.peek_read(&contiguous);
+  vagg_ok(contiguous == 100, "A mirrored FrameRingBuffer is always contiguous.");
+  vagg_bufeq((void*)in, sizeof(in), (void*)span, sizeof(in),
+             "The contiguous span should be equal to the frames written.");
+  buffer.release_read(100);
+  vagg_ok(buffer.empty(), "Should be empty.");
+
+  // Nothing clips the span of a mirrored buffer : it must be exact after a
+  // skip.
+  buffer.write(in, 3);
+  buffer.peek_read(&contiguous);
+  buffer.write(in, 1);
+  size_t position = buffer.write_position();
+  buffer.write(in + 3 * 4, 2);
+  buffer.skip_to(position);
+  span = buffer.peek_read(&contiguous);
+  vagg_ok(contiguous == 2 && span[0] == 12 && span[5] == 17,
+          "Peek exactly the frames left after a skip.");
+}
+
+/**
+ * @brief Have a producer and a consumer thread hammer the same RingBuffer,
+ * check that everything comes out in order, and report the throughput.
+ */
+void stress_test()
+{
+  StressRing ring(STRESS_SLOT_SIZE);
+  bool ordered = true;
+
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+  std::thread consumer([&ring, &ordered]() {
+    size_t slot[STRESS_SLOT_SIZE];
+    size_t expected = 0;
+    while (expected < STRESS_ITERATIONS) {
+      if (! ring.pop(slot, STRESS_SLOT_SIZE)) {
+        std::this_thread::yield();
+        continue;
+      }
+      for (size_t i = 0; i < STRESS_SLOT_SIZE; i++) {
+        if (slot[i] != expected) {
+          ordered = false;
+        }
+      }
+      expected++;
+    }
+  });
+
+  size_t slot[STRESS_SLOT_SIZE];
+  for (size_t i = 0; i < STRESS_ITERATIONS; i++) {
+    for (size_t j = 0; j < STRESS_SLOT_SIZE; j++) {
+      slot[j] = i;
+    }
+    while (! ring.push(slot, STRESS_SLOT_SIZE)) {
+      std::this_thread::yield();
+    }
+  }
+
+  consumer.join();
+
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+  vagg_ok(ordered, "Slots should come out whole and in order.");
+  vagg_ok(ring.empty(), "Everything should have been consumed.");
+  VAGG_LOG(VAGG_LOG_OK, "%d pushes in %lfs : %.0lf pushes per second.",
+           STRESS_ITERATIONS, elapsed.count(), STRESS_ITERATIONS / elapsed.count());
+}
+
+/**
+ * @brief Same as stress_test, with writes and reads of varying length.
+ */
+void frame_stress_test(RingStorage storage)
+{
+  FrameRing ring(1000, 2, storage);
+  bool ordered = true;
+
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+  std::thread consumer([&ring, &ordered]() {
+    size_t frames[2 * 64];
+    size_t expected = 0;
+    size_t length = 1;
+    while (expected < STRESS_ITERATIONS) {
+      size_t read = ring.read(frames, length);
+      if (! read) {
+        std::this_thread::yield();
+        continue;
+      }
+      for (size_t i = 0; i < read; i++) {
+        if (frames[2 * i] != expected || frames[2 * i + 1] != expected) {
+          ordered = false;
+        }
+        expected++;
+      }
+      length = length % 63 + 1;
+    }
+  });
+
+  size_t frames[2 * 64];
+  size_t next = 0;
+  size_t length = 1;
+  while (next < STRESS_ITERATIONS) {
+    size_t count = length;
+    if (count > STRESS_ITERATIONS - next) {
+      count = STRESS_ITERATIONS - next;
+    }
+    for (size_t i = 0; i < count; i++) {
+      frames[2 * i] = frames[2 * i + 1] = next + i;
+    }
+    size_t written = 0;
+    while (written != count) {
+      size_t w = ring.write(frames + 2 * written, count - written);
+      if (! w) {
+        std::this_thread::yield();
+      }
+      written += w;
+    }
+    next += count;
+    length = length % 61 + 1;
+  }
+
+  consumer.join();
+
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+  vagg_ok(ordered, "Frames should come out whole and in order.");
+  vagg_ok(ring.empty(), "Everything should have been consumed.");
+  VAGG_LOG(VAGG_LOG_OK, "%d frames in %lfs : %.0lf frames per second.",
+           STRESS_ITERATIONS, elapsed.count(), STRESS_ITERATIONS / elapsed.count());
+}
+
+/**
+ * @brief Have a writer publish increasing values as fast as it can, and check
+ * that the reader only ever sees newer values, and the last one in the end.
+ */
+void triple_test()
+{
+  TripleBuffer<size_t> triple;
+  bool increasing = true;
+
+  vagg_ok(! triple.update(), "Nothing to read before the first publish.");
+  triple.write_buffer() = 1;
+  vagg_ok(triple.publish(), "Nothing was dropped by the first publish.");
+  triple.write_buffer() = 2;
+  vagg_ok(! triple.publish(), "An unread value is dropped by the next publish.");
+  vagg_ok(triple.write_buffer() == 1, "The dropped value is handed back to the writer.");
+  vagg_ok(triple.update() && triple.read_buffer() == 2, "The reader gets the latest value.");
+  vagg_ok(! triple.update(), "Nothing new to read.");
+
+  std::thread writer([&triple]() {
+    for (size_t i = 3; i <= STRESS_ITERATIONS; i++) {
+      triple.write_buffer() = i;
+      triple.publish();
+    }
+  });
+
+  size_t last = 2;
+  while (last != STRESS_ITERATIONS) {
+    if (! triple.update()) {
+      std::this_thread::yield();
+      continue;
+    }
+    if (triple.read_buffer() <= last) {
+      increasing = false;
+    }
+    last = triple.read_buffer();
+  }
+
+  writer.join();
+
+  vagg_ok(increasing, "Values should only get newer.");
+}
+
+int main()
+{
+  vagg_start(vagg_display_success);
+
+  basic_test();
+  in_place_test();
+  frame_test();
+  mirrored_test();
+  stress_test();
+  frame_stress_test(HeapStorage);
+  frame_stress_test(MirroredStorage);
+  triple_test();
+
   vagg_end();
   return 0;
 }
@@ -0,0 +1,148 @@
+#include "SampleCache.hpp"
+
+#define VAGG_TEST
+
+#include "vagg/vagg.h"
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+
+#define TEST_FRAMES 1000
+
+/**
+ * @brief Create a file of |bytes| bytes, and return its path, or an empty
+ * string.
+ */
+static std::string make_file(size_t bytes)
+{
+  char path[] = "/tmp/samplecache_test_XXXXXX";
+  int fd = mkstemp(path);
+  if (fd == -1) {
+    return "";
+  }
+  std::vector<char> data(bytes, 'x');
+  bool written = write(fd, &data[0], data.size()) == static_cast<ssize_t>(data.size());
+  close(fd);
+  return written ? path : "";
+}
+
+/**
+ * @brief Mono samples, of |frames| frames.
+ */
+static SampleCache::Entry make_samples(size_t frames)
+{
+  std::shared_ptr<CachedSamples> samples(new CachedSamples);
+  samples->samples.assign(frames, 0.5f);
+  samples->channels = 1;
+  samples->samplerate = 44100;
+  samples->format = 0;
+  samples->frames = frames;
+  samples->peak = 0.5f;
+  return samples;
+}
+
+/**
+ * @brief Insert the samples of |path|, stat()ed now.
+ */
+static bool insert(const std::string& path, SampleCache::Entry samples)
+{
+  int64_t mtime_ns;
+  int64_t file_size;
+  if (! SampleCache::stat_file(path.c_str(), &mtime_ns, &file_size)) {
+    return false;
+  }
+  return SampleCache::instance().insert(path.c_str(), samples, mtime_ns, file_size);
+}
+
+void budget_test(const std::vector<std::string>& paths)
+{
+  SampleCache& cache = SampleCache::instance();
+  size_t bytes = TEST_FRAMES * sizeof(SamplesType);
+  cache.set_threshold(bytes);
+  cache.set_budget(2 * bytes);
+
+  vagg_ok(! cache.fits(TEST_FRAMES + 1, 1), "A file above the threshold does not fit.");
+  vagg_ok(! insert(paths[0], make_samples(TEST_FRAMES + 1)),
+          "Samples above the threshold are not kept.");
+  vagg_ok(cache.size() == 0, "Nothing is kept.");
+
+  SampleCache::Entry first = make_samples(TEST_FRAMES);
+  vagg_ok(insert(paths[0], first), "Keep a first file.");
+  vagg_ok(insert(paths[1], make_samples(TEST_FRAMES)), "Keep a second file.");
+  vagg_ok(cache.find(paths[0].c_str()) == first, "Find the first file.");
+  vagg_ok(insert(paths[2], make_samples(TEST_FRAMES)), "Keep a third file.");
+  vagg_ok(cache.size() == 2 * bytes, "The entries stay within the budget.");
+  vagg_ok(! cache.find(paths[1].c_str()), "The least recently used file is dropped.");
+  vagg_ok(cache.find(paths[2].c_str()) && cache.find(paths[0].c_str()),
+          "The other files are kept.");
+
+  // paths[0] was found last : paths[2] is the least recently used now.
+  cache.set_budget(bytes);
+  vagg_ok(cache.size() == bytes && cache.find(paths[0].c_str()) && ! cache.find(paths[2].c_str()),
+          "A smaller budget drops the least recently used files.");
+  vagg_ok(first->samples.size() == TEST_FRAMES, "A dropped entry stays valid for its users.");
+
+  cache.set_budget(0);
+  vagg_ok(cache.size() == 0, "A budget of 0 drops everything.");
+  cache.set_budget(SAMPLE_CACHE_BUDGET);
+  cache.set_threshold(SAMPLE_CACHE_THRESHOLD);
+}
+
+void invalidation_test(const std::vector<std::string>& paths)
+{
+  SampleCache& cache = SampleCache::instance();
+
+  vagg_ok(insert(paths[0], make_samples(TEST_FRAMES)), "Keep a file.");
+  int fd = open(paths[0].c_str(), O_WRONLY | O_APPEND);
+  bool appended = write(fd, "y", 1) == 1;
+  close(fd);
+  vagg_ok(appended && ! cache.find(paths[0].c_str()), "A file that grew is decoded again.");
+  vagg_ok(cache.size() == 0, "Its entry is dropped.");
+
+  vagg_ok(insert(paths[1], make_samples(TEST_FRAMES)), "Keep another file.");
+  struct timespec times[2];
+  times[0].tv_sec = 0;
+  times[0].tv_nsec = UTIME_OMIT;
+  times[1].tv_sec = 1000000000;
+  times[1].tv_nsec = 0;
+  vagg_ok(utimensat(AT_FDCWD, paths[1].c_str(), times, 0) == 0 &&
+          ! cache.find(paths[1].c_str()), "A file with another mtime is decoded again.");
+
+  // The file changes while it is decoded : the entry is kept with the stat
+  // from before, and is stale at once.
+  int64_t mtime_ns;
+  int64_t file_size;
+  SampleCache::stat_file(paths[2].c_str(), &mtime_ns, &file_size);
+  truncate(paths[2].c_str(), 10);
+  vagg_ok(cache.insert(paths[2].c_str(), make_samples(TEST_FRAMES), mtime_ns, file_size),
+          "Keep a file that changed while decoded.");
+  vagg_ok(! cache.find(paths[2].c_str()), "Its samples are not used.");
+
+  unlink(paths[0].c_str());
+  vagg_ok(insert(paths[1], make_samples(TEST_FRAMES)), "Keep a file again.");
+  unlink(paths[1].c_str());
+  vagg_ok(! cache.find(paths[1].c_str()), "A file that went away is not found.");
+}
+
+int main()
+{
+  vagg_start(vagg_display_success);
+
+  std::vector<std::string> paths;
+  for (size_t i = 0; i < 3; i++) {
+    paths.push_back(make_file(100 + i));
+    vagg_ok(! paths.back().empty(), "Create a file.");
+  }
+  budget_test(paths);
+  invalidation_test(paths);
+  for (size_t i = 0; i < paths.size(); i++) {
+    unlink(paths[i].c_str());
+  }
+
+  vagg_end();
+  return 0;
+}
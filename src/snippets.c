@@ -121,12 +121,13 @@ long noise(float* out, size_t buflen, size_t offset, size_t len)
   }
 }
 
+/* See Delay for a delay line that keeps its state between blocks. */
 void delay(float* in, size_t len, double delay, double feedback)
 {
   size_t DELAY = ms_to_samples(delay);
   int cursor = 0;
   double buffer[(size_t)(2*RATE)] = { 0.0 };
-  while(--len > 0)
+  while(len-- > 0)
   {
     double x = *in;
     double y = buffer[cursor];
@@ -138,6 +139,8 @@ void delay(float* in, size_t len, double delay, double feedback)
   }
 }
 
+/* A stack of delays. See ConvolutionReverb for a reverb that keeps its state
+ * between blocks. */
 void reverb(float* in, size_t len)
 {
   size_t i = 0;
@@ -152,19 +155,23 @@ void reverb(float* in, size_t len)
   }
 }
 
+/* See Distortion for vectorised versions of the waveshapers below, with
+ * oversampling. */
 void bitcrush(float* in, size_t len, size_t bits)
 {
   // number of value possible for a nbBits integer
   int coeff = (unsigned)pow(2, bits);
   int tmp = 0;
 
-  while(--len != 0)
+  while(len-- != 0)
   {
     tmp = (int)(*in * coeff);
     *in++ = (float)tmp/coeff;
   }
 }
 
+/* See OscillatorBank for band-limited oscillators that keep their phase as
+ * a float that wraps around, and render many voices at once. */
 long sinus(float* out, size_t buflen, size_t offset, size_t len, double frequency, unsigned long* angle)
 {
   ASSERT(buflen >= (offset + len), "offset + len greater that buffer length");
@@ -186,7 +193,7 @@ long sine_swipe(float* out, size_t buflen, size_t offset, size_t len, double fre
   for(; i < offset + len; i++) {
     out[i] = sin((*angle)*W*frequency);
     frequency+=increment;
-    if (out[i-1] < 0 && out[i] > 0)
+    if (i > offset && out[i-1] < 0 && out[i] > 0)
       *angle = 0;
     (*angle)++;
   }
@@ -249,7 +256,7 @@ void softclip(float* buffer, size_t len, double amount)
       buffer[i] = amount + (1.0 - amount) * tanh((buffer[i]-amount)/(1-amount));
     }
     if (buffer[i] < -amount) {
-      buffer[i] = -(amount + (1.0 - amount) * tanh((buffer[i]-amount)/(1-amount)));
+      buffer[i] = -(amount + (1.0 - amount) * tanh((-buffer[i]-amount)/(1-amount)));
     }
   }
 }
@@ -0,0 +1,116 @@
+#include "FFT.hpp"
+#include "SpectrumAnalyzer.hpp"
+
+#define VAGG_TEST
+
+#include "vagg/vagg.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <vector>
+
+static float noise()
+{
+  return rand() / static_cast<float>(RAND_MAX) * 2 - 1;
+}
+
+/**
+ * @brief Compare forward() with a direct DFT computed in double, and
+ * inverse() of it with the input, for all the sizes from 4 to 4096.
+ */
+void fft_test()
+{
+  srand(1);
+  bool forward = true;
+  bool inverse = true;
+  for (size_t size = 4; size <= 4096; size *= 2) {
+    FFT fft(size);
+    std::vector<float> in(size);
+    for (size_t i = 0; i < size; i++) {
+      in[i] = noise();
+    }
+    std::vector<float> spectrum(size + 2);
+    fft.forward(&in[0], &spectrum[0]);
+
+    std::vector<double> cosines(size);
+    std::vector<double> sines(size);
+    for (size_t i = 0; i < size; i++) {
+      cosines[i] = cos(2 * M_PI * i / size);
+      sines[i] = sin(2 * M_PI * i / size);
+    }
+    // The rounding errors grow with the square root of the size.
+    double tolerance = 1e-5 * sqrt(size);
+    for (size_t k = 0; k <= size / 2; k++) {
+      double re = 0;
+      double im = 0;
+      for (size_t n = 0; n < size; n++) {
+        size_t phase = (k * n) & (size - 1);
+        re += in[n] * cosines[phase];
+        im -= in[n] * sines[phase];
+      }
+      forward = forward && fabs(spectrum[2 * k] - re) < tolerance &&
+                fabs(spectrum[2 * k + 1] - im) < tolerance;
+    }
+
+    std::vector<float> out(size);
+    fft.inverse(&spectrum[0], &out[0]);
+    for (size_t i = 0; i < size; i++) {
+      inverse = inverse && fabs(out[i] / size - in[i]) < 1e-5;
+    }
+  }
+  vagg_ok(forward, "forward() gives the same spectrum as a direct DFT.");
+  vagg_ok(inverse, "inverse() of forward() is the input times the size.");
+}
+
+/**
+ * @brief A full scale sine at the center of a bin reads 0 dB there, and a
+ * spectrum is published every |hop| frames, whatever the blocks.
+ */
+void spectrum_test()
+{
+  const size_t size = 1024;
+  const size_t hop = 256;
+  const size_t bin = 100;
+  SpectrumAnalyzer analyzer(size, hop);
+  SpectrumValues values;
+  const size_t lengths[] = {1, 37, 100, 3, 255};
+  std::vector<float> samples(2 * 255);
+  size_t frame = 0;
+  size_t published = 0;
+  bool on_time = true;
+  for (size_t i = 0; frame < 20 * size; i++) {
+    size_t length = lengths[i % 5];
+    for (size_t j = 0; j < length; j++) {
+      float value = sin(2 * M_PI * bin * (frame + j) / size);
+      samples[2 * j] = value;
+      samples[2 * j + 1] = value;
+    }
+    analyzer.process(&samples[0], length, 2);
+    frame += length;
+    // The blocks are shorter than the hop : at most one spectrum each.
+    if (analyzer.read(&values)) {
+      published++;
+    }
+    on_time = on_time && published == frame / hop;
+  }
+  vagg_ok(on_time, "A spectrum is published every hop.");
+  vagg_ok(values.bins == size / 2 + 1, "There is a bin per frequency up to Nyquist.");
+  vagg_ok(fabsf(values.magnitude[bin]) < 0.01, "A full scale sine reads 0 dB in its bin.");
+  // The Hann window spreads it on the neighbours, at half the amplitude.
+  vagg_ok(fabsf(values.magnitude[bin + 1] + 6.02f) < 0.01 &&
+          fabsf(values.magnitude[bin - 1] + 6.02f) < 0.01,
+          "The next bins read -6 dB.");
+  vagg_ok(values.magnitude[bin + 10] < -90 && values.magnitude[0] < -90,
+          "The bins far from it read nothing.");
+}
+
+int main()
+{
+  vagg_start(vagg_display_success);
+
+  fft_test();
+  spectrum_test();
+
+  vagg_end();
+  return 0;
+}
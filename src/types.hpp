@@ -1,5 +1,6 @@
 #ifndef TYPES_H
 #define TYPES_H
+#include <stddef.h>
 #include <vector>
 #include <list>
 #include <portaudio.h>
@@ -17,4 +18,10 @@ typedef SamplesType* AudioBuffer;
  */
 typedef std::list<AudioBuffer*> BufferList;
 
+/**
+ * @brief The size of a cache line, used to keep data written by different
+ * threads on different lines.
+ */
+#define CACHE_LINE_SIZE 64
+
 #endif
@@ -166,7 +166,7 @@ int main(void)
         if (buffer.available_read() != 0) {
           SamplesType b[CHUNK_SIZE];
           buffer.pop(b, CHUNK_SIZE);
-          file.write_some(b, CHUNK_SIZE);
+          file.write_frames(b, CHUNK_SIZE / CHANNELS);
         }
         VAGG_LOG(VAGG_LOG_OK, "Disk space availale : %lfGo", get_free_disk_space(FILENAME)/1024./1024./1024.);
         break;